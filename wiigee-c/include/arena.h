@@ -0,0 +1,34 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _arena_h
+#define _arena_h    1
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for per-recognition scratch memory.  Allocations are never
+ * freed individually; arena_reset() reclaims everything at once and keeps
+ * the memory for the next round, so a steady-state recognition does no
+ * malloc/free at all.
+ */
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    char *data;
+} arena_block;
+
+typedef struct arena {
+    struct arena_block *blocks; // Current block first
+    size_t block_size;          // Minimum size of a new block
+    size_t used;                // Bytes handed out since the last reset
+    size_t high_water;          // Largest `used` seen at a reset
+} arena;
+
+struct arena *arena_new(size_t block_size);
+void arena_free(struct arena *);
+void *arena_alloc(struct arena *, size_t);
+void *arena_grow(struct arena *, void *, size_t, size_t);
+void arena_reset(struct arena *);
+
+#endif
@@ -0,0 +1,106 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _capture_h
+#define _capture_h    1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Binary capture files: a corpus of recorded gestures laid out to be
+ * memory-mapped and used in place.
+ *
+ *   header
+ *   x column, y column, z column   raw 8-bit reports, every gesture back to back
+ *   timestamps                     per gesture, zigzag varint deltas after the first
+ *   strings                        NUL-terminated user names
+ *   index                          one capture_entry per gesture
+ *
+ * All integers are little-endian.
+ */
+
+#define CAPTURE_MAGIC      "WGCP"
+#define CAPTURE_VERSION    1
+
+enum capture_hand {
+    HAND_UNKNOWN,
+    HAND_LEFT,
+    HAND_RIGHT,
+};
+
+typedef struct capture_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t n_gestures;
+    uint32_t strings_len;
+    uint64_t n_samples;         // Length of each column
+    uint64_t columns_offset;    // x, then y, then z
+    uint64_t times_offset;
+    uint64_t times_len;
+    uint64_t strings_offset;
+    uint64_t index_offset;
+} capture_header;
+
+typedef struct capture_entry {
+    uint32_t user;              // Offset into the strings
+    uint32_t hand;              // enum capture_hand
+    uint32_t gesture;           // Index of the gesture within its user/hand recording
+    uint32_t data_len;
+    uint64_t first;             // Column index of the first sample
+    uint64_t times;             // Offset of the first delta in the timestamps
+    int64_t t0;                 // First timestamp, microseconds since the epoch
+} capture_entry;
+
+// One gesture, pointing into the mapped file
+typedef struct capture_view {
+    const char *user;
+    enum capture_hand hand;
+    int gesture;
+    int data_len;
+    const uint8_t *x, *y, *z;
+    const uint8_t *times;       // data_len - 1 encoded deltas
+    int64_t t0;
+} capture_view;
+
+typedef struct capture {
+    void *map;
+    size_t map_len;
+    const struct capture_header *header;
+    const struct capture_entry *index;
+    const uint8_t *columns;
+    const uint8_t *times;
+    const char *strings;
+} capture;
+
+// Collects gestures in memory until capture_writer_save()
+typedef struct capture_writer {
+    uint8_t *x, *y, *z;
+    int64_t n_samples, samples_cap;
+    uint8_t *times;
+    int64_t times_len, times_cap;
+    char *strings;
+    int strings_len, strings_cap;
+    struct capture_entry *index;
+    int n_gestures, index_cap;
+} capture_writer;
+
+struct gesture;
+struct arena;
+
+enum capture_hand capture_hand_from_name(const char *);
+const char *capture_hand_name(enum capture_hand);
+
+struct capture_writer *capture_writer_new();
+void capture_writer_add(struct capture_writer *, const char *, enum capture_hand, int,
+                        const uint8_t *, const uint8_t *, const uint8_t *, const int64_t *, int);
+int capture_writer_save(struct capture_writer *, const char *);
+void capture_writer_free(struct capture_writer *);
+
+struct capture *capture_open(const char *);
+void capture_close(struct capture *);
+int capture_count(struct capture *);
+void capture_get(struct capture *, int, struct capture_view *);
+void capture_timestamps(const struct capture_view *, int64_t *);
+struct gesture *capture_gesture(const struct capture_view *, struct arena *);
+
+#endif
@@ -0,0 +1,27 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _classifier_h
+#define _classifier_h    1
+
+#include "gesturemodel.h"
+#include "scorer.h"
+
+/*
+ * The wiigee bayes classifier over a vocabulary of gesture models.  Models
+ * sharing a codebook are detected when the classifier is built, so a gesture
+ * is quantized once per distinct codebook rather than once per model.
+ */
+typedef struct classifier {
+    struct gesturemodel **models;   // Not owned
+    int n_models;
+    struct scorer *scorer;          // Rebuilt lazily when models are added
+} classifier;
+
+struct classifier *classifier_new();
+void classifier_free(struct classifier *this);
+void classifier_add(struct classifier *this, struct gesturemodel *model);
+int classifier_codebooks(struct classifier *this);
+int classifier_classify(struct classifier *this, struct gesture *gesture, double *probabilities);
+int classifier_decide(struct gesturemodel **models, int n_models, double *matches, double *probabilities);
+
+#endif
@@ -0,0 +1,50 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _corpus_h
+#define _corpus_h    1
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "capture.h"
+
+/*
+ * A labeled in-memory corpus of wmdump captures (user.hand.txt files),
+ * read by a pool of threads, one file at a time each.
+ */
+
+typedef struct corpus_gesture {
+    int user;                   // Index into corpus->users
+    enum capture_hand hand;
+    int gesture;                // Index of the gesture within its file
+    int data_len;
+    const uint8_t *x, *y, *z;
+    const int64_t *t;
+} corpus_gesture;
+
+struct corpus_file;
+
+typedef struct corpus {
+    struct corpus_gesture *gestures;    // In file order, then gesture order
+    int n_gestures;
+    char **users;                       // Sorted
+    int n_users;
+    int **index;                        // Gesture numbers by user * 3 + hand
+    int *index_len;
+    struct corpus_file *files;          // Own the sample memory
+    int n_files;
+    int n_failed;                       // Files that couldn't be read
+    long n_samples;
+    long bytes;                         // Text read
+    double seconds;                     // Wall clock time of the load
+    int threads;
+} corpus;
+
+struct corpus *corpus_load(const char *const *, int, int);
+struct corpus *corpus_load_dir(const char *, int);
+void corpus_free(struct corpus *);
+int corpus_user(struct corpus *, const char *);
+const int *corpus_select(struct corpus *, int, enum capture_hand, int *);
+void corpus_report(struct corpus *, FILE *);
+
+#endif
@@ -0,0 +1,64 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _endpoint_h
+#define _endpoint_h    1
+
+#include "ring.h"
+
+/*
+ * Finds gestures in a continuous accelerometer stream, without a button.
+ * A slow running mean tracks gravity (whichever way the controller is
+ * resting) and a fast running mean of the squared deviation from it
+ * measures motion energy.  A segment starts when the energy rises above
+ * `on` and ends once it has stayed below `off` for `hangover` reports; a
+ * few reports from before the onset are kept, since the energy lags the
+ * motion.  Segments with fewer than min_len reports before the quiet at
+ * their end are dropped, ones reaching max_len are cut there.
+ *
+ * The output is what the trigger would have produced: a press, the
+ * segment's reports, a release (all with buttons ENDPOINT_BUTTONS), so a
+ * recognizer can't tell the difference; reports at rest are dropped, the
+ * quiet ones at the end of a segment included.
+ * Lengths are in reports, the thresholds in squared report units.
+ */
+
+#define ENDPOINT_BUTTONS    0x0004  // As if B were held
+#define ENDPOINT_HOLD       256     // Reports held back: preroll + min_len + hangover at most
+#define ENDPOINT_MAX_OUT    (ENDPOINT_HOLD + 2)
+
+enum endpoint_state {
+    ENDPOINT_REST,
+    ENDPOINT_ONSET,             // Moving, but not yet for min_len reports
+    ENDPOINT_ACTIVE,
+    ENDPOINT_COOLDOWN,          // Cut at max_len; waiting for the motion to stop
+};
+
+typedef struct endpoint {
+    double on, off;
+    int hangover;
+    int min_len, max_len;
+    int preroll;
+    double fast, slow;          // Weights of the newest report in the two running means
+
+    int started;
+    double mean[3];
+    double energy;
+    enum endpoint_state state;
+    int quiet;                  // Reports in a row below off
+    int len;                    // Reports in the segment so far
+    struct ring_event held[ENDPOINT_HOLD];  // The preroll and onset, or a quiet stretch
+    int n_held;
+    int64_t last_t;             // Of the last report let through
+
+    unsigned long segments;     // Delivered
+    unsigned long too_short;    // Dropped for being shorter than min_len
+    unsigned long cut;          // Cut at max_len
+    unsigned long at_rest;      // Reports dropped
+} endpoint;
+
+void endpoint_init(struct endpoint *);
+void endpoint_reset(struct endpoint *);
+int endpoint_push(struct endpoint *, const struct ring_event *, struct ring_event *);
+int endpoint_flush(struct endpoint *, struct ring_event *);
+
+#endif
@@ -11,10 +11,18 @@ typedef struct gesture {
     double minacc, maxacc;   // Min and max acceleration
     struct coordinate *data; // WiimoteAccelerationEvent
     int data_len;
+    int data_cap;            // Allocated length of data
+    struct arena *arena;     // Owner of this gesture's memory, or NULL for the heap
 } gesture;
 
+struct arena;
+
 struct gesture *gesture_new();
+struct gesture *gesture_new_in(struct arena *);
+void gesture_reserve(struct gesture *, int);
 void gesture_append(struct gesture *, double, double, double);
+void gesture_append_many(struct gesture *, const struct coordinate *, int);
+void gesture_minmax(struct gesture *);
 void gesture_free(struct gesture *);
 
 #endif
@@ -0,0 +1,31 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _gesture_soa_h
+#define _gesture_soa_h    1
+
+#include "gesture.h"
+
+#define GESTURE_SOA_ALIGN   32  // Column alignment, enough for AVX loads
+
+/*
+ * Struct-of-arrays gesture: one aligned float column per axis.  Half the
+ * memory of struct gesture per sample; the quantizer reads it a block of
+ * columns at a time and gives the same symbols as for struct gesture.
+ * Its distance loops have no branches or square roots, so they vectorize
+ * where the compiler does (-O3, or -O2 -ftree-vectorize).
+ */
+typedef struct gesture_soa {
+    float minacc, maxacc;    // Min and max acceleration
+    float *x, *y, *z;
+    int data_len;
+    int data_cap;            // Allocated length of each column
+} gesture_soa;
+
+struct gesture_soa *gesture_soa_new();
+struct gesture_soa *gesture_soa_from(struct gesture *);
+void gesture_soa_reserve(struct gesture_soa *, int);
+void gesture_soa_append(struct gesture_soa *, float, float, float);
+void gesture_soa_minmax(struct gesture_soa *);
+void gesture_soa_free(struct gesture_soa *);
+
+#endif
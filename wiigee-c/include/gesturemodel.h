@@ -16,8 +16,11 @@ typedef struct gesturemodel {
 } gesturemodel;
 
 struct gesturemodel *gesturemodel_new(int id);
+struct gesturemodel *gesturemodel_new_sized(int id, int states, int observations, enum quantizer_seeding seeding);
 void gesturemodel_free(struct gesturemodel *this);
 void gesturemodel_train(struct gesturemodel *this, struct gesture *trainsequence, int trainsequence_len);
+void gesturemodel_trainShared(struct gesturemodel **models, int n_models, struct gesture **trainsequences, int *trainsequence_lens);
+double matches(struct gesturemodel *this, struct gesture *gesture);
 void setDefaultProbability(struct gesturemodel *this, struct gesture *trainsequence, int trainsequence_len);
 
 #endif
@@ -8,9 +8,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdint.h>
 
 typedef unsigned int uint;
 
+/* Observation symbols are stored as bytes, so an alphabet (codebook) may
+ * have at most this many entries. */
+#define MAX_SYMBOLS 256
+
+struct arena;
+
 //#pragma mark -
 //#pragma mark structures
 
@@ -36,13 +43,19 @@ typedef struct _hmmState {
 } HmmState;
 typedef HmmState* HmmStateRef;
 
+/* A sequence of observation symbols.  Either owns its storage (see
+ * createStateSequence()) or is a view of someone else's, e.g. an
+ * observation's (see stateSequenceView()); every HMM algorithm takes both. */
 typedef struct _stateSequence {
 	
 	/* the length of this sequence */
 	uint  length;
 	
-	/* the array of states in the sequence */
-	uint* states;
+	/* the array of states in the sequence, one byte each */
+	uint8_t* states;
+	
+	/* the arena holding this sequence, or NULL for the heap */
+	struct arena *arena;
 	
 } StateSequence;
 typedef StateSequence* StateSequenceRef;
@@ -62,8 +75,15 @@ void hmm_train(HmmStateRef hmm, StateSequenceRef* sequences, uint num);
  * Keeps it's own internal copy. */
 StateSequenceRef createStateSequence(uint* states, uint length);
 
+/* Same, but allocated from an arena and reclaimed by arena_reset(). */
+StateSequenceRef createStateSequence_in(struct arena *arena, uint* states, uint length);
+
 void releaseStateSequence(StateSequenceRef);
 
+/* A non-owning view of length symbols; nothing is copied, and it must not
+ * be released or outlive the symbols. */
+StateSequence stateSequenceView(const uint8_t* states, uint length);
+
 //#pragma mark -
 //#pragma mark utility methods for dealing with the model
 
@@ -85,4 +105,10 @@ double* backwardAlgorithm(HmmStateRef hmm, StateSequenceRef sequence);
 double* forwardAlgorithm(HmmStateRef hmm, StateSequenceRef sequence);
 double  getProbability(HmmStateRef hmm, StateSequenceRef sequence);
 
+/* The forward recursion one symbol at a time, for callers that produce the
+ * sequence incrementally.  alpha vectors hold numStates entries. */
+void   forwardInit(HmmStateRef hmm, double *alpha, uint symbol);
+void   forwardStep(HmmStateRef hmm, const double *alpha, double *next, uint symbol);
+double forwardSum (HmmStateRef hmm, const double *alpha);
+
 #endif
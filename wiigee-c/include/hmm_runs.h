@@ -0,0 +1,66 @@
+/*
+ * Run-length aware scoring for observation sequences with long stretches of
+ * one symbol, as a controller held still (or the quantizer's padding)
+ * produces.
+ */
+
+#ifndef _hmm_runs_h
+#define _hmm_runs_h	1
+
+#include "hmm.h"
+
+/* maximum number of squarings kept per symbol: runs up to 2^32-1 */
+#define HMM_POWER_LEVELS 32
+
+/* A run-length encoded sequence: symbols[i] repeated counts[i] times */
+typedef struct _symbolRuns {
+	
+	/* the number of runs */
+	uint numRuns;
+	
+	/* the length of the sequence this encodes */
+	uint length;
+	
+	uint8_t* symbols;
+	uint*    counts;
+	
+} SymbolRuns;
+typedef SymbolRuns* SymbolRunsRef;
+
+/* Powers of the fused per-symbol matrices of one HMM.  The forward step on
+ * symbol s is alpha' = alpha * M_s with M_s[i][j] = p_change[i][j] *
+ * p_emit[j][s], so a run of k symbols s is alpha * M_s^k, which repeated
+ * squaring gets done in log2(k) vector-matrix products.  Each power is
+ * stored divided by its largest entry, so long runs don't underflow. */
+typedef struct _hmmPowers {
+	
+	HmmStateRef hmm;
+	
+	/* numObservations * HMM_POWER_LEVELS matrices, M_s^(2^k), computed on
+	 * first use */
+	double** powers;
+	
+	/* the log of the factor each of them was divided by */
+	double* scales;
+	
+} HmmPowers;
+typedef HmmPowers* HmmPowersRef;
+
+SymbolRunsRef createSymbolRuns(StateSequenceRef sequence);
+void releaseSymbolRuns(SymbolRunsRef runs);
+
+/* The cache is only valid for the HMM tables as they are now; release and
+ * recreate it after training. */
+HmmPowersRef createHmmPowers(HmmStateRef hmm);
+void releaseHmmPowers(HmmPowersRef powers);
+
+/* The log of getProbability(), at a cost proportional to the number of
+ * runs (times log2 of their lengths) rather than the number of symbols.
+ * The forward variables are rescaled after every product, so this stays
+ * accurate far below the smallest double. */
+double getLogProbabilityRuns(HmmPowersRef powers, SymbolRunsRef runs);
+
+/* exp() of the above; 0 where getProbability() underflows too */
+double getProbabilityRuns(HmmPowersRef powers, SymbolRunsRef runs);
+
+#endif
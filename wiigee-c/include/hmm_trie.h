@@ -0,0 +1,57 @@
+/*
+ * Batch scoring of observation sequences that share prefixes: the
+ * sequences go into a trie and the forward recursion runs once per trie
+ * node, so a prefix common to many sequences is only computed once per
+ * model.
+ */
+
+#ifndef _hmm_trie_h
+#define _hmm_trie_h	1
+
+#include "hmm.h"
+
+typedef struct _trieNode {
+	
+	uint8_t symbol;
+	
+	/* depth 1 is the first symbol of a sequence */
+	uint depth;
+	
+	/* node indices, 0 for none (node 0 is the root) */
+	uint firstChild;
+	uint nextSibling;
+	
+	/* whether a sequence ends here, and its probability after scoring */
+	int    terminal;
+	double probability;
+	
+} TrieNode;
+
+typedef struct _sequenceTrie {
+	
+	uint numNodes;
+	uint capNodes;
+	TrieNode* nodes;
+	
+	/* the node each inserted sequence ends at, in insertion order */
+	uint numSequences;
+	uint capSequences;
+	uint* ends;
+	
+	uint maxDepth;
+	
+} SequenceTrie;
+typedef SequenceTrie* SequenceTrieRef;
+
+SequenceTrieRef createSequenceTrie();
+void releaseSequenceTrie(SequenceTrieRef trie);
+
+/* Adds a sequence (a duplicate or a prefix of another one is fine)
+ * and returns its index in the batch. */
+uint trieInsert(SequenceTrieRef trie, StateSequenceRef sequence);
+
+/* out[i] = getProbability(hmm, <sequence i>) for every inserted sequence,
+ * bit for bit. */
+void trieScore(HmmStateRef hmm, SequenceTrieRef trie, double *out);
+
+#endif
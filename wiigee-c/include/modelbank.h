@@ -0,0 +1,87 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _modelbank_h
+#define _modelbank_h    1
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "gesturemodel.h"
+
+/*
+ * Model banks: a trained vocabulary (codebooks, HMM tables and default
+ * probabilities) saved in a form that is mmap'd and used in place.
+ *
+ *   header
+ *   codebook records, one per distinct quantizer
+ *   model records
+ *   the double (and int64) arrays the records point at, 8-byte aligned
+ *
+ * All integers are little-endian, offsets are from the start of the file.
+ */
+
+#define MODELBANK_MAGIC     "WGMB"
+#define MODELBANK_VERSION   1
+
+typedef struct modelbank_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t n_models;
+    uint32_t n_codebooks;
+    uint64_t codebooks_offset;
+    uint64_t models_offset;
+    uint64_t file_len;          // Catches truncated files
+} modelbank_header;
+
+typedef struct modelbank_codebook {
+    int32_t states;             // Padding length of observation sequences
+    int32_t map_size;
+    int32_t seeding;            // enum quantizer_seeding
+    int32_t reserved;
+    double radius;
+    uint64_t map;               // map_size * 3 doubles
+    uint64_t counts;            // map_size int64s
+} modelbank_codebook;
+
+typedef struct modelbank_model {
+    int32_t id;
+    int32_t states;
+    int32_t observations;
+    int32_t codebook;           // Index of the model's codebook record
+    double defaultprobability;
+    uint64_t p_initial;         // states doubles
+    uint64_t p_change;          // states * states doubles
+    uint64_t p_emit;            // states * observations doubles
+} modelbank_model;
+
+/*
+ * A loaded bank.  The models, their quantizers and HMMs belong to the
+ * bank: don't gesturemodel_free() them, modelbank_close() does.  Their
+ * tables point into a private mapping, so retraining a loaded model works
+ * (the pages it writes get copied) without touching the file.
+ *
+ * Banks compiled into the program (see modelbank_emit()) have no mapping
+ * and read-only tables: score with them, don't train or close them.
+ */
+typedef struct modelbank {
+    const char *name;           // Set for compiled-in banks
+    struct modelbank *next;     // In the list of registered banks
+    void *map;
+    size_t map_len;
+    struct gesturemodel **models;
+    int n_models;
+    struct gesturemodel *model_storage;
+    struct quantizer *quantizers;
+    int n_codebooks;
+    HmmState *hmms;
+    long *counts;               // Only where long isn't 64 bits and counts are copied
+} modelbank;
+
+int modelbank_save(const char *, struct gesturemodel **, int);
+struct modelbank *modelbank_open(const char *);
+void modelbank_close(struct modelbank *);
+int modelbank_emit(FILE *, const char *, struct gesturemodel **, int);
+void modelbank_register(struct modelbank *);
+struct modelbank *modelbank_lookup(const char *);
+
+#endif
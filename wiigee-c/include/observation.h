@@ -6,13 +6,21 @@
 #include "hmm.h"
 
 typedef struct observation {
-    int *sequence;
+    uint8_t *sequence;  // Symbols, below MAX_SYMBOLS
     int sequence_len;
+    int sequence_cap;   // Allocated length of sequence
+    struct arena *arena; // Owner of this observation's memory, or NULL for the heap
 } observation;
 
+struct arena;
+
 struct observation *observation_new();
+struct observation *observation_new_in(struct arena *);
+void observation_reserve(struct observation *, int);
 void observation_append(struct observation *, int);
+void observation_append_many(struct observation *, const uint8_t *, int);
 void observation_free(struct observation *);
+StateSequence observation_view(struct observation *);
 StateSequence *observation_to_StateSequence(struct observation *);
 
 #endif
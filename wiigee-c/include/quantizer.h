@@ -3,20 +3,77 @@
 #ifndef _quantizer_h
 #define _quantizer_h    1
 
-#define MAP_SIZE   14
+#define MAP_SIZE   14   // Default codebook size, the wiigee empirical value
 
 #include "gesture.h"
 #include "observation.h"
 
+// How the centroids are placed before k-means starts iterating
+enum quantizer_seeding {
+    SEED_CIRCLE,                // Evenly spaced on the xz and yz circles, as in wiigee
+    SEED_KMEANSPP,              // k-means++ (Arthur & Vassilvitskii 2007) over the training data
+};
+
+#define LOOKUP_LIST    0x8000   // Table entry refers to a candidate list, not a symbol
+#define LOOKUP_EXACT   0xffff   // Table entry: no shortcut, compare against every centroid
+
+/*
+ * Nearest-centroid table over the 256^3 grid of 8-bit accelerometer reports,
+ * optionally coarsened to cells of 2^shift values per axis.  A cell that lies
+ * entirely inside one centroid's region stores that symbol; a cell that
+ * straddles a boundary stores the short list of centroids that can win in it.
+ */
+struct gesture_soa;
+
+typedef struct quantizer_lookup {
+    int origin;                 // Sample value of the first grid cell on every axis
+    int shift;                  // log2 of the cell edge length
+    int cells;                  // Cells per axis, 256 >> shift
+    unsigned short *table;      // cells^3 entries: symbol, LOOKUP_LIST | list, or LOOKUP_EXACT
+    unsigned int *lists;        // Offset of each candidate list in pool
+    int lists_len;
+    unsigned char *pool;        // Candidate lists, each a count followed by that many symbols
+    int pool_len;
+} quantizer_lookup;
+
 typedef struct quantizer {
     double radius;
     int states;
-    double map[MAP_SIZE][3];
+    int map_size;               // Number of centroids, i.e. observation symbols
+    enum quantizer_seeding seeding;
+    unsigned int seed;          // PRNG state for SEED_KMEANSPP
+    double (*map)[3];           // map_size centroids
+    long *counts;               // Samples absorbed per centroid; 1/count is its online learning rate
+    int initialized;            // Set once map holds a codebook (seeded or trained)
+    struct quantizer_lookup *lookup; // Optional, see quantizer_buildLookup()
+    int refs;                   // Owners sharing this codebook, see quantizer_retain()
+    struct arena *arena;        // Owner of this quantizer's memory, or NULL for the heap
 } quantizer;
 
+// Hands out the next gesture of a stream, or NULL at its end.  The gesture
+// stays owned by the source and only has to live until the next call.
+typedef struct gesture *(*gesture_source)(void *);
+
 struct quantizer *quantizer_new(int);
+struct quantizer *quantizer_new_sized(int, int, enum quantizer_seeding);
+struct quantizer *quantizer_new_in(struct arena *, int, int, enum quantizer_seeding);
+struct quantizer *quantizer_retain(struct quantizer *);
 void quantizer_free         (struct quantizer *);
+int quantizer_same          (struct quantizer *, struct quantizer *);
+void quantizer_seed                   (struct quantizer *, struct gesture *);
 void quantizer_trainCenteroids        (struct quantizer *, struct gesture *);
+void quantizer_updateCenteroids       (struct quantizer *, struct gesture *);
+void quantizer_trainCenteroidsStream  (struct quantizer *, gesture_source, void *);
+void quantizer_trainCenteroids_soa    (struct quantizer *, struct gesture_soa *);
+void quantizer_updateCenteroids_soa   (struct quantizer *, struct gesture_soa *);
 struct observation *quantizer_getObservationSequence (struct quantizer *, struct gesture *);
+struct observation *quantizer_getObservationSequence_soa (struct quantizer *, struct gesture_soa *);
+void quantizer_trainCenteroids_u8     (struct quantizer *, const uint8_t *, const uint8_t *, const uint8_t *, int);
+void quantizer_updateCenteroids_u8    (struct quantizer *, const uint8_t *, const uint8_t *, const uint8_t *, int);
+struct observation *quantizer_getObservationSequence_u8 (struct quantizer *, const uint8_t *, const uint8_t *, const uint8_t *, int);
+int quantizer_symbol                  (struct quantizer *, double, double, double);
+long quantizer_buildLookup            (struct quantizer *, int, int);
+long quantizer_lookupSize             (struct quantizer *);
+void quantizer_dropLookup             (struct quantizer *);
 
 #endif
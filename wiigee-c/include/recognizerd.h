@@ -0,0 +1,105 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _recognizerd_h
+#define _recognizerd_h    1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The wiigee-recognizerd protocol.  Clients connect to the daemon's Unix
+ * socket and exchange frames, each a header followed by length bytes of
+ * payload.  Both ends are on the same host, so everything is in native
+ * byte order.
+ *
+ *   OPEN      session             start a session, no payload
+ *   SAMPLES   session, samples    accelerometer reports of the current
+ *                                 segment, oldest first
+ *   END       session             the segment is over: classify it
+ *   CLOSE     session             forget the session
+ *
+ * For every END the daemon answers with a RESULT frame for that session:
+ * a recognizerd_result, then its n_scores scores, most probable first.
+ * (A daemon started with -e instead finds the gestures in the samples
+ * itself, and sends a RESULT for each as it ends; END then only marks the
+ * end of the stream.)  A sample more than RECOGNIZERD_MAX_GAP resampling
+ * periods after the one before ends the segment first, as an END would.
+ * If the daemon was started to, it also sends PROVISIONAL frames (the same
+ * payload, for the segment so far) while a segment goes on, and at most
+ * one COMMIT frame once a model leads clearly enough to act on.
+ * Requests it can't make sense of get an ERROR frame back.  A client may
+ * have any number of sessions open at once; their ids are its own.
+ */
+
+#define RECOGNIZERD_SOCKET          "/tmp/wiigee-recognizerd.sock"
+#define RECOGNIZERD_MAX_PAYLOAD     (1 << 20)
+#define RECOGNIZERD_MAX_GAP         50      // Periods between samples of a segment
+
+enum recognizerd_type {
+    RECOGNIZERD_OPEN = 1,
+    RECOGNIZERD_SAMPLES,
+    RECOGNIZERD_END,
+    RECOGNIZERD_CLOSE,
+    RECOGNIZERD_RESULT,
+    RECOGNIZERD_ERROR,
+    RECOGNIZERD_PROVISIONAL,
+    RECOGNIZERD_COMMIT,
+};
+
+typedef struct recognizerd_header {
+    uint32_t length;            // Of the payload
+    uint16_t type;              // enum recognizerd_type
+    uint16_t reserved;
+    uint32_t session;
+} recognizerd_header;
+
+typedef struct recognizerd_sample {
+    int64_t t;                  // Nanoseconds, any epoch, never decreasing
+    uint8_t x, y, z;            // Raw 8-bit reports
+    uint8_t reserved[5];
+} recognizerd_sample;
+
+typedef struct recognizerd_result {
+    int32_t samples;            // Resampled samples the gesture came to
+    int32_t n_scores;           // 0 if nothing matched
+} recognizerd_result;
+
+typedef struct recognizerd_score {
+    int32_t id;                 // The model's id
+    int32_t reserved;
+    double probability;
+} recognizerd_score;
+
+// Incoming bytes, split into frames as they complete
+typedef struct recognizerd_reader {
+    char *buf;
+    size_t len;                 // Bytes held
+    size_t pos;                 // Start of the first unparsed frame
+    size_t cap;
+} recognizerd_reader;
+
+// Outgoing bytes, waiting for the socket to take them
+typedef struct recognizerd_writer {
+    char *buf;
+    size_t len;                 // Bytes held
+    size_t pos;                 // Start of the first unwritten byte
+    size_t cap;
+} recognizerd_writer;
+
+typedef struct recognizerd_frame {
+    struct recognizerd_header header;
+    const void *payload;        // Into the reader, until its next fill
+} recognizerd_frame;
+
+int recognizerd_listen(const char *);
+int recognizerd_connect(const char *);
+int recognizerd_send(int, int, uint32_t, const void *, uint32_t);
+int recognizerd_fill(struct recognizerd_reader *, int);
+int recognizerd_next(struct recognizerd_reader *, struct recognizerd_frame *);
+int recognizerd_peek(struct recognizerd_reader *, struct recognizerd_frame *);
+void recognizerd_reader_free(struct recognizerd_reader *);
+void recognizerd_queue(struct recognizerd_writer *, int, uint32_t, const void *, uint32_t);
+int recognizerd_flush(struct recognizerd_writer *, int);
+void recognizerd_writer_free(struct recognizerd_writer *);
+
+#endif
@@ -0,0 +1,54 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _recognizerd_server_h
+#define _recognizerd_server_h    1
+
+#include <stdint.h>
+
+#include "modelbank.h"
+#include "session.h"
+
+/*
+ * The wiigee-recognizerd server (see recognizerd.h for the protocol), as a
+ * library so it can run in-process.  Every client session gets a
+ * recognition session (see session.h); the thread in
+ * recognizerd_server_run() only moves samples from the sockets into the
+ * sessions' rings, and a pool of workers classifies whichever sessions
+ * have samples waiting, queueing the results for the client.  Neither
+ * waits on a client: results go out as its socket takes them, a client
+ * whose session's ring is full isn't read from until the workers catch
+ * up, and neither is one with RECOGNIZERD_BACKLOG bytes of results it
+ * hasn't read.  A session that is closed, or whose client hangs up, has
+ * whatever is left in its ring processed first, so every END gets its
+ * RESULT.
+ *
+ * Set the options after recognizerd_server_new(), before running it.
+ */
+
+#define RECOGNIZERD_RING        4096    // Events per session
+#define RECOGNIZERD_COMMIT_MIN  3       // Samples before a commit
+#define RECOGNIZERD_BACKLOG     1048576 // Bytes queued for a client
+
+struct recognizerd_client;
+
+typedef struct recognizerd_server {
+    struct modelbank *bank;     // Shared and read-only; not owned
+    int listener;               // Owned
+    struct session_pool *pool;
+    int64_t period;             // Resampling period, ns; hmm_grab's SAMPLE_PERIOD by default
+    int64_t cadence;            // Between provisional results, see session_anytime(); 0 for none
+    double margin;              // Commit margin, likewise; 0 for none
+    int by_motion;              // Find the gestures by motion, see session_endpoint()
+    struct recognizerd_client **clients;
+    int n_clients;
+    int wake[2];                // A pipe; a byte written interrupts the poll
+    int stopping;               // Only touched through __atomic builtins
+    unsigned long segments, samples;
+} recognizerd_server;
+
+struct recognizerd_server *recognizerd_server_new(struct modelbank *, int, int);
+void recognizerd_server_free(struct recognizerd_server *);
+int recognizerd_server_run(struct recognizerd_server *);
+void recognizerd_server_stop(struct recognizerd_server *);
+
+#endif
@@ -0,0 +1,45 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _replay_h
+#define _replay_h    1
+
+#include <stdint.h>
+
+#include "ring.h"
+
+/*
+ * Recorded gestures played back as the report sequence a wiimote would
+ * send: a B press, the accelerometer reports, a release, for every
+ * gesture of a wmdump text log or a binary capture file.  Reports keep
+ * their recorded spacing; the pause between gestures is kept too, unless
+ * it's longer than REPLAY_MAX_GAP (or the gestures come from different
+ * recordings), in which case it becomes REPLAY_GAP.
+ *
+ * replay_next() paces the reports: in real time (speed 1), faster
+ * (speed > 1) or as fast as they can be taken (REPLAY_ASAP).  Either way
+ * report times stay those of the recording, so whatever consumes them
+ * sees the same gestures at any speed.
+ */
+
+#define REPLAY_ASAP         0.0
+#define REPLAY_GAP          500000000LL     // ns
+#define REPLAY_MAX_GAP      2000000000LL
+
+typedef struct replay {
+    struct ring_event *reports;     // t: ns on the replay's timeline, from 0
+    int n_reports;
+    int cap;
+    int n_gestures;
+    double speed;
+    int64_t started;                // ring_now() at replay_start()
+    int next;
+    int64_t late;                   // Worst lateness of a report so far, ns
+} replay;
+
+struct replay *replay_load(const char *);
+void replay_free(struct replay *);
+void replay_start(struct replay *, double);
+int replay_next(struct replay *, struct ring_event *, int);
+int64_t replay_duration(struct replay *);
+
+#endif
@@ -0,0 +1,42 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _resampler_h
+#define _resampler_h    1
+
+#include <stdint.h>
+
+/*
+ * Streaming resampler: turns irregularly timed accelerometer reports into
+ * one averaged sample per period, as they arrive.  Each report's value is
+ * held until the next report, and each output is the mean over its period
+ * in fixed point; the last report is held to the end of the final period.
+ * Times are in any unit, as long as the period uses the same one.
+ */
+
+typedef struct resampler_sample {
+    int32_t x, y, z;            // Mean values, with frac_bits fractional bits
+    int64_t t;                  // Start of the period
+} resampler_sample;
+
+typedef struct resampler {
+    int64_t period;
+    int frac_bits;
+    int64_t ax, ay, az;         // Value * time accumulated in the current period
+    int64_t at;                 // Time accumulated in the current period
+    int64_t start;              // Start of the current period
+    int have_last;
+    int lx, ly, lz;             // The latest report, held until the next one
+    int64_t lt;
+    struct resampler_sample *out;   // Caller's buffer
+    int out_len;
+    int out_cap;
+    unsigned long overflow;     // Periods lost to a full buffer
+} resampler;
+
+void resampler_init(struct resampler *, int64_t, int, struct resampler_sample *, int);
+void resampler_reset(struct resampler *);
+void resampler_consume(struct resampler *);
+int resampler_push(struct resampler *, int, int, int, int64_t);
+int resampler_finish(struct resampler *);
+
+#endif
@@ -0,0 +1,65 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _ring_h
+#define _ring_h    1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single-producer, single-consumer ring of fixed-size input events, for
+ * handing reports from the cwiid callback thread to a recognition thread
+ * without locks or allocation.  One thread may push, one other thread may
+ * pop; anything else needs outside locking.
+ */
+
+#define RING_CACHE_LINE 64
+
+enum ring_event_type {
+    RING_ACC,                   // Accelerometer report: x, y, z
+    RING_BUTTON,                // Button report: buttons
+};
+
+/*
+ * Event times are on whatever monotonic timeline the producer has:
+ * ring_now() for reports stamped on arrival, a replay's or a client's
+ * (never a wall clock, which can step back).  All events pushed into one
+ * ring have to share it, buttons and reports alike, so consumers can order
+ * and resample them together; comparing them to ring_now() is only
+ * meaningful for a ring_now() producer.
+ */
+typedef struct ring_event {
+    int64_t t;                  // When the report was made, nanoseconds
+    uint16_t type;              // enum ring_event_type
+    uint16_t buttons;
+    uint8_t x, y, z;            // Raw 8-bit reports
+    uint8_t reserved;
+} ring_event;
+
+typedef struct ring {
+    struct ring_event *slots;
+    size_t mask;                // Capacity - 1; the capacity is a power of two
+
+    // The producer's line: its index, and the last tail it saw
+    char pad0[RING_CACHE_LINE];
+    size_t head;
+    size_t tail_seen;
+    unsigned long dropped;      // Pushes refused because the ring was full
+
+    // The consumer's line
+    char pad1[RING_CACHE_LINE];
+    size_t tail;
+    size_t head_seen;
+    char pad2[RING_CACHE_LINE];
+} ring;
+
+struct ring *ring_new(size_t);
+void ring_free(struct ring *);
+int ring_push(struct ring *, const struct ring_event *);
+size_t ring_pop(struct ring *, struct ring_event *, size_t);
+size_t ring_pop_wait(struct ring *, struct ring_event *, size_t, int64_t);
+size_t ring_pending(struct ring *);
+unsigned long ring_dropped(struct ring *);
+int64_t ring_now();
+
+#endif
@@ -0,0 +1,34 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _scorer_h
+#define _scorer_h    1
+
+#include "gesturemodel.h"
+
+/*
+ * Quantize-and-score pipeline: raw samples go in one at a time, and each
+ * model's quantizer symbol is fed straight into that model's forward
+ * recursion, so no observation, StateSequence or forward table is built.
+ * Models sharing a codebook (see gesturemodel_trainShared()) share the
+ * quantization, so a sample is quantized once per distinct codebook.
+ */
+typedef struct scorer {
+    int n_models;
+    struct gesturemodel **models;   // Not owned
+    int max_states;
+    double *alpha;                  // n_models rows of max_states: the current forward column
+    double *scratch;                // Two rows, for stepping and padding
+    int *last;                      // Last symbol fed to each model
+    int *leader;                    // First model with the same codebook; only leaders quantize
+    int n_codebooks;                // Distinct codebooks, i.e. quantizations per sample
+    int length;                     // Samples fed so far
+} scorer;
+
+struct scorer *scorer_new(struct gesturemodel **models, int n_models);
+void scorer_free(struct scorer *this);
+void scorer_reset(struct scorer *this);
+void scorer_push(struct scorer *this, double x, double y, double z);
+void scorer_push_gesture(struct scorer *this, struct gesture *gesture);
+void scorer_probabilities(struct scorer *this, double *out);
+
+#endif
@@ -0,0 +1,110 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _session_h
+#define _session_h    1
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "endpoint.h"
+#include "modelbank.h"
+#include "resampler.h"
+#include "ring.h"
+#include "scorer.h"
+
+/*
+ * Recognition sessions: everything one controller needs between its
+ * reports and a recognized gesture, so several can run at once against a
+ * single shared bank.  The device's callback thread is the producer: it
+ * session_push()es reports and never blocks.  Whoever processes the
+ * session (one thread at a time; see struct session_pool) resamples the
+ * reports as they come, scores each sample against every model, and
+ * hands a result to the session's callback when the trigger is released.
+ *
+ * With session_anytime(), results also come while the trigger is held:
+ * provisional ones at a fixed cadence, and one commit as soon as the
+ * leading model is far enough ahead, so the application can act before
+ * the release.  After the commit only the final result comes, at the
+ * release, as always.
+ *
+ * With session_endpoint(), there is no trigger: the session finds the
+ * gestures in the stream of reports itself (see endpoint.h), and any
+ * button event just ends the stream.
+ */
+
+#define SESSION_TRIGGER     0x0004      // The B button
+#define SESSION_BATCH       64          // Events taken from the ring at once
+
+enum session_result_kind {
+    SESSION_FINAL,              // The trigger was released
+    SESSION_PROVISIONAL,        // The gesture so far, while the trigger is held
+    SESSION_COMMITTED,          // Provisional, but the leader is far enough ahead to act on
+};
+
+typedef struct session_result {
+    enum session_result_kind kind;
+    int model;                  // Index into the bank, or -1 if nothing matched
+    int id;                     // That model's id, or -1
+    double probability;         // Its posterior
+    double margin;              // Over the runner-up's posterior
+    const double *probabilities;    // Every model's posterior, during the callback only; or NULL
+    int samples;                // Resampled samples in the gesture
+    int64_t start, end;         // Trigger press and release (or the latest report), ring_now() time
+} session_result;
+
+struct session;
+typedef void (*session_callback)(struct session *, const struct session_result *, void *);
+
+typedef struct session {
+    int id;
+    struct modelbank *bank;     // Shared and read-only; not owned
+    struct ring *input;
+    struct resampler resampler;
+    struct resampler_sample resampled[SESSION_BATCH];
+    struct scorer *scorer;      // Per session: it holds the forward state
+    double *matches;            // n_models scratch entries
+    int buttons;
+    int64_t pressed_at;
+    int64_t cadence;            // Between provisional results, report time; 0 for none
+    double commit_margin;       // Commit when the leader is this far ahead; 0 never
+    int commit_min;             // But not on fewer samples than this
+    int64_t next_provisional;
+    int committed;              // This gesture's commit has been delivered
+    struct endpoint *endpoint;  // Segmenting by motion; NULL to follow the trigger
+    session_callback callback;
+    void *ctx;
+    unsigned long gestures;     // Results delivered
+    int busy;                   // Claimed by a pool worker; under the pool's lock
+} session;
+
+struct session *session_new(int, struct modelbank *, int64_t, size_t, session_callback, void *);
+void session_free(struct session *);
+int session_push(struct session *, const struct ring_event *);
+void session_anytime(struct session *, int64_t, double, int);
+void session_endpoint(struct session *, const struct endpoint *);
+size_t session_process(struct session *);
+
+/*
+ * A fixed set of worker threads sharing any number of sessions.  A worker
+ * claims a session with reports waiting, drains it outside the lock and
+ * gives it back, so each session is processed by one thread at a time and
+ * in order, while different sessions proceed in parallel.
+ */
+typedef struct session_pool {
+    pthread_t *threads;
+    int n_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t released;    // A worker gave a session back
+    struct session **sessions;
+    int n_sessions;
+    int cap;
+    int next;                   // Where the next scan starts, for fairness
+    int stop;
+} session_pool;
+
+struct session_pool *session_pool_new(int);
+void session_pool_free(struct session_pool *);
+void session_pool_add(struct session_pool *, struct session *);
+void session_pool_remove(struct session_pool *, struct session *);
+
+#endif
@@ -0,0 +1,110 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _spotter_h
+#define _spotter_h    1
+
+#include <stdint.h>
+
+#include "gesturemodel.h"
+
+/*
+ * Gesture spotting: finds the vocabulary's gestures in an unbounded stream
+ * of samples, with no trigger and no segmentation beforehand.  The models'
+ * HMMs run side by side with a filler model that explains whatever isn't
+ * a gesture.  The filler is made of the models' own states, all of them,
+ * each keeping its self transition and going to any other at a flat 1/(n-1):
+ * it matches any piece of any gesture, held any time, but not in order,
+ * so a model only beats it on the gestures it was trained for.  (Models
+ * with different codebooks compete by their likelihoods, as in the
+ * classifier.)
+ *
+ * Viterbi decoding is by token passing: a token sits in every state,
+ * carrying its best path's score and where that path entered the gesture.
+ * Between samples, a hub takes the best token leaving the filler or any
+ * model's last state, and passes it into the first states of all of them.
+ * Entering a gesture costs `penalty` (in log probability), trading misses
+ * for false alarms.  Each path's history is a chain of detection records;
+ * a detection is reported once every live token's history agrees on it,
+ * so it is never retracted, usually within a few samples of the gesture's
+ * end.  Tokens falling `beam` behind the best, or in a gesture for more
+ * than max_len samples, are dropped, and the records are a fixed pool:
+ * memory stays bounded however long the stream.
+ */
+
+#define SPOTTER_FLOOR   1e-6    // Emission probabilities below this count as this
+
+typedef struct spotter_token {
+    double score;               // Log probability of the best path here
+    int64_t start;              // Time of the gesture's first sample
+    int len;                    // Samples in the gesture so far
+    int record;                 // The detection before the gesture, or -1
+} spotter_token;
+
+typedef struct spotter_record {
+    int model;
+    int64_t start, end;
+    double score;
+    int parent;                 // The detection before this one, or -1
+    int depth;                  // Detections before this one
+    int refs;                   // Tokens and records pointing here; free if 0
+    int reported;
+} spotter_record;
+
+typedef struct spotter_detection {
+    int model;                  // Index into the models
+    int id;                     // That model's id
+    int64_t start, end;         // Times of the gesture's first and last samples
+    double score;               // How far its path beat the filler's, in log probability, penalty not counted
+} spotter_detection;
+
+struct spotter;
+typedef void (*spotter_callback)(struct spotter *, const struct spotter_detection *, void *);
+
+// A model's tables, in logs
+typedef struct spotter_model {
+    struct gesturemodel *model;     // Not owned
+    int states, observations;
+    double *log_init;
+    double *log_change;
+    double *log_emit;
+    int leader;                 // First model with the same codebook; only leaders quantize
+    int symbol;                 // This sample's
+} spotter_model;
+
+typedef struct spotter {
+    double penalty;             // Log probability a gesture has to beat the filler by
+    double beam;                // Tokens this far behind the best are dropped
+    int min_len;                // Samples in a gesture at least; 0 for each model's states
+    int max_len;                // And at most
+
+    int n_models;
+    struct spotter_model *models;
+    int max_states;
+
+    int n_filler;               // States in the filler: every model's
+    int *filler_model, *filler_state;   // Whose each one is
+    double *filler_stay;        // Log of its self transition
+
+    int n_tokens;               // n_models rows of max_states, then the filler's
+    struct spotter_token *tokens;
+    struct spotter_token *next;
+    struct spotter_token hub;
+
+    struct spotter_record *records;
+    int n_records;
+    int free_record;            // Head of the free list, linked through parent; or -1
+
+    spotter_callback callback;
+    void *ctx;
+    unsigned long samples;
+    unsigned long detections;   // Reported
+    unsigned long forced;       // Reported early because the records ran out
+} spotter;
+
+struct spotter *spotter_new(struct gesturemodel **, int, spotter_callback, void *);
+void spotter_free(struct spotter *);
+void spotter_reset(struct spotter *);
+void spotter_push(struct spotter *, double, double, double, int64_t);
+void spotter_flush(struct spotter *);
+
+#endif
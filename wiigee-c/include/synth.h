@@ -0,0 +1,48 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _synth_h
+#define _synth_h    1
+
+#include <stdint.h>
+
+#include "gesturemodel.h"
+
+/*
+ * Synthetic gestures, for corpora bigger than anybody wants to record.
+ * They are either sampled from a trained model (a walk through its HMM,
+ * each emitted symbol becoming its codebook centroid plus gaussian
+ * jitter) or made from a real gesture by augmentation (a random time
+ * warp, rotation about the resting point and noise).  Everything comes
+ * from the generator's own seed, so the same seed gives the same corpus.
+ *
+ * Values are raw 8-bit reports, like the ones captures hold; the models
+ * sampled from should have been trained on such (see capture.h).
+ */
+
+#define SYNTH_REST  128         // Report value for no acceleration
+
+typedef struct synth {
+    uint64_t seed;              // xorshift state
+    int spare_valid;            // Box-Muller makes normals in pairs
+    double spare;
+
+    // Sampling
+    int min_len, max_len;       // Reports per sampled gesture
+    double jitter;              // Std deviation around centroids, report units
+
+    // Augmentation
+    double warp;                // Speed varies within 1 +- warp; below 1
+    double rotation;            // Up to this many radians, about a random axis
+    double noise;               // Std deviation added to every report
+
+    int64_t period;             // Time between reports, us
+} synth;
+
+void synth_init(struct synth *, uint64_t);
+double synth_uniform(struct synth *);
+double synth_normal(struct synth *);
+int synth_sample(struct synth *, struct gesturemodel *, uint8_t *, uint8_t *, uint8_t *, int64_t *, int);
+int synth_augment(struct synth *, const uint8_t *, const uint8_t *, const uint8_t *, const int64_t *, int,
+                  uint8_t *, uint8_t *, uint8_t *, int64_t *, int);
+
+#endif
@@ -0,0 +1,34 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _wmdump_h
+#define _wmdump_h    1
+
+#include <stdint.h>
+
+/*
+ * Reader for the text logs noodling/wmdump writes: "Acc Report: x=131,
+ * y=127, z=151   1244699740 755215" lines, split into gestures by the
+ * "Button Report: 0004" (B pressed) and "Button Report: 0000" (released)
+ * lines around them.
+ */
+
+typedef struct wmdump_segment {
+    int gesture;                // Releases seen before this segment in its file
+    uint8_t *x, *y, *z;         // Raw 8-bit accelerometer reports
+    int64_t *t;                 // Report times, microseconds since the epoch
+    int data_len;
+    int data_cap;
+} wmdump_segment;
+
+// Called once per non-empty segment; a non-zero return stops the parse.
+// The segment is only valid for the duration of the call.
+typedef int (*wmdump_handler)(void *, const struct wmdump_segment *);
+
+struct gesture;
+struct arena;
+
+int wmdump_parse(const char *, wmdump_handler, void *);
+struct gesture *wmdump_gesture(const struct wmdump_segment *, struct arena *);
+int wmdump_name(const char *, char *, int, char *, int);
+
+#endif
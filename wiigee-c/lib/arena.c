@@ -0,0 +1,118 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+#define ARENA_ALIGN 16
+
+static size_t align_up(size_t n)
+{
+    return (n + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static struct arena_block *block_new(size_t size)
+{
+    struct arena_block *block = xalloc(sizeof(struct arena_block));
+    block->size = size;
+    block->used = 0;
+    block->data = xalloc(size);
+    return block;
+}
+
+static void blocks_free(struct arena_block *block)
+{
+    while (block) {
+        struct arena_block *next = block->next;
+        free(block->data);
+        free(block);
+        block = next;
+    }
+}
+
+struct arena *arena_new(size_t block_size)
+{
+    struct arena *this = xalloc(sizeof(struct arena));
+    this->block_size = align_up(block_size);
+    this->blocks = block_new(this->block_size);
+    return this;
+}
+
+void arena_free(struct arena *this)
+{
+    blocks_free(this->blocks);
+    free(this);
+}
+
+// Zeroed memory for n bytes, valid until the next arena_reset()
+void *arena_alloc(struct arena *this, size_t n)
+{
+    struct arena_block *block = this->blocks;
+
+    n = align_up(n);
+    if (block->used + n > block->size) {
+        block = block_new(MAX(this->block_size, n));
+        block->next = this->blocks;
+        this->blocks = block;
+    }
+
+    void *p = block->data + block->used;
+    block->used += n;
+    this->used += n;
+    memset(p, 0, n);
+    return p;
+}
+
+/*
+ * realloc() for arena memory.  The most recent allocation is extended in
+ * place when its block has room; anything else is copied, and the old copy
+ * stays dead weight until the next reset.
+ */
+void *arena_grow(struct arena *this, void *p, size_t old_n, size_t new_n)
+{
+    struct arena_block *block = this->blocks;
+
+    if (!p)
+        return arena_alloc(this, new_n);
+
+    old_n = align_up(old_n);
+    new_n = align_up(new_n);
+    if (new_n <= old_n)
+        return p;
+
+    if ((char *)p + old_n == block->data + block->used
+        && block->used - old_n + new_n <= block->size) {
+        memset(block->data + block->used, 0, new_n - old_n);
+        block->used += new_n - old_n;
+        this->used += new_n - old_n;
+        return p;
+    }
+
+    void *q = arena_alloc(this, new_n);
+    memcpy(q, p, old_n);
+    return q;
+}
+
+/*
+ * Reclaim every allocation.  If the last round overflowed into more blocks,
+ * they are replaced by one block big enough for all of it, so the next
+ * round of the same size fits without allocating.
+ */
+void arena_reset(struct arena *this)
+{
+    this->high_water = MAX(this->high_water, this->used);
+    this->used = 0;
+
+    if (this->blocks->next) {
+        size_t total = 0;
+        for (struct arena_block *block = this->blocks; block; block = block->next)
+            total += block->size;
+
+        blocks_free(this->blocks);
+        this->blocks = block_new(total);
+    }
+
+    this->blocks->used = 0;
+}
@@ -0,0 +1,322 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // mmap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "gesture.h"
+#include "util.h"
+
+static const char *hand_names[] = { "unknown", "left", "right" };
+
+enum capture_hand capture_hand_from_name(const char *name)
+{
+    if (!strcmp(name, "left"))
+        return HAND_LEFT;
+    if (!strcmp(name, "right"))
+        return HAND_RIGHT;
+    return HAND_UNKNOWN;
+}
+
+const char *capture_hand_name(enum capture_hand hand)
+{
+    return (unsigned)hand <= HAND_RIGHT ? hand_names[hand] : hand_names[HAND_UNKNOWN];
+}
+
+// The file format is little-endian and read in place
+static int little_endian()
+{
+    uint16_t one = 1;
+    return *(uint8_t *)&one == 1;
+}
+
+/*
+ * Writing
+ */
+
+struct capture_writer *capture_writer_new()
+{
+    return xalloc(sizeof(struct capture_writer));
+}
+
+void capture_writer_free(struct capture_writer *this)
+{
+    free(this->x);
+    free(this->y);
+    free(this->z);
+    free(this->times);
+    free(this->strings);
+    free(this->index);
+    free(this);
+}
+
+// Offset of user in the string table, adding it on first sight
+static uint32_t intern_user(struct capture_writer *this, const char *user)
+{
+    int len = strlen(user) + 1;
+
+    for (int off = 0; off < this->strings_len; off += strlen(this->strings + off) + 1) {
+        if (!strcmp(this->strings + off, user))
+            return off;
+    }
+
+    if (this->strings_len + len > this->strings_cap) {
+        this->strings_cap = MAX(2 * this->strings_cap, this->strings_len + len);
+        this->strings = xrealloc(this->strings, this->strings_cap);
+    }
+    memcpy(this->strings + this->strings_len, user, len);
+    this->strings_len += len;
+    return this->strings_len - len;
+}
+
+static void put_varint(struct capture_writer *this, int64_t delta)
+{
+    uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);   // zigzag
+
+    if (this->times_len + 10 > this->times_cap) {
+        this->times_cap = MAX(2 * this->times_cap, 4096);
+        this->times = xrealloc(this->times, this->times_cap);
+    }
+    while (v >= 0x80) {
+        this->times[this->times_len++] = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    this->times[this->times_len++] = v;
+}
+
+void capture_writer_add(struct capture_writer *this, const char *user, enum capture_hand hand, int gesture,
+                        const uint8_t *x, const uint8_t *y, const uint8_t *z, const int64_t *t, int n)
+{
+    if (this->n_gestures == this->index_cap) {
+        this->index_cap = MAX(2 * this->index_cap, 64);
+        this->index = xrealloc(this->index, sizeof(struct capture_entry) * this->index_cap);
+    }
+    if (this->n_samples + n > this->samples_cap) {
+        this->samples_cap = MAX(2 * this->samples_cap, this->n_samples + n);
+        this->x = xrealloc(this->x, this->samples_cap);
+        this->y = xrealloc(this->y, this->samples_cap);
+        this->z = xrealloc(this->z, this->samples_cap);
+    }
+
+    struct capture_entry *entry = &this->index[this->n_gestures++];
+    memset(entry, 0, sizeof(*entry));
+    entry->user     = intern_user(this, user);
+    entry->hand     = hand;
+    entry->gesture  = gesture;
+    entry->data_len = n;
+    entry->first    = this->n_samples;
+    entry->times    = this->times_len;
+    entry->t0       = n ? t[0] : 0;
+
+    memcpy(this->x + this->n_samples, x, n);
+    memcpy(this->y + this->n_samples, y, n);
+    memcpy(this->z + this->n_samples, z, n);
+    this->n_samples += n;
+
+    for (int i = 1; i < n; i++)
+        put_varint(this, t[i] - t[i-1]);
+}
+
+static int write_at(FILE *f, uint64_t offset, const void *p, size_t n)
+{
+    static const char zeros[8];
+    long at = ftell(f);
+
+    // Pad up to the (aligned) offset the header promises
+    if (at < 0 || (uint64_t)at > offset || fwrite(zeros, 1, offset - at, f) != offset - at)
+        return -1;
+    return fwrite(p, 1, n, f) == n ? 0 : -1;
+}
+
+#define ALIGN8(n)   (((n) + 7) & ~(uint64_t)7)
+
+// Returns 0, or -1 if the file couldn't be written
+int capture_writer_save(struct capture_writer *this, const char *path)
+{
+    if (!little_endian())
+        die("capture files are only written on little-endian hosts\n");
+
+    struct capture_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_MAGIC, 4);
+    header.version        = CAPTURE_VERSION;
+    header.n_gestures     = this->n_gestures;
+    header.strings_len    = this->strings_len;
+    header.n_samples      = this->n_samples;
+    header.columns_offset = sizeof(header);
+    header.times_offset   = header.columns_offset + 3 * this->n_samples;
+    header.times_len      = this->times_len;
+    header.strings_offset = header.times_offset + this->times_len;
+    header.index_offset   = ALIGN8(header.strings_offset + this->strings_len);
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+
+    int err = write_at(f, 0, &header, sizeof(header))
+           || write_at(f, header.columns_offset, this->x, this->n_samples)
+           || write_at(f, header.columns_offset + this->n_samples, this->y, this->n_samples)
+           || write_at(f, header.columns_offset + 2 * this->n_samples, this->z, this->n_samples)
+           || write_at(f, header.times_offset, this->times, this->times_len)
+           || write_at(f, header.strings_offset, this->strings, this->strings_len)
+           || write_at(f, header.index_offset, this->index, sizeof(struct capture_entry) * this->n_gestures);
+
+    if (fclose(f))
+        err = 1;
+    return err ? -1 : 0;
+}
+
+/*
+ * Reading
+ */
+
+// Skips count varints starting at p, or returns NULL if they run past end
+static const uint8_t *skip_varints(const uint8_t *p, const uint8_t *end, uint32_t count)
+{
+    while (count--) {
+        int bytes = 0;
+        do {
+            if (p == end || ++bytes > 10)
+                return NULL;
+        } while (*p++ & 0x80);
+    }
+    return p;
+}
+
+// Everything the views will point at has to lie inside the mapping
+static int capture_valid(struct capture *this)
+{
+    const struct capture_header *h = this->header;
+    uint64_t len = this->map_len;
+
+    if (memcmp(h->magic, CAPTURE_MAGIC, 4) || h->version != CAPTURE_VERSION)
+        return 0;
+    if (h->columns_offset > len || h->n_samples > (len - h->columns_offset) / 3)
+        return 0;
+    if (h->times_offset > len || h->times_len > len - h->times_offset)
+        return 0;
+    if (h->strings_offset > len || h->strings_len > len - h->strings_offset)
+        return 0;
+    if (h->strings_len && this->strings[h->strings_len - 1] != '\0')
+        return 0;
+    if (h->index_offset % 8 || h->index_offset > len
+        || h->n_gestures > (len - h->index_offset) / sizeof(struct capture_entry))
+        return 0;
+
+    for (uint32_t i = 0; i < h->n_gestures; i++) {
+        const struct capture_entry *e = &this->index[i];
+
+        if (e->user >= h->strings_len || e->first > h->n_samples || e->data_len > h->n_samples - e->first)
+            return 0;
+        if (e->times > h->times_len || (e->data_len
+            && !skip_varints(this->times + e->times, this->times + h->times_len, e->data_len - 1)))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Maps the capture file at path.  Returns NULL if it can't be opened or
+ * isn't a capture file this code understands.
+ */
+struct capture *capture_open(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct capture_header) || !little_endian()) {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    struct capture *this = xalloc(sizeof(struct capture));
+    const struct capture_header *h = map;
+    this->map     = map;
+    this->map_len = st.st_size;
+    this->header  = h;
+
+    // Offsets are only dereferenced once capture_valid() has checked them
+    this->columns = (const uint8_t *)map + MIN(h->columns_offset, this->map_len);
+    this->times   = (const uint8_t *)map + MIN(h->times_offset, this->map_len);
+    this->strings = (const char *)map + MIN(h->strings_offset, this->map_len);
+    this->index   = (const struct capture_entry *)((const uint8_t *)map + MIN(h->index_offset, this->map_len));
+
+    if (!capture_valid(this)) {
+        capture_close(this);
+        return NULL;
+    }
+    return this;
+}
+
+void capture_close(struct capture *this)
+{
+    munmap(this->map, this->map_len);
+    free(this);
+}
+
+int capture_count(struct capture *this)
+{
+    return this->header->n_gestures;
+}
+
+void capture_get(struct capture *this, int i, struct capture_view *view)
+{
+    const struct capture_entry *e = &this->index[i];
+    uint64_t n = this->header->n_samples;
+
+    view->user     = this->strings + e->user;
+    view->hand     = e->hand;
+    view->gesture  = e->gesture;
+    view->data_len = e->data_len;
+    view->x        = this->columns + e->first;
+    view->y        = this->columns + n + e->first;
+    view->z        = this->columns + 2 * n + e->first;
+    view->times    = this->times + e->times;
+    view->t0       = e->t0;
+}
+
+// Decodes the view's data_len timestamps into t
+void capture_timestamps(const struct capture_view *view, int64_t *t)
+{
+    const uint8_t *p = view->times;
+
+    if (view->data_len < 1)
+        return;
+
+    t[0] = view->t0;
+    for (int i = 1; i < view->data_len; i++) {
+        uint64_t v = 0;
+        int shift = 0;
+        do {
+            v |= (uint64_t)(*p & 0x7f) << shift;
+            shift += 7;
+        } while (*p++ & 0x80);
+        t[i] = t[i-1] + (int64_t)((v >> 1) ^ -(v & 1));
+    }
+}
+
+// A struct gesture copy of the view, for code that wants one
+struct gesture *capture_gesture(const struct capture_view *view, struct arena *arena)
+{
+    struct gesture *gesture = gesture_new_in(arena);
+
+    gesture_reserve(gesture, view->data_len);
+    for (int i = 0; i < view->data_len; i++)
+        gesture_append(gesture, view->x[i], view->y[i], view->z[i]);
+    gesture_minmax(gesture);
+    return gesture;
+}
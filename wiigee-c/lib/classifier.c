@@ -0,0 +1,100 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+
+#include "classifier.h"
+#include "util.h"
+
+struct classifier *classifier_new()
+{
+    struct classifier *this = xalloc(sizeof(struct classifier));
+    this->models = NULL;
+    this->n_models = 0;
+    this->scorer = NULL;
+    return this;
+}
+
+void classifier_free(struct classifier *this)
+{
+    if (this->scorer)
+        scorer_free(this->scorer);
+    free(this->models);
+    free(this);
+}
+
+void classifier_add(struct classifier *this, struct gesturemodel *model)
+{
+    this->n_models++;
+    this->models = xrealloc(this->models, sizeof(struct gesturemodel *) * this->n_models);
+    this->models[this->n_models-1] = model;
+
+    if (this->scorer) {
+        scorer_free(this->scorer);
+        this->scorer = NULL;
+    }
+}
+
+static struct scorer *get_scorer(struct classifier *this)
+{
+    if (!this->scorer)
+        this->scorer = scorer_new(this->models, this->n_models);
+    return this->scorer;
+}
+
+// How many times each sample gets quantized: the number of distinct codebooks
+int classifier_codebooks(struct classifier *this)
+{
+    return this->n_models ? get_scorer(this)->n_codebooks : 0;
+}
+
+/*
+ * The bayes decision over the models' raw matches (overwritten): returns
+ * the index of the most probable model, or -1 if no model gives the
+ * gesture any probability.  Each match is weighted by its model's
+ * defaultprobability and normalized over the vocabulary; if probabilities
+ * is not NULL, those posteriors are written to it (n_models entries).
+ */
+int classifier_decide(struct gesturemodel **models, int n_models, double *matches, double *probabilities)
+{
+    double sum = 0;
+
+    for (int m = 0; m < n_models; m++) {
+        matches[m] *= models[m]->defaultprobability;
+        sum += matches[m];
+    }
+
+    int recognized = -1;
+    double recogprob = 0;
+
+    for (int m = 0; m < n_models; m++) {
+        double modelprob = sum > 0 ? matches[m] / sum : 0;
+
+        if (probabilities)
+            probabilities[m] = modelprob;
+
+        if (modelprob > recogprob) {
+            recogprob = modelprob;
+            recognized = m;
+        }
+    }
+    return recognized;
+}
+
+// classifier_decide() on how well each model matches the gesture
+int classifier_classify(struct classifier *this, struct gesture *gesture, double *probabilities)
+{
+    if (this->n_models == 0 || gesture->data_len == 0)
+        return -1;
+
+    struct scorer *scorer = get_scorer(this);
+    double matches[this->n_models];
+
+    scorer_reset(scorer);
+    scorer_push_gesture(scorer, gesture);
+    scorer_probabilities(scorer, matches);
+
+    int recognized = classifier_decide(this->models, this->n_models, matches, probabilities);
+
+    debug("classify: model %d over %d codebooks\n", recognized, scorer->n_codebooks);
+    return recognized;
+}
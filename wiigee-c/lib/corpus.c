@@ -0,0 +1,310 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // clock_gettime, strdup, sysconf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "corpus.h"
+#include "wmdump.h"
+#include "util.h"
+
+struct corpus_segment {
+    int gesture;
+    long first;
+    int data_len;
+};
+
+// One capture file, filled in by whichever worker picks it up
+struct corpus_file {
+    char *path;
+    char user[64];
+    enum capture_hand hand;
+    uint8_t *x, *y, *z;
+    int64_t *t;
+    long data_len, data_cap;
+    struct corpus_segment *segments;
+    int n_segments, segments_cap;
+    long bytes;
+    int failed;
+};
+
+static int add_segment(void *ctx, const struct wmdump_segment *segment)
+{
+    struct corpus_file *file = ctx;
+    long n = segment->data_len;
+
+    if (file->data_len + n > file->data_cap) {
+        file->data_cap = MAX(2 * file->data_cap, file->data_len + n);
+        file->x = xrealloc(file->x, file->data_cap);
+        file->y = xrealloc(file->y, file->data_cap);
+        file->z = xrealloc(file->z, file->data_cap);
+        file->t = xrealloc(file->t, sizeof(int64_t) * file->data_cap);
+    }
+    if (file->n_segments == file->segments_cap) {
+        file->segments_cap = MAX(2 * file->segments_cap, 32);
+        file->segments = xrealloc(file->segments, sizeof(struct corpus_segment) * file->segments_cap);
+    }
+
+    struct corpus_segment *s = &file->segments[file->n_segments++];
+    s->gesture  = segment->gesture;
+    s->first    = file->data_len;
+    s->data_len = n;
+
+    memcpy(file->x + file->data_len, segment->x, n);
+    memcpy(file->y + file->data_len, segment->y, n);
+    memcpy(file->z + file->data_len, segment->z, n);
+    memcpy(file->t + file->data_len, segment->t, sizeof(int64_t) * n);
+    file->data_len += n;
+    return 0;
+}
+
+static void load_file(struct corpus_file *file)
+{
+    char hand[16];
+
+    if (wmdump_name(file->path, file->user, sizeof(file->user), hand, sizeof(hand))) {
+        file->failed = 1;
+        return;
+    }
+    file->hand = capture_hand_from_name(hand);
+    file->failed = wmdump_parse(file->path, add_segment, file) < 0;
+}
+
+// The work queue: files are handed out biggest first, so no worker is
+// left with a long file at the end
+struct workers {
+    struct corpus_file **queue;
+    int n, next;
+    pthread_mutex_t lock;
+};
+
+static void *worker(void *arg)
+{
+    struct workers *w = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        struct corpus_file *file = w->next < w->n ? w->queue[w->next++] : NULL;
+        pthread_mutex_unlock(&w->lock);
+
+        if (!file)
+            return NULL;
+        load_file(file);
+    }
+}
+
+static int bigger_first(const void *a, const void *b)
+{
+    long x = (*(struct corpus_file *const *)a)->bytes;
+    long y = (*(struct corpus_file *const *)b)->bytes;
+    return (x < y) - (x > y);
+}
+
+static int string_order(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Gesture list, user table and per-user/hand indices, in the files' order
+static void build_indices(struct corpus *this)
+{
+    for (int f = 0; f < this->n_files; f++) {
+        struct corpus_file *file = &this->files[f];
+        char *user = file->user;
+
+        if (file->failed)
+            continue;
+        this->n_gestures += file->n_segments;
+        this->n_samples += file->data_len;
+        this->bytes += file->bytes;
+
+        if (!bsearch(&user, this->users, this->n_users, sizeof(char *), string_order)) {
+            this->users = xrealloc(this->users, sizeof(char *) * (this->n_users + 1));
+            this->users[this->n_users++] = user;
+            qsort(this->users, this->n_users, sizeof(char *), string_order);
+        }
+    }
+
+    this->gestures  = xalloc(sizeof(struct corpus_gesture) * MAX(this->n_gestures, 1));
+    this->index     = xalloc(sizeof(int *) * 3 * MAX(this->n_users, 1));
+    this->index_len = xalloc(sizeof(int) * 3 * MAX(this->n_users, 1));
+
+    int g = 0;
+    for (int f = 0; f < this->n_files; f++) {
+        struct corpus_file *file = &this->files[f];
+
+        if (file->failed)
+            continue;
+
+        int user = corpus_user(this, file->user);
+        int slot = user * 3 + file->hand;
+        this->index[slot] = xrealloc(this->index[slot], sizeof(int) * (this->index_len[slot] + file->n_segments));
+
+        for (int s = 0; s < file->n_segments; s++, g++) {
+            struct corpus_segment *segment = &file->segments[s];
+            struct corpus_gesture *gesture = &this->gestures[g];
+
+            gesture->user     = user;
+            gesture->hand     = file->hand;
+            gesture->gesture  = segment->gesture;
+            gesture->data_len = segment->data_len;
+            gesture->x = file->x + segment->first;
+            gesture->y = file->y + segment->first;
+            gesture->z = file->z + segment->first;
+            gesture->t = file->t + segment->first;
+
+            this->index[slot][this->index_len[slot]++] = g;
+        }
+    }
+}
+
+/*
+ * Reads the n capture files at paths with threads workers (0 for one per
+ * online CPU).  Gestures come out in the order of paths, whatever order
+ * the workers finish in.  Files that can't be read are counted in
+ * n_failed and left out.
+ */
+struct corpus *corpus_load(const char *const *paths, int n, int threads)
+{
+    struct corpus *this = xalloc(sizeof(struct corpus));
+    double start = now();
+
+    if (threads <= 0)
+        threads = MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    threads = MAX(MIN(threads, n), 1);
+
+    this->n_files = n;
+    this->files = xalloc(sizeof(struct corpus_file) * MAX(n, 1));
+    this->threads = threads;
+
+    struct workers w = { xalloc(sizeof(struct corpus_file *) * MAX(n, 1)), n, 0 };
+    pthread_mutex_init(&w.lock, NULL);
+
+    for (int i = 0; i < n; i++) {
+        struct stat st;
+        this->files[i].path = strdup(paths[i]);
+        this->files[i].bytes = stat(paths[i], &st) ? 0 : st.st_size;
+        w.queue[i] = &this->files[i];
+    }
+    qsort(w.queue, n, sizeof(struct corpus_file *), bigger_first);
+
+    pthread_t tids[threads];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[i], NULL, worker, &w))
+            break;
+        started = i;
+    }
+    worker(&w);     // this thread is worker 0
+    for (int i = 1; i <= started; i++)
+        pthread_join(tids[i], NULL);
+
+    pthread_mutex_destroy(&w.lock);
+    free(w.queue);
+
+    for (int i = 0; i < n; i++)
+        this->n_failed += this->files[i].failed;
+
+    build_indices(this);
+    this->seconds = now() - start;
+    return this;
+}
+
+static int has_suffix(const char *s, const char *suffix)
+{
+    size_t a = strlen(s), b = strlen(suffix);
+    return a >= b && !strcmp(s + a - b, suffix);
+}
+
+// Every user.hand.txt file in dir, in name order; NULL if dir can't be read
+struct corpus *corpus_load_dir(const char *dir, int threads)
+{
+    DIR *d = opendir(dir);
+    if (!d)
+        return NULL;
+
+    char **paths = NULL;
+    int n = 0;
+    struct dirent *entry;
+
+    while ((entry = readdir(d))) {
+        if (entry->d_name[0] == '.' || !has_suffix(entry->d_name, ".txt"))
+            continue;
+        paths = xrealloc(paths, sizeof(char *) * (n + 1));
+        paths[n] = xalloc(strlen(dir) + strlen(entry->d_name) + 2);
+        sprintf(paths[n++], "%s/%s", dir, entry->d_name);
+    }
+    closedir(d);
+
+    qsort(paths, n, sizeof(char *), string_order);
+
+    struct corpus *this = corpus_load((const char *const *)paths, n, threads);
+
+    for (int i = 0; i < n; i++)
+        free(paths[i]);
+    free(paths);
+    return this;
+}
+
+void corpus_free(struct corpus *this)
+{
+    for (int f = 0; f < this->n_files; f++) {
+        struct corpus_file *file = &this->files[f];
+        free(file->path);
+        free(file->x);
+        free(file->y);
+        free(file->z);
+        free(file->t);
+        free(file->segments);
+    }
+    for (int i = 0; i < 3 * this->n_users; i++)
+        free(this->index[i]);
+    free(this->index);
+    free(this->index_len);
+    free(this->users);      // the names live in files
+    free(this->files);
+    free(this->gestures);
+    free(this);
+}
+
+// Index of the named user, or -1
+int corpus_user(struct corpus *this, const char *name)
+{
+    char *const *found = bsearch(&name, this->users, this->n_users, sizeof(char *), string_order);
+    return found ? found - this->users : -1;
+}
+
+// The numbers of the user's gestures made with hand, n of them
+const int *corpus_select(struct corpus *this, int user, enum capture_hand hand, int *n)
+{
+    if (user < 0 || user >= this->n_users || (unsigned)hand > HAND_RIGHT) {
+        *n = 0;
+        return NULL;
+    }
+    *n = this->index_len[user * 3 + hand];
+    return this->index[user * 3 + hand];
+}
+
+void corpus_report(struct corpus *this, FILE *out)
+{
+    double mb = this->bytes / 1e6;
+
+    fprintf(out, "%d files (%d failed), %d users, %d gestures, %ld samples: "
+                 "%.1f MB in %.3f s on %d threads, %.0f MB/s\n",
+            this->n_files, this->n_failed, this->n_users, this->n_gestures, this->n_samples,
+            mb, this->seconds, this->threads, this->seconds > 0 ? mb / this->seconds : 0);
+}
@@ -0,0 +1,192 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <assert.h>
+#include <string.h>
+
+#include "endpoint.h"
+#include "util.h"
+
+/*
+ * Defaults for raw reports at wmdump's 100Hz, where 1g is about 25 units:
+ * motion of a few units rms starts a segment, 150ms of stillness ends it,
+ * and gestures run from 300ms to 3s (the energy lags the motion by about
+ * a tenth of a second at either end).
+ */
+void endpoint_init(struct endpoint *this)
+{
+    memset(this, 0, sizeof(*this));
+    this->on       = 40;
+    this->off      = 15;
+    this->hangover = 15;
+    this->min_len  = 30;
+    this->max_len  = 300;
+    this->preroll  = 5;
+    this->fast     = 0.3;
+    this->slow     = 0.02;
+}
+
+// Forget the stream so far (but not the counts)
+void endpoint_reset(struct endpoint *this)
+{
+    this->started = 0;
+    this->state   = ENDPOINT_REST;
+    this->n_held  = 0;
+}
+
+static void emit(struct endpoint *this, struct ring_event *out, int *n,
+                 const struct ring_event *report, int type, int buttons, int64_t t)
+{
+    struct ring_event e = { t, type, buttons, 0, 0, 0, 0 };
+
+    if (report) {
+        e.x = report->x;
+        e.y = report->y;
+        e.z = report->z;
+        this->last_t = t;
+    }
+    out[(*n)++] = e;
+}
+
+static void drop_held(struct endpoint *this)
+{
+    this->at_rest += this->n_held;
+    this->n_held = 0;
+}
+
+// Release the segment in progress; if it was cut short, wait for stillness
+static void finish(struct endpoint *this, struct ring_event *out, int *n, int cut)
+{
+    drop_held(this);
+    emit(this, out, n, NULL, RING_BUTTON, 0, this->last_t);
+    this->segments++;
+    this->cut += cut;
+    this->state = cut ? ENDPOINT_COOLDOWN : ENDPOINT_REST;
+}
+
+// Once there has been min_len of motion, press and let the held reports through
+static void begin(struct endpoint *this, struct ring_event *out, int *n)
+{
+    if (this->len - this->quiet < this->min_len)
+        return;
+
+    // Any quiet reports at the end stay held, as in ENDPOINT_ACTIVE
+    int moving = this->n_held - this->quiet;
+
+    emit(this, out, n, NULL, RING_BUTTON, ENDPOINT_BUTTONS, this->held[0].t);
+    for (int i = 0; i < moving; i++)
+        emit(this, out, n, &this->held[i], RING_ACC, ENDPOINT_BUTTONS, this->held[i].t);
+    memmove(this->held, this->held + moving, sizeof(struct ring_event) * this->quiet);
+    this->n_held = this->quiet;
+    this->state = ENDPOINT_ACTIVE;
+
+    if (this->len >= this->max_len)
+        finish(this, out, n, 1);
+}
+
+/*
+ * Takes one report and writes whatever it lets through to out (room for
+ * ENDPOINT_MAX_OUT events), returning how many.  Anything but
+ * accelerometer reports is ignored.
+ */
+int endpoint_push(struct endpoint *this, const struct ring_event *report, struct ring_event *out)
+{
+    double a[3] = { report->x, report->y, report->z };
+    double d2 = 0;
+    int n = 0;
+
+    if (report->type != RING_ACC)
+        return 0;
+
+    assert(this->preroll + this->min_len + this->hangover <= ENDPOINT_HOLD && this->min_len > 0);
+
+    if (!this->started) {
+        for (int i = 0; i < 3; i++)
+            this->mean[i] = a[i];
+        this->energy = 0;
+        this->started = 1;
+    }
+
+    for (int i = 0; i < 3; i++)
+        d2 += (a[i] - this->mean[i]) * (a[i] - this->mean[i]);
+    this->energy += this->fast * (d2 - this->energy);
+
+    // Gravity is whatever the controller reads while it isn't moving
+    if (this->state == ENDPOINT_REST || this->state == ENDPOINT_COOLDOWN)
+        for (int i = 0; i < 3; i++)
+            this->mean[i] += this->slow * (a[i] - this->mean[i]);
+
+    this->quiet = this->energy < this->off ? this->quiet + 1 : 0;
+
+    switch (this->state) {
+    case ENDPOINT_REST:
+        // Keep the last preroll reports, plus this one
+        if (this->n_held > this->preroll) {
+            memmove(this->held, this->held + 1, sizeof(struct ring_event) * --this->n_held);
+            this->at_rest++;
+        }
+        this->held[this->n_held++] = *report;
+
+        if (this->energy > this->on) {
+            this->state = ENDPOINT_ONSET;
+            this->len = 1;
+            this->quiet = 0;
+            begin(this, out, &n);
+        }
+        break;
+
+    case ENDPOINT_ONSET:
+        this->held[this->n_held++] = *report;
+        this->len++;
+
+        if (this->quiet >= this->hangover) {
+            this->too_short++;
+            drop_held(this);
+            this->state = ENDPOINT_REST;
+        } else {
+            begin(this, out, &n);
+        }
+        break;
+
+    case ENDPOINT_ACTIVE:
+        // Quiet reports wait to see whether the motion goes on
+        this->held[this->n_held++] = *report;
+        this->len++;
+        if (this->quiet == 0) {
+            for (int i = 0; i < this->n_held; i++)
+                emit(this, out, &n, &this->held[i], RING_ACC, ENDPOINT_BUTTONS, this->held[i].t);
+            this->n_held = 0;
+        }
+
+        if (this->quiet >= this->hangover)
+            finish(this, out, &n, 0);
+        else if (this->len >= this->max_len)
+            finish(this, out, &n, 1);
+        break;
+
+    case ENDPOINT_COOLDOWN:
+        this->at_rest++;
+        if (this->energy < this->off)
+            this->state = ENDPOINT_REST;
+        break;
+    }
+    return n;
+}
+
+/*
+ * The stream is over: releases the segment in progress, if there is one
+ * long enough, into out (room for ENDPOINT_MAX_OUT).  Returns how many
+ * events that took.
+ */
+int endpoint_flush(struct endpoint *this, struct ring_event *out)
+{
+    int n = 0;
+
+    if (this->state == ENDPOINT_ACTIVE)
+        finish(this, out, &n, 0);
+    else if (this->state == ENDPOINT_ONSET)
+        this->too_short++;
+
+    drop_held(this);
+    endpoint_reset(this);
+    return n;
+}
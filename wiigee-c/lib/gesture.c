@@ -3,31 +3,101 @@
 #include <stdio.h>
 #include <float.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include "gesture.h"
+#include "arena.h"
 #include "util.h"
 
 struct gesture *gesture_new()
 {
-    struct gesture *gesture = xalloc(sizeof(struct gesture));
+    return gesture_new_in(NULL);
+}
+
+// A gesture living in the arena, or on the heap if arena is NULL
+struct gesture *gesture_new_in(struct arena *arena)
+{
+    struct gesture *gesture = arena ? arena_alloc(arena, sizeof(struct gesture))
+                                    : xalloc(sizeof(struct gesture));
+    gesture->arena = arena;
     gesture->data_len = 0;
+    gesture->data_cap = 0;
     gesture->data = NULL;
     gesture->minacc = DBL_MAX;
     gesture->maxacc = DBL_MIN;
     return gesture;
 }
 
+// Make room for at least n samples without further reallocation
+void gesture_reserve(struct gesture *gesture, int n)
+{
+    if (n <= gesture->data_cap)
+        return;
+
+    if (gesture->arena)
+        gesture->data = arena_grow(gesture->arena, gesture->data,
+                                   sizeof(struct coordinate) * gesture->data_cap,
+                                   sizeof(struct coordinate) * n);
+    else
+        gesture->data = xrealloc(gesture->data, sizeof(struct coordinate) * n);
+    gesture->data_cap = n;
+}
+
+// Grow geometrically, so appending T samples one by one costs O(T) copying
+static void gesture_grow(struct gesture *gesture, int n)
+{
+    if (n > gesture->data_cap)
+        gesture_reserve(gesture, MAX(n, MAX(16, gesture->data_cap * 2)));
+}
+
 void gesture_append(struct gesture *gesture, double x, double y, double z)
 {
+    gesture_grow(gesture, gesture->data_len + 1);
     gesture->data_len++;
-    gesture->data = xrealloc(gesture->data, sizeof(struct coordinate) * gesture->data_len);
     gesture->data[gesture->data_len-1].x = x;
     gesture->data[gesture->data_len-1].y = y;
     gesture->data[gesture->data_len-1].z = z;
 }
 
+void gesture_append_many(struct gesture *gesture, const struct coordinate *data, int n)
+{
+    if (n == 0)
+        return;     // data may be NULL, and memcpy() mustn't see that
+    gesture_grow(gesture, gesture->data_len + n);
+    memcpy(&gesture->data[gesture->data_len], data, sizeof(struct coordinate) * n);
+    gesture->data_len += n;
+}
+
+/*
+ * Set minacc/maxacc to the smallest and largest absolute acceleration on
+ * any axis, which is what the quantizer derives its radius from.
+ */
+void gesture_minmax(struct gesture *gesture)
+{
+    double minacc = DBL_MAX;
+    double maxacc = DBL_MIN;
+
+    for (int i = 0; i < gesture->data_len; i++) {
+        maxacc = MAX(maxacc, fabs(gesture->data[i].x));
+        maxacc = MAX(maxacc, fabs(gesture->data[i].y));
+        maxacc = MAX(maxacc, fabs(gesture->data[i].z));
+
+        minacc = MIN(minacc, fabs(gesture->data[i].x));
+        minacc = MIN(minacc, fabs(gesture->data[i].y));
+        minacc = MIN(minacc, fabs(gesture->data[i].z));
+    }
+
+    gesture->maxacc = maxacc;
+    gesture->minacc = minacc;
+}
+
+// Arena gestures are reclaimed by arena_reset() instead
 void gesture_free(struct gesture *gesture)
 {
+    if (gesture->arena)
+        return;
+
     free(gesture->data);
     free(gesture);
 }
@@ -0,0 +1,103 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // posix_memalign
+
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "gesture_soa.h"
+#include "util.h"
+
+struct gesture_soa *gesture_soa_new()
+{
+    struct gesture_soa *this = xalloc(sizeof(struct gesture_soa));
+    this->minacc = FLT_MAX;
+    this->maxacc = FLT_MIN;
+    return this;
+}
+
+// Convert an array-of-structs gesture, keeping its min/max acceleration
+struct gesture_soa *gesture_soa_from(struct gesture *gesture)
+{
+    struct gesture_soa *this = gesture_soa_new();
+
+    gesture_soa_reserve(this, gesture->data_len);
+    for (int i = 0; i < gesture->data_len; i++) {
+        this->x[i] = gesture->data[i].x;
+        this->y[i] = gesture->data[i].y;
+        this->z[i] = gesture->data[i].z;
+    }
+    this->data_len = gesture->data_len;
+    this->minacc = gesture->minacc;
+    this->maxacc = gesture->maxacc;
+    return this;
+}
+
+static float *column_realloc(float *old, int len, int cap)
+{
+    void *p;
+
+    if (posix_memalign(&p, GESTURE_SOA_ALIGN, sizeof(float) * cap))
+        die("posix_memalign() of %d floats failed\n", cap);
+    if (old)
+        memcpy(p, old, sizeof(float) * len);
+    free(old);
+    return p;
+}
+
+// Make room for at least n samples without further reallocation
+void gesture_soa_reserve(struct gesture_soa *this, int n)
+{
+    if (n <= this->data_cap)
+        return;
+
+    this->x = column_realloc(this->x, this->data_len, n);
+    this->y = column_realloc(this->y, this->data_len, n);
+    this->z = column_realloc(this->z, this->data_len, n);
+    this->data_cap = n;
+}
+
+void gesture_soa_append(struct gesture_soa *this, float x, float y, float z)
+{
+    if (this->data_len == this->data_cap)
+        gesture_soa_reserve(this, MAX(16, this->data_cap * 2));
+
+    this->x[this->data_len] = x;
+    this->y[this->data_len] = y;
+    this->z[this->data_len] = z;
+    this->data_len++;
+}
+
+/*
+ * Set minacc/maxacc to the smallest and largest absolute acceleration on
+ * any axis, which is what the quantizer derives its radius from.
+ */
+void gesture_soa_minmax(struct gesture_soa *this)
+{
+    float minacc = FLT_MAX;
+    float maxacc = FLT_MIN;
+
+    // one column at a time, so each loop is a plain vectorizable reduction
+    const float *columns[3] = { this->x, this->y, this->z };
+    for (int c = 0; c < 3; c++) {
+        const float *v = columns[c];
+        for (int i = 0; i < this->data_len; i++) {
+            float a = fabsf(v[i]);
+            minacc = a < minacc ? a : minacc;
+            maxacc = a > maxacc ? a : maxacc;
+        }
+    }
+
+    this->minacc = minacc;
+    this->maxacc = maxacc;
+}
+
+void gesture_soa_free(struct gesture_soa *this)
+{
+    free(this->x);
+    free(this->y);
+    free(this->z);
+    free(this);
+}
@@ -1,5 +1,7 @@
 // vim:set ts=4 sw=4 ai et:
 
+#include <assert.h>
+
 #include "gesturemodel.h"
 #include "observation.h"
 #include "quantizer.h"
@@ -7,13 +9,20 @@
 #include "util.h"
 
 struct gesturemodel *gesturemodel_new(int id)
+{
+    // n=8 states, k=14 observations: empirical values
+    return gesturemodel_new_sized(id, 8, MAP_SIZE, SEED_CIRCLE);
+}
+
+// A model whose codebook (and so HMM alphabet) has `observations` entries
+struct gesturemodel *gesturemodel_new_sized(int id, int states, int observations, enum quantizer_seeding seeding)
 {
     struct gesturemodel *this = xalloc(sizeof(struct gesturemodel));
 
     this->id           = id;
-    this->states       = 8;     // n=8 states empirical value
-    this->observations = 14;    // k=14 observations empirical value
-    this->quantizer    = quantizer_new(this->states);
+    this->states       = states;
+    this->observations = observations;
+    this->quantizer    = quantizer_new_sized(this->states, this->observations, seeding);
     this->hmm          = hmm_new(this->states, this->observations);
 
     return this;
@@ -26,41 +35,57 @@ void gesturemodel_free(struct gesturemodel *this)
     free(this);
 }
 
-// void train(Vector<Gesture> trainsequence)
-void gesturemodel_train(struct gesturemodel *this, struct gesture *trainsequence, int trainsequence_len)
+/*
+ * Summarize all vectors from the gestures of n_sets training sets into a
+ * single gesture, and train the codebook on that.
+ */
+static void train_codebook(struct quantizer *quantizer, struct gesture **trainsequences, int *trainsequence_lens, int n_sets)
 {
     struct gesture *sum = gesture_new();
     double minacc = 0;
     double maxacc = 0;
+    int n_gestures = 0;
 
-    // summarize all vectors from the different gestures in the trainsequence into a single gesture
+    int total = 0;
+    for (int s = 0; s < n_sets; s++)
+        for (int i = 0; i < trainsequence_lens[s]; i++)
+            total += trainsequences[s][i].data_len;
+    gesture_reserve(sum, total);
 
-    for (int i = 0; i < trainsequence_len; i++) {
-        minacc += trainsequence[i].minacc;
-        maxacc += trainsequence[i].maxacc;
-
-        for (int j = 0; j < trainsequence[i].data_len; j++) {
-            // transfer every single accelerationevent of each gesture to the new gesture sum
-            gesture_append(sum,
-                           trainsequence[i].data[j].x,
-                           trainsequence[i].data[j].y,
-                           trainsequence[i].data[j].z);
+    for (int s = 0; s < n_sets; s++) {
+        struct gesture *trainsequence = trainsequences[s];
+
+        for (int i = 0; i < trainsequence_lens[s]; i++) {
+            minacc += trainsequence[i].minacc;
+            maxacc += trainsequence[i].maxacc;
+            n_gestures++;
+
+            // transfer every accelerationevent of each gesture to the new gesture sum
+            gesture_append_many(sum, trainsequence[i].data, trainsequence[i].data_len);
         }
     }
 
     // average the max and min accelerations
-    sum->minacc = minacc / trainsequence_len;
-    sum->maxacc = maxacc / trainsequence_len;
+    sum->minacc = minacc / n_gestures;
+    sum->maxacc = maxacc / n_gestures;
 
     // train the centeroids of the quantizer with this master gesture sum
-    quantizer_trainCenteroids(this->quantizer, sum);
+    quantizer_trainCenteroids(quantizer, sum);
+
+    gesture_free(sum);
+}
 
+// Train the markov model on the training set, quantized by this model's codebook
+static void train_markov(struct gesturemodel *this, struct gesture *trainsequence, int trainsequence_len)
+{
     // convert gesture vector to a sequence of discrete values
+    struct observation *observations[trainsequence_len];
+    StateSequence views[trainsequence_len];
     StateSequence *seqs[trainsequence_len];
     for (int i = 0; i < trainsequence_len; i++) {
-        struct observation *observation = quantizer_getObservationSequence(this->quantizer, &trainsequence[i]);
-        seqs[i] = observation_to_StateSequence(observation);
-        observation_free(observation);
+        observations[i] = quantizer_getObservationSequence(this->quantizer, &trainsequence[i]);
+        views[i] = observation_view(observations[i]);
+        seqs[i] = &views[i];
     }
 
     // train the markov model with this derived discrete sequences
@@ -69,20 +94,57 @@ void gesturemodel_train(struct gesturemodel *this, struct gesture *trainsequence
     // set the default probability
     setDefaultProbability(this, trainsequence, trainsequence_len);
 
-    gesture_free(sum);
     for (int i = 0; i < trainsequence_len; i++)
-        releaseStateSequence(seqs[i]);
+        observation_free(observations[i]);
+}
+
+// void train(Vector<Gesture> trainsequence)
+void gesturemodel_train(struct gesturemodel *this, struct gesture *trainsequence, int trainsequence_len)
+{
+    train_codebook(this->quantizer, &trainsequence, &trainsequence_len, 1);
+    train_markov(this, trainsequence, trainsequence_len);
+}
+
+/*
+ * Train a whole vocabulary on one shared codebook: model m is trained on the
+ * trainsequence_lens[m] gestures of trainsequences[m], and the codebook on
+ * all of them together.  Afterwards every model holds a reference to the
+ * same quantizer, so an incoming gesture only has to be quantized once to be
+ * scored against all of them (see struct classifier).
+ */
+void gesturemodel_trainShared(struct gesturemodel **models, int n_models, struct gesture **trainsequences, int *trainsequence_lens)
+{
+    assert(n_models > 0);
+
+    struct quantizer *shared = models[0]->quantizer;
+
+    for (int m = 1; m < n_models; m++) {
+        if (models[m]->states != models[0]->states || models[m]->observations != models[0]->observations)
+            die("gesturemodel_trainShared: model %d is %dx%d, model 0 is %dx%d\n",
+                m, models[m]->states, models[m]->observations, models[0]->states, models[0]->observations);
+    }
+
+    train_codebook(shared, trainsequences, trainsequence_lens, n_models);
+
+    for (int m = 1; m < n_models; m++) {
+        if (models[m]->quantizer != shared) {
+            quantizer_free(models[m]->quantizer);
+            models[m]->quantizer = quantizer_retain(shared);
+        }
+    }
+
+    for (int m = 0; m < n_models; m++)
+        train_markov(models[m], trainsequences[m], trainsequence_lens[m]);
 }
 
 double matches(struct gesturemodel *this, struct gesture *gesture)
 {
     struct observation *observation = quantizer_getObservationSequence(this->quantizer, gesture);
-    StateSequenceRef sequence = observation_to_StateSequence(observation);
+    StateSequence sequence = observation_view(observation);
 
-    double out = getProbability(this->hmm, sequence);
+    double out = getProbability(this->hmm, &sequence);
 
     observation_free(observation);
-    releaseStateSequence(sequence);
     return out;
 }
 
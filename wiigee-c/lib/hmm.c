@@ -1,4 +1,7 @@
+#include <string.h>
+
 #include "hmm.h"
+#include "arena.h"
 
 /* The dynamic arrays are row major format, so here are some convenience -------
  * wrappers for accessing the tables... ----------------------------------------
@@ -108,24 +111,49 @@ void hmm_free(HmmStateRef hmm) {
 }
 
 StateSequenceRef createStateSequence(uint* states, uint length) {
+	return createStateSequence_in(NULL, states, length);
+}
+
+StateSequenceRef createStateSequence_in(struct arena *arena, uint* states, uint length) {
 	assert(length > 0);
 	
 	uint i;
+	StateSequenceRef sequence;
 	
-	StateSequenceRef sequence = (StateSequenceRef)malloc(sizeof(StateSequenceRef));
+	if (arena) {
+		sequence = (StateSequenceRef)arena_alloc(arena, sizeof(StateSequence));
+		sequence->states = arena_alloc(arena, length);
+	} else {
+		sequence = (StateSequenceRef)malloc(sizeof(StateSequence));
+		sequence->states = malloc(length);
+	}
 	
+	sequence->arena  = arena;
 	sequence->length = length;
-	sequence->states = malloc(sizeof(uint) * length);
 	
-	// XXX: could memcpy if we care about speed, which we don't.
+	// narrowing copy, so no memcpy
 	for (i = 0; i < length; i++) {
+		assert(states[i] < MAX_SYMBOLS);
 		sequence->states[i] = states[i];
 	}
 	
 	return sequence;
 }
 
+StateSequence stateSequenceView(const uint8_t* states, uint length) {
+	StateSequence view;
+	
+	view.length = length;
+	view.states = (uint8_t*)states; // never written through
+	view.arena  = NULL;
+	
+	return view;
+}
+
 void releaseStateSequence(StateSequenceRef sequence) {
+	if (sequence->arena)
+		return; // reclaimed by arena_reset()
+	
 	free(sequence->states);
 	free(sequence);
 }
@@ -300,13 +328,12 @@ void hmm_train(HmmStateRef hmm, StateSequenceRef* sequences, uint num) {
   printf("\nBEFORE TRAIN\n");
   dumpModel(hmm);
 
-	/* dump the old */
-	free(hmm->p_change);
-	free(hmm->p_emit);
-	
-	/* lovingly embrace the new */
-	hmm->p_change = change_new;
-	hmm->p_emit   = emit_new;
+	/* lovingly embrace the new, in place: the tables may not be ours to
+	 * free (see modelbank_open()) */
+	memcpy(hmm->p_change, change_new, sizeof(double) * hmm->numStates * hmm->numStates);
+	memcpy(hmm->p_emit, emit_new, sizeof(double) * hmm->numStates * hmm->numObservations);
+	free(change_new);
+	free(emit_new);
 
   printf("\nAFTER TRAIN\n");
   dumpModel(hmm);
@@ -404,25 +431,59 @@ double* forwardAlgorithm(HmmStateRef hmm, StateSequenceRef sequence) {
  */
 double getProbability(HmmStateRef hmm, StateSequenceRef sequence) {
 	uint i;
-	double prob = 0.0;
-	uint length = sequence->length;
 	
-	// call the forward algorithm, which returns a list of probs
-	double *results = forwardAlgorithm(hmm, sequence);
+	// only the last column of the forward table matters, so run the
+	// recursion over two columns on the stack instead of allocating the
+	// whole numStates * length table
+	double columns[2][hmm->numStates];
+	double *alpha = columns[0], *next = columns[1], *tmp;
 	
-	// NOTE: ^^ this here array is of length hmm->numStates * sequence length
+	forwardInit(hmm, alpha, sequence->states[0]);
+	for (i = 1; i < sequence->length; i++) {
+		forwardStep(hmm, alpha, next, sequence->states[i]);
+		tmp = alpha; alpha = next; next = tmp;
+	}
 	
-	// add up the returned probabilities:
+	// add up the last entry for each state:
+	return forwardSum(hmm, alpha);
+}
+
+/*
+ * Incremental forward algorithm: the same recursion as forwardAlgorithm(),
+ * with the same order of operations, but keeping only the current column.
+ * forwardSum() of the final alpha equals getProbability() on the whole
+ * sequence.
+ */
+void forwardInit(HmmStateRef hmm, double *alpha, uint symbol) {
+	uint i;
+
 	for (i = 0; i < hmm->numStates; i++) {
-		
-		// we care about what's in the last entry of the table for each
-		// state:
-		prob += results[i*sequence->length + (length-1)];
+		alpha[i] = getInitP(hmm, i) * getEmitP(hmm, i, symbol);
 	}
-	
-	/* clean up after "forward" */
-	free(results);
-	
+}
+
+void forwardStep(HmmStateRef hmm, const double *alpha, double *next, uint symbol) {
+	uint j, k;
+
+	for (j = 0; j < hmm->numStates; j++) {
+		double sum = 0.0;
+
+		for (k = 0; k < hmm->numStates; k++) {
+			sum += alpha[k] * getChangeP(hmm, k, j);
+		}
+
+		next[j] = sum * getEmitP(hmm, j, symbol);
+	}
+}
+
+double forwardSum(HmmStateRef hmm, const double *alpha) {
+	uint i;
+	double prob = 0.0;
+
+	for (i = 0; i < hmm->numStates; i++) {
+		prob += alpha[i];
+	}
+
 	return prob;
 }
 
@@ -0,0 +1,207 @@
+#include <string.h>
+#include <math.h>
+
+#include "hmm_runs.h"
+
+//#pragma mark -
+//#pragma mark run-length encoding
+
+SymbolRunsRef createSymbolRuns(StateSequenceRef sequence) {
+	assert(sequence && sequence->length > 0);
+	
+	uint i;
+	SymbolRunsRef runs = (SymbolRunsRef)malloc(sizeof(SymbolRuns));
+	
+	// count first, so the arrays are allocated once at their final size
+	runs->numRuns = 1;
+	for (i = 1; i < sequence->length; i++) {
+		if (sequence->states[i] != sequence->states[i-1])
+			runs->numRuns++;
+	}
+	
+	runs->length  = sequence->length;
+	runs->symbols = (uint8_t*)malloc(runs->numRuns);
+	runs->counts  = (uint*)malloc(sizeof(uint) * runs->numRuns);
+	
+	uint r = 0;
+	runs->symbols[0] = sequence->states[0];
+	runs->counts[0]  = 1;
+	for (i = 1; i < sequence->length; i++) {
+		if (sequence->states[i] == runs->symbols[r]) {
+			runs->counts[r]++;
+		} else {
+			r++;
+			runs->symbols[r] = sequence->states[i];
+			runs->counts[r]  = 1;
+		}
+	}
+	
+	return runs;
+}
+
+void releaseSymbolRuns(SymbolRunsRef runs) {
+	free(runs->symbols);
+	free(runs->counts);
+	free(runs);
+}
+
+//#pragma mark -
+//#pragma mark matrix powers
+
+HmmPowersRef createHmmPowers(HmmStateRef hmm) {
+	HmmPowersRef powers = (HmmPowersRef)malloc(sizeof(HmmPowers));
+	
+	powers->hmm    = hmm;
+	powers->powers = (double**)calloc(sizeof(double*), hmm->numObservations * HMM_POWER_LEVELS);
+	powers->scales = (double*)calloc(sizeof(double), hmm->numObservations * HMM_POWER_LEVELS);
+	
+	return powers;
+}
+
+void releaseHmmPowers(HmmPowersRef powers) {
+	uint i;
+	
+	for (i = 0; i < powers->hmm->numObservations * HMM_POWER_LEVELS; i++) {
+		free(powers->powers[i]);
+	}
+	free(powers->powers);
+	free(powers->scales);
+	free(powers);
+}
+
+/* Divide m by its largest entry, returning the log of that */
+static double normalize(double *m, uint n) {
+	double largest = 0.0;
+	uint i;
+	
+	for (i = 0; i < n; i++) {
+		if (m[i] > largest)
+			largest = m[i];
+	}
+	if (largest == 0.0)
+		return 0.0;
+	
+	for (i = 0; i < n; i++) {
+		m[i] /= largest;
+	}
+	return log(largest);
+}
+
+/* M_s^(2^level) / exp(*scale), computing (and caching) the squarings below
+ * it as needed */
+static const double* getPower(HmmPowersRef powers, uint symbol, uint level, double *scale) {
+	HmmStateRef hmm = powers->hmm;
+	uint N = hmm->numStates;
+	uint slot = symbol * HMM_POWER_LEVELS + level;
+	uint i, j, k;
+	
+	if (powers->powers[slot]) {
+		*scale = powers->scales[slot];
+		return powers->powers[slot];
+	}
+	
+	double *m = (double*)malloc(sizeof(double) * N * N);
+	
+	if (level == 0) {
+		for (i = 0; i < N; i++) {
+			for (j = 0; j < N; j++) {
+				m[i*N + j] = getChangeP(hmm, i, j) * getEmitP(hmm, j, symbol);
+			}
+		}
+		*scale = 0.0;
+	} else {
+		double halfScale;
+		const double *half = getPower(powers, symbol, level - 1, &halfScale);
+		
+		for (i = 0; i < N; i++) {
+			for (j = 0; j < N; j++) {
+				double sum = 0.0;
+				for (k = 0; k < N; k++) {
+					sum += half[i*N + k] * half[k*N + j];
+				}
+				m[i*N + j] = sum;
+			}
+		}
+		*scale = 2 * halfScale;
+	}
+	*scale += normalize(m, N * N);
+	
+	powers->powers[slot] = m;
+	powers->scales[slot] = *scale;
+	return m;
+}
+
+/* Rescale alpha to sum to one, adding the log of what it summed to to
+ * *logP */
+static void rescale(uint N, double *alpha, double *logP) {
+	double sum = 0.0;
+	uint i;
+	
+	for (i = 0; i < N; i++) {
+		sum += alpha[i];
+	}
+	if (sum == 0.0) {
+		*logP = -INFINITY;
+		return;
+	}
+	
+	for (i = 0; i < N; i++) {
+		alpha[i] /= sum;
+	}
+	*logP += log(sum);
+}
+
+/* alpha = alpha * M_s^count, one cached power per set bit of count, with
+ * alpha rescaled after every product and the scale kept in *logP */
+static void applyRun(HmmPowersRef powers, double *alpha, double *scratch, uint symbol, uint count, double *logP) {
+	uint N = powers->hmm->numStates;
+	uint level, i, k;
+	
+	for (level = 0; count; level++, count >>= 1) {
+		if (!(count & 1))
+			continue;
+		
+		double scale;
+		const double *m = getPower(powers, symbol, level, &scale);
+		
+		for (i = 0; i < N; i++) {
+			double sum = 0.0;
+			for (k = 0; k < N; k++) {
+				sum += alpha[k] * m[k*N + i];
+			}
+			scratch[i] = sum;
+		}
+		memcpy(alpha, scratch, sizeof(double) * N);
+		*logP += scale;
+		rescale(N, alpha, logP);
+	}
+}
+
+//#pragma mark -
+//#pragma mark "logic"
+
+double getLogProbabilityRuns(HmmPowersRef powers, SymbolRunsRef runs) {
+	assert(powers && runs && runs->numRuns > 0);
+	
+	HmmStateRef hmm = powers->hmm;
+	double alpha[hmm->numStates];
+	double scratch[hmm->numStates];
+	double logP = 0.0;
+	uint r;
+	
+	// the first symbol of the first run starts the recursion, as in
+	// forwardAlgorithm(); the rest of that run is one power
+	forwardInit(hmm, alpha, runs->symbols[0]);
+	rescale(hmm->numStates, alpha, &logP);
+	applyRun(powers, alpha, scratch, runs->symbols[0], runs->counts[0] - 1, &logP);
+	
+	for (r = 1; r < runs->numRuns; r++) {
+		applyRun(powers, alpha, scratch, runs->symbols[r], runs->counts[r], &logP);
+	}
+	
+	return logP;
+}
+
+double getProbabilityRuns(HmmPowersRef powers, SymbolRunsRef runs) {
+	return exp(getLogProbabilityRuns(powers, runs));
+}
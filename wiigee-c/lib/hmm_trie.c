@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "hmm_trie.h"
+
+//#pragma mark -
+//#pragma mark construction
+
+SequenceTrieRef createSequenceTrie() {
+	SequenceTrieRef trie = (SequenceTrieRef)malloc(sizeof(SequenceTrie));
+	
+	trie->capNodes     = 64;
+	trie->numNodes     = 1;
+	trie->nodes        = (TrieNode*)calloc(sizeof(TrieNode), trie->capNodes);
+	
+	trie->capSequences = 16;
+	trie->numSequences = 0;
+	trie->ends         = (uint*)malloc(sizeof(uint) * trie->capSequences);
+	
+	trie->maxDepth     = 0;
+	
+	return trie;
+}
+
+void releaseSequenceTrie(SequenceTrieRef trie) {
+	free(trie->nodes);
+	free(trie->ends);
+	free(trie);
+}
+
+static uint childFor(SequenceTrieRef trie, uint parent, uint8_t symbol) {
+	uint c;
+	
+	for (c = trie->nodes[parent].firstChild; c; c = trie->nodes[c].nextSibling) {
+		if (trie->nodes[c].symbol == symbol)
+			return c;
+	}
+	
+	if (trie->numNodes == trie->capNodes) {
+		trie->capNodes *= 2;
+		trie->nodes = (TrieNode*)realloc(trie->nodes, sizeof(TrieNode) * trie->capNodes);
+	}
+	
+	c = trie->numNodes++;
+	memset(&trie->nodes[c], 0, sizeof(TrieNode));
+	trie->nodes[c].symbol      = symbol;
+	trie->nodes[c].depth       = trie->nodes[parent].depth + 1;
+	trie->nodes[c].nextSibling = trie->nodes[parent].firstChild;
+	trie->nodes[parent].firstChild = c;
+	
+	return c;
+}
+
+uint trieInsert(SequenceTrieRef trie, StateSequenceRef sequence) {
+	assert(sequence && sequence->length > 0);
+	
+	uint node = 0;
+	uint i;
+	
+	for (i = 0; i < sequence->length; i++) {
+		node = childFor(trie, node, sequence->states[i]);
+	}
+	trie->nodes[node].terminal = 1;
+	if (sequence->length > trie->maxDepth)
+		trie->maxDepth = sequence->length;
+	
+	if (trie->numSequences == trie->capSequences) {
+		trie->capSequences *= 2;
+		trie->ends = (uint*)realloc(trie->ends, sizeof(uint) * trie->capSequences);
+	}
+	trie->ends[trie->numSequences] = node;
+	
+	return trie->numSequences++;
+}
+
+//#pragma mark -
+//#pragma mark "logic"
+
+/* A node still to be scored, and the column of alphas its vector goes in */
+typedef struct _trieFrame {
+	uint node;
+	uint column;
+} TrieFrame;
+
+/* Depth first, off an explicit stack rather than by recursion, so long
+ * sequences can't overflow the C stack.  alphas holds one column per
+ * depth; a node's parent's is the column before its own, and is left
+ * untouched until all of the parent's descendants are scored. */
+void trieScore(HmmStateRef hmm, SequenceTrieRef trie, double *out) {
+	uint N = hmm->numStates;
+	double *alphas = (double*)malloc(sizeof(double) * N * (trie->maxDepth + 1));
+	TrieFrame *stack = (TrieFrame*)malloc(sizeof(TrieFrame) * trie->numNodes);
+	uint top = 0;
+	uint c, i;
+	
+	for (c = trie->nodes[0].firstChild; c; c = trie->nodes[c].nextSibling) {
+		stack[top].node   = c;
+		stack[top].column = 1;
+		top++;
+	}
+	
+	while (top) {
+		TrieFrame frame = stack[--top];
+		TrieNode *n = &trie->nodes[frame.node];
+		double *alpha = alphas + frame.column * N;
+		
+		if (frame.column == 1)
+			forwardInit(hmm, alpha, n->symbol);
+		else
+			forwardStep(hmm, alpha - N, alpha, n->symbol);
+		
+		if (n->terminal)
+			n->probability = forwardSum(hmm, alpha);
+		
+		for (c = n->firstChild; c; c = trie->nodes[c].nextSibling) {
+			stack[top].node   = c;
+			stack[top].column = frame.column + 1;
+			top++;
+		}
+	}
+	
+	for (i = 0; i < trie->numSequences; i++) {
+		out[i] = trie->nodes[trie->ends[i]].probability;
+	}
+	
+	free(stack);
+	free(alphas);
+}
@@ -0,0 +1,450 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // mmap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "modelbank.h"
+#include "util.h"
+
+// The file format is little-endian and used in place
+static int little_endian()
+{
+    uint16_t one = 1;
+    return *(uint8_t *)&one == 1;
+}
+
+/*
+ * Saving
+ */
+
+// The file image, built in memory and written in one go
+struct image {
+    uint8_t *data;
+    size_t len, cap;
+};
+
+// Appends n bytes (8-byte aligned) and returns their offset
+static uint64_t image_put(struct image *image, const void *p, size_t n)
+{
+    size_t at = (image->len + 7) & ~(size_t)7;
+
+    if (at + n > image->cap) {
+        image->cap = MAX(2 * image->cap, at + n);
+        image->data = xrealloc(image->data, image->cap);
+    }
+    memset(image->data + image->len, 0, at - image->len);
+    if (n)
+        memcpy(image->data + at, p, n);
+    image->len = at + n;
+    return at;
+}
+
+/*
+ * Writes the n models to path.  Models sharing a quantizer object share
+ * one codebook record, and share one quantizer again once loaded.
+ * Returns 0, or -1 if the file couldn't be written.
+ */
+int modelbank_save(const char *path, struct gesturemodel **models, int n)
+{
+    if (!little_endian())
+        die("model banks are only written on little-endian hosts\n");
+
+    struct quantizer *distinct[n];
+    int codebook_of[n];
+    int n_codebooks = 0;
+
+    for (int i = 0; i < n; i++) {
+        int c;
+        for (c = 0; c < n_codebooks && distinct[c] != models[i]->quantizer; c++)
+            ;
+        if (c == n_codebooks)
+            distinct[n_codebooks++] = models[i]->quantizer;
+        codebook_of[i] = c;
+    }
+
+    struct image image = { 0 };
+    struct modelbank_header header;
+    struct modelbank_codebook codebooks[n_codebooks > 0 ? n_codebooks : 1];
+    struct modelbank_model records[n > 0 ? n : 1];
+
+    memset(&header, 0, sizeof(header));
+    memset(codebooks, 0, sizeof(codebooks));
+    memset(records, 0, sizeof(records));
+
+    // Records first, with offsets filled in as the arrays go in after them
+    image_put(&image, &header, sizeof(header));
+    header.codebooks_offset = image_put(&image, codebooks, sizeof(struct modelbank_codebook) * n_codebooks);
+    header.models_offset    = image_put(&image, records, sizeof(struct modelbank_model) * n);
+
+    for (int c = 0; c < n_codebooks; c++) {
+        struct quantizer *q = distinct[c];
+        int64_t counts[q->map_size];
+
+        for (int i = 0; i < q->map_size; i++)
+            counts[i] = q->counts[i];
+
+        codebooks[c].states   = q->states;
+        codebooks[c].map_size = q->map_size;
+        codebooks[c].seeding  = q->seeding;
+        codebooks[c].radius   = q->radius;
+        codebooks[c].map      = image_put(&image, q->map, sizeof(*q->map) * q->map_size);
+        codebooks[c].counts   = image_put(&image, counts, sizeof(counts));
+    }
+
+    for (int i = 0; i < n; i++) {
+        struct gesturemodel *m = models[i];
+        HmmStateRef hmm = m->hmm;
+
+        records[i].id                 = m->id;
+        records[i].states             = hmm->numStates;
+        records[i].observations       = hmm->numObservations;
+        records[i].codebook           = codebook_of[i];
+        records[i].defaultprobability = m->defaultprobability;
+        records[i].p_initial = image_put(&image, hmm->p_initial, sizeof(double) * hmm->numStates);
+        records[i].p_change  = image_put(&image, hmm->p_change, sizeof(double) * hmm->numStates * hmm->numStates);
+        records[i].p_emit    = image_put(&image, hmm->p_emit, sizeof(double) * hmm->numStates * hmm->numObservations);
+    }
+
+    memcpy(header.magic, MODELBANK_MAGIC, 4);
+    header.version     = MODELBANK_VERSION;
+    header.n_models    = n;
+    header.n_codebooks = n_codebooks;
+    header.file_len    = image.len;
+
+    memcpy(image.data, &header, sizeof(header));
+    memcpy(image.data + header.codebooks_offset, codebooks, sizeof(struct modelbank_codebook) * n_codebooks);
+    memcpy(image.data + header.models_offset, records, sizeof(struct modelbank_model) * n);
+
+    FILE *f = fopen(path, "wb");
+    int err = !f || fwrite(image.data, 1, image.len, f) != image.len;
+    if (f && fclose(f))
+        err = 1;
+
+    free(image.data);
+    return err ? -1 : 0;
+}
+
+/*
+ * Loading
+ */
+
+// Whether count elements of size bytes at offset lie inside the file
+static int in_file(const struct modelbank *this, uint64_t offset, uint64_t count, uint64_t size)
+{
+    return offset % 8 == 0 && offset <= this->map_len
+        && count <= (this->map_len - offset) / size;
+}
+
+static int bank_valid(const struct modelbank *this)
+{
+    const struct modelbank_header *h = this->map;
+
+    if (memcmp(h->magic, MODELBANK_MAGIC, 4) || h->version != MODELBANK_VERSION || h->file_len != this->map_len)
+        return 0;
+    if (!in_file(this, h->codebooks_offset, h->n_codebooks, sizeof(struct modelbank_codebook))
+        || !in_file(this, h->models_offset, h->n_models, sizeof(struct modelbank_model)))
+        return 0;
+
+    const struct modelbank_codebook *codebooks = (const void *)((const uint8_t *)this->map + h->codebooks_offset);
+    const struct modelbank_model *models = (const void *)((const uint8_t *)this->map + h->models_offset);
+
+    for (uint32_t c = 0; c < h->n_codebooks; c++) {
+        const struct modelbank_codebook *cb = &codebooks[c];
+
+        if (cb->map_size <= 0 || cb->map_size >= MAX_SYMBOLS || cb->states < 0
+            || !in_file(this, cb->map, cb->map_size, 3 * sizeof(double))
+            || !in_file(this, cb->counts, cb->map_size, sizeof(int64_t)))
+            return 0;
+    }
+    for (uint32_t i = 0; i < h->n_models; i++) {
+        const struct modelbank_model *m = &models[i];
+
+        if (m->codebook < 0 || (uint32_t)m->codebook >= h->n_codebooks
+            || m->observations != codebooks[m->codebook].map_size
+            || m->states <= 0 || m->states > 0xffff
+            || !in_file(this, m->p_initial, m->states, sizeof(double))
+            || !in_file(this, m->p_change, (uint64_t)m->states * m->states, sizeof(double))
+            || !in_file(this, m->p_emit, (uint64_t)m->states * m->observations, sizeof(double)))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Maps the bank at path and points a set of gesture models into it: no
+ * parsing, no copying.  Returns NULL if the file can't be read or isn't
+ * a bank this code understands.
+ */
+struct modelbank *modelbank_open(const char *path)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(struct modelbank_header) || !little_endian()) {
+        close(fd);
+        return NULL;
+    }
+
+    // Private and writable: retraining copies the pages it touches
+    void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    struct modelbank *this = xalloc(sizeof(struct modelbank));
+    this->map = map;
+    this->map_len = st.st_size;
+
+    if (!bank_valid(this)) {
+        munmap(map, st.st_size);
+        free(this);
+        return NULL;
+    }
+
+    uint8_t *base = map;
+    const struct modelbank_header *h = map;
+    struct modelbank_codebook *codebooks = (void *)(base + h->codebooks_offset);
+    struct modelbank_model *records = (void *)(base + h->models_offset);
+    int copy_counts = sizeof(long) != sizeof(int64_t);
+    long total = 0;
+
+    this->n_codebooks = h->n_codebooks;
+    this->n_models    = h->n_models;
+    this->quantizers  = xalloc(sizeof(struct quantizer) * MAX(this->n_codebooks, 1));
+    this->hmms        = xalloc(sizeof(HmmState) * MAX(this->n_models, 1));
+    this->model_storage = xalloc(sizeof(struct gesturemodel) * MAX(this->n_models, 1));
+    this->models      = xalloc(sizeof(struct gesturemodel *) * MAX(this->n_models, 1));
+
+    if (copy_counts) {
+        for (int c = 0; c < this->n_codebooks; c++)
+            total += codebooks[c].map_size;
+        this->counts = xalloc(sizeof(long) * MAX(total, 1));
+        total = 0;
+    }
+
+    for (int c = 0; c < this->n_codebooks; c++) {
+        struct quantizer *q = &this->quantizers[c];
+        int64_t *counts = (void *)(base + codebooks[c].counts);
+
+        q->radius      = codebooks[c].radius;
+        q->states      = codebooks[c].states;
+        q->map_size    = codebooks[c].map_size;
+        q->seeding     = codebooks[c].seeding;
+        q->seed        = 1;
+        q->map         = (void *)(base + codebooks[c].map);
+        q->initialized = 1;
+        q->refs        = 0;     // counted below, and never dropped to 0 by anyone but the bank
+
+        if (copy_counts) {
+            q->counts = this->counts + total;
+            for (int i = 0; i < q->map_size; i++)
+                q->counts[i] = counts[i];
+            total += q->map_size;
+        } else {
+            q->counts = (long *)counts;
+        }
+    }
+
+    for (int i = 0; i < this->n_models; i++) {
+        struct gesturemodel *m = &this->model_storage[i];
+        HmmState *hmm = &this->hmms[i];
+
+        hmm->numStates       = records[i].states;
+        hmm->numObservations = records[i].observations;
+        hmm->p_initial       = (void *)(base + records[i].p_initial);
+        hmm->p_change        = (void *)(base + records[i].p_change);
+        hmm->p_emit          = (void *)(base + records[i].p_emit);
+
+        m->id                 = records[i].id;
+        m->states             = records[i].states;
+        m->observations       = records[i].observations;
+        m->quantizer          = &this->quantizers[records[i].codebook];
+        m->hmm                = hmm;
+        m->defaultprobability = records[i].defaultprobability;
+        m->quantizer->refs++;
+
+        this->models[i] = m;
+    }
+
+    return this;
+}
+
+void modelbank_close(struct modelbank *this)
+{
+    for (int c = 0; c < this->n_codebooks; c++)
+        quantizer_dropLookup(&this->quantizers[c]);
+
+    munmap(this->map, this->map_len);
+    free(this->quantizers);
+    free(this->hmms);
+    free(this->model_storage);
+    free(this->models);
+    free(this->counts);
+    free(this);
+}
+
+/*
+ * Compiled-in banks
+ */
+
+// Every distinct value exactly, as a C99 hex float literal
+static void emit_double(FILE *out, double v)
+{
+    if (isnan(v))
+        fprintf(out, "NAN");
+    else if (isinf(v))
+        fprintf(out, v > 0 ? "INFINITY" : "-INFINITY");
+    else
+        fprintf(out, "%a", v);
+}
+
+static void emit_doubles(FILE *out, const char *type, const char *name, int n, const double *v)
+{
+    fprintf(out, "static const double %s_%s[%d] = {", name, type, n);
+    for (int i = 0; i < n; i++) {
+        fprintf(out, i % 4 ? " " : "\n    ");
+        emit_double(out, v[i]);
+        fprintf(out, ",");
+    }
+    fprintf(out, "\n};\n");
+}
+
+/*
+ * Writes C source defining the n models as static tables and a struct
+ * modelbank called name that points at them.  Compiled and linked in,
+ * the bank registers itself before main() runs (with GCC or clang;
+ * elsewhere call modelbank_register(&name)), and modelbank_lookup(name)
+ * finds it: no file I/O and no allocation.  Returns 0, or -1 on a write
+ * error.
+ */
+int modelbank_emit(FILE *out, const char *name, struct gesturemodel **models, int n)
+{
+    struct quantizer *distinct[n];
+    int codebook_of[n];
+    int n_codebooks = 0;
+    char table[128];
+
+    for (int i = 0; i < n; i++) {
+        int c;
+        for (c = 0; c < n_codebooks && distinct[c] != models[i]->quantizer; c++)
+            ;
+        if (c == n_codebooks)
+            distinct[n_codebooks++] = models[i]->quantizer;
+        codebook_of[i] = c;
+    }
+
+    fprintf(out, "/* Generated by modelbank_emit(). Models: %d, codebooks: %d. */\n\n", n, n_codebooks);
+    fprintf(out, "#include <math.h>\n\n#include \"modelbank.h\"\n\n");
+
+    for (int c = 0; c < n_codebooks; c++) {
+        struct quantizer *q = distinct[c];
+
+        snprintf(table, sizeof(table), "%s_codebook%d", name, c);
+        emit_doubles(out, "map", table, 3 * q->map_size, &q->map[0][0]);
+        fprintf(out, "static const long %s_counts[%d] = {", table, q->map_size);
+        for (int i = 0; i < q->map_size; i++)
+            fprintf(out, "%s%ld,", i % 8 ? " " : "\n    ", q->counts[i]);
+        fprintf(out, "\n};\n\n");
+    }
+
+    for (int i = 0; i < n; i++) {
+        HmmStateRef hmm = models[i]->hmm;
+
+        snprintf(table, sizeof(table), "%s_model%d", name, i);
+        emit_doubles(out, "initial", table, hmm->numStates, hmm->p_initial);
+        emit_doubles(out, "change", table, hmm->numStates * hmm->numStates, hmm->p_change);
+        emit_doubles(out, "emit", table, hmm->numStates * hmm->numObservations, hmm->p_emit);
+        fprintf(out, "\n");
+    }
+
+    fprintf(out, "static struct quantizer %s_quantizers[%d] = {\n", name, MAX(n_codebooks, 1));
+    for (int c = 0; c < n_codebooks; c++) {
+        struct quantizer *q = distinct[c];
+        int refs = 0;
+
+        for (int i = 0; i < n; i++)
+            refs += codebook_of[i] == c;
+
+        fprintf(out, "    { .radius = ");
+        emit_double(out, q->radius);
+        fprintf(out, ", .states = %d, .map_size = %d, .seeding = %d, .seed = 1,\n"
+                     "      .map = (double (*)[3])%s_codebook%d_map, .counts = (long *)%s_codebook%d_counts,\n"
+                     "      .initialized = 1, .refs = %d },\n",
+                q->states, q->map_size, q->seeding, name, c, name, c, refs);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static HmmState %s_hmms[%d] = {\n", name, MAX(n, 1));
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "    { .numStates = %u, .numObservations = %u, .p_initial = (double *)%s_model%d_initial,\n"
+                     "      .p_change = (double *)%s_model%d_change, .p_emit = (double *)%s_model%d_emit },\n",
+                models[i]->hmm->numStates, models[i]->hmm->numObservations, name, i, name, i, name, i);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static struct gesturemodel %s_storage[%d] = {\n", name, MAX(n, 1));
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "    { .states = %d, .observations = %d, .id = %d, .quantizer = &%s_quantizers[%d],\n"
+                     "      .hmm = &%s_hmms[%d], .defaultprobability = ",
+                models[i]->states, models[i]->observations, models[i]->id, name, codebook_of[i], name, i);
+        emit_double(out, models[i]->defaultprobability);
+        fprintf(out, " },\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static struct gesturemodel *%s_models[%d] = {", name, MAX(n, 1));
+    for (int i = 0; i < n; i++)
+        fprintf(out, "%s&%s_storage[%d],", i % 4 ? " " : "\n    ", name, i);
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "struct modelbank %s = {\n"
+                 "    .name = \"%s\",\n"
+                 "    .models = %s_models,\n"
+                 "    .n_models = %d,\n"
+                 "    .model_storage = %s_storage,\n"
+                 "    .quantizers = %s_quantizers,\n"
+                 "    .n_codebooks = %d,\n"
+                 "    .hmms = %s_hmms,\n"
+                 "};\n\n",
+            name, name, name, n, name, name, n_codebooks, name);
+
+    fprintf(out, "#if defined(__GNUC__)\n"
+                 "static void %s_register(void) __attribute__((constructor));\n"
+                 "static void %s_register(void)\n"
+                 "{\n"
+                 "    modelbank_register(&%s);\n"
+                 "}\n"
+                 "#endif\n", name, name, name);
+
+    return ferror(out) ? -1 : 0;
+}
+
+// Compiled-in banks, most recently registered first
+static struct modelbank *registered;
+
+// Adds a compiled-in bank to those modelbank_lookup() knows.  Not thread
+// safe: meant for startup, before any recognition threads exist.
+void modelbank_register(struct modelbank *bank)
+{
+    bank->next = registered;
+    registered = bank;
+}
+
+struct modelbank *modelbank_lookup(const char *name)
+{
+    for (struct modelbank *bank = registered; bank; bank = bank->next) {
+        if (!strcmp(bank->name, name))
+            return bank;
+    }
+    return NULL;
+}
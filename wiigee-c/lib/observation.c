@@ -1,40 +1,100 @@
 // vim:set ts=4 sw=4 ai et:
 
 #include <stdlib.h>
+#include <string.h>
+#include <assert.h>
 
 #include "observation.h"
+#include "arena.h"
 #include "util.h"
 #include "hmm.h"
 
 struct observation *observation_new()
 {
-    struct observation *this = xalloc(sizeof(struct observation));
+    return observation_new_in(NULL);
+}
+
+// An observation living in the arena, or on the heap if arena is NULL
+struct observation *observation_new_in(struct arena *arena)
+{
+    struct observation *this = arena ? arena_alloc(arena, sizeof(struct observation))
+                                     : xalloc(sizeof(struct observation));
+    this->arena = arena;
     this->sequence_len = 0;
+    this->sequence_cap = 0;
     this->sequence = NULL;
     return this;
 }
 
+// Make room for at least n symbols without further reallocation
+void observation_reserve(struct observation *this, int n)
+{
+    if (n <= this->sequence_cap)
+        return;
+
+    if (this->arena)
+        this->sequence = arena_grow(this->arena, this->sequence, this->sequence_cap, n);
+    else
+        this->sequence = xrealloc(this->sequence, n);
+    this->sequence_cap = n;
+}
+
+// Grow geometrically, so appending T symbols one by one costs O(T) copying
+static void observation_grow(struct observation *this, int n)
+{
+    if (n > this->sequence_cap)
+        observation_reserve(this, MAX(n, MAX(16, this->sequence_cap * 2)));
+}
+
 void observation_append(struct observation *this, int i)
 {
+    assert(i >= 0 && i < MAX_SYMBOLS);
+    observation_grow(this, this->sequence_len + 1);
     this->sequence_len++;
-    this->sequence = xrealloc(this->sequence, sizeof(int) * this->sequence_len);
     this->sequence[this->sequence_len-1] = i;
 }
 
+void observation_append_many(struct observation *this, const uint8_t *symbols, int n)
+{
+    if (n == 0)
+        return;     // symbols may be NULL, and memcpy() mustn't see that
+    observation_grow(this, this->sequence_len + n);
+    memcpy(&this->sequence[this->sequence_len], symbols, n);
+    this->sequence_len += n;
+}
+
+// Arena observations are reclaimed by arena_reset() instead
 void observation_free(struct observation *this)
 {
+    if (this->arena)
+        return;
+
     free(this->sequence);
     free(this);
 }
 
 
-// Convert a struct observation to a StateSequence, so we can interface with the hmm.c code
+// A zero-copy StateSequence over this observation's symbols, for the hmm.c code
+StateSequence observation_view(struct observation *this)
+{
+    return stateSequenceView(this->sequence, this->sequence_len);
+}
+
+// A StateSequence with its own copy of the symbols, for when the observation goes away first
 StateSequence *observation_to_StateSequence(struct observation *this)
 {
-    unsigned int states[this->sequence_len];
+    StateSequenceRef sequence;
 
-    for (int i = 0; i < this->sequence_len; i++)
-        states[i] = this->sequence[i];
+    if (this->arena) {
+        sequence = arena_alloc(this->arena, sizeof(StateSequence));
+        sequence->states = arena_alloc(this->arena, this->sequence_len);
+    } else {
+        sequence = xalloc(sizeof(StateSequence));
+        sequence->states = xalloc(this->sequence_len);
+    }
 
-    return createStateSequence(states, this->sequence_len);
+    sequence->arena = this->arena;
+    sequence->length = this->sequence_len;
+    memcpy(sequence->states, this->sequence, this->sequence_len);
+    return sequence;
 }
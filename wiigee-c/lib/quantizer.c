@@ -9,57 +9,267 @@
 #include <stdio.h>
 
 #include "quantizer.h"
+#include "gesture_soa.h"
+#include "arena.h"
 #include "util.h"
 
+// Memory from the quantizer's arena if it has one, or the heap
+static void *scratch_alloc(struct quantizer *this, size_t n)
+{
+    return this->arena ? arena_alloc(this->arena, n) : xalloc(n);
+}
+
+static void scratch_free(struct quantizer *this, void *p)
+{
+    if (!this->arena)
+        free(p);
+}
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
 struct quantizer *quantizer_new(int states)
 {
-    struct quantizer *this = xalloc(sizeof(struct quantizer));
-    this->states = states;
+    return quantizer_new_sized(states, MAP_SIZE, SEED_CIRCLE);
+}
+
+/*
+ * A quantizer with a codebook of map_size centroids.  Smaller codebooks make
+ * both quantization and the HMM emission tables cheaper; larger ones resolve
+ * more distinct orientations.
+ */
+struct quantizer *quantizer_new_sized(int states, int map_size, enum quantizer_seeding seeding)
+{
+    return quantizer_new_in(NULL, states, map_size, seeding);
+}
+
+/*
+ * A quantizer living in the arena, or on the heap if arena is NULL.  Its
+ * training scratch memory and the observations it produces come from the
+ * same arena.
+ */
+struct quantizer *quantizer_new_in(struct arena *arena, int states, int map_size, enum quantizer_seeding seeding)
+{
+    // symbols are bytes, and training uses one byte value as "unassigned"
+    assert(map_size > 0 && map_size < MAX_SYMBOLS);
+
+    struct quantizer *this = arena ? arena_alloc(arena, sizeof(struct quantizer))
+                                   : xalloc(sizeof(struct quantizer));
+    this->arena    = arena;
+    this->states   = states;
+    this->map_size = map_size;
+    this->seeding  = seeding;
+    this->seed     = 1;
+    this->map      = scratch_alloc(this, sizeof(*this->map) * map_size);
+    this->counts   = scratch_alloc(this, sizeof(*this->counts) * map_size);
+    this->refs     = 1;
+    return this;
+}
+
+// Take another reference to a codebook shared by several gesture models
+struct quantizer *quantizer_retain(struct quantizer *this)
+{
+    this->refs++;
     return this;
 }
 
+// Drop a reference; the last one frees the quantizer
 void quantizer_free(struct quantizer *this)
 {
+    if (--this->refs > 0)
+        return;
+
+    quantizer_dropLookup(this);
+    if (this->arena)
+        return;
+
+    free(this->map);
+    free(this->counts);
     free(this);
 }
 
-void initialize_centroids(struct quantizer *this, struct gesture *gesture)
+/*
+ * Whether two quantizers map every sample to the same symbol sequence: the
+ * same object, or identical codebooks and padding (e.g. a shared codebook
+ * that was loaded once per model).
+ */
+int quantizer_same(struct quantizer *a, struct quantizer *b)
 {
-    double pi = 3.14; // M_PI;
-    this->radius = (gesture->minacc + gesture->maxacc) / 2;
+    if (a == b)
+        return 1;
 
-    debug("Using radius: %f\n", this->radius);
+    return a->states == b->states
+        && a->map_size == b->map_size
+        && memcmp(a->map, b->map, sizeof(*a->map) * a->map_size) == 0;
+}
 
-    #if MAP_SIZE != 14
-    #error "If you change MAP_SIZE, you must update initialize_centroids()"
-    #endif
+/*
+ * Point k of n evenly spaced around a circle of the given radius, starting
+ * at angle offset*2pi/n.  Quarter turns are snapped to exact values, so
+ * centroids on the axes carry no cos(pi/2) residue.
+ */
+static void circle_point(int k, int n, double offset, double radius, double *c, double *s)
+{
+    if (offset == 0.0 && (4 * k) % n == 0) {
+        static const double quarter_c[] = { 1.0, 0.0, -1.0,  0.0 };
+        static const double quarter_s[] = { 0.0, 1.0,  0.0, -1.0 };
+        *c = quarter_c[4 * k / n] * radius;
+        *s = quarter_s[4 * k / n] * radius;
+        return;
+    }
 
+    double angle = 2 * M_PI * (k + offset) / n;
+    *c = cos(angle) * radius;
+    *s = sin(angle) * radius;
+}
+
+/*
+ * The wiigee layout, generalized to any codebook size: n/2+1 centroids go
+ * around the xz circle and the rest around the yz circle, avoiding the two
+ * points the circles share.  For n = 14 this is exactly the original table
+ * of 8 + 6 centroids.
+ */
+static void seed_circle(struct quantizer *this)
+{
+    int n = this->map_size;
+    int a = n / 2 + 1;
+    int b = n - a;
     int i = 0;
 
-    #define _add(x, y, z) do { \
-        this->map[i][0] = x; \
-        this->map[i][1] = y; \
-        this->map[i][2] = z; \
-        i++; \
-    } while (0);
-
-    _add( this->radius,               0.0,                         0.0                      );
-    _add( cos(pi/4)*this->radius,     0.0,                         sin(pi/4)*this->radius   );
-    _add( 0.0,                        0.0,                         this->radius             );
-    _add( cos(pi*3/4)*this->radius,   0.0,                         sin(pi*3/4)*this->radius );
-    _add( -this->radius,              0.0,                         0.0                      );
-    _add( cos(pi*5/4)*this->radius,   0.0,                         sin(pi*5/4)*this->radius );
-    _add( 0.0,                        0.0,                         -this->radius            );
-    _add( cos(pi*7/4)*this->radius,   0.0,                         sin(pi*7/4)*this->radius );
-    _add( 0.0,                        this->radius,                0.0                      );
-    _add( 0.0,                        cos(pi/4)*this->radius,      sin(pi/4)*this->radius   );
-    _add( 0.0,                        cos(pi*3/4)*this->radius,    sin(pi*3/4)*this->radius );
-    _add( 0.0,                        -this->radius,               0.0                      );
-    _add( 0.0,                        cos(pi*5/4)*this->radius,    sin(pi*5/4)*this->radius );
-    _add( 0.0,                        cos(pi*7/4)*this->radius,    sin(pi*7/4)*this->radius );
+    for (int k = 0; k < a; k++) {
+        circle_point(k, a, 0.0, this->radius, &this->map[i][0], &this->map[i][2]);
+        this->map[i][1] = 0.0;
+        i++;
+    }
+
+    if ((b + 2) % 4 == 0) {
+        // Two of b+2 evenly spaced points are (0, 0, +-r); walk b+2 and skip them
+        for (int k = 0; k < b + 2; k++) {
+            if (4 * k == b + 2 || 4 * k == 3 * (b + 2))
+                continue;
+            this->map[i][0] = 0.0;
+            circle_point(k, b + 2, 0.0, this->radius, &this->map[i][1], &this->map[i][2]);
+            i++;
+        }
+    } else {
+        // b points would land on (0, 0, +-r) when b%4 == 0; shift by half a step
+        double offset = (b % 4 == 0) ? 0.5 : 0.0;
+        for (int k = 0; k < b; k++) {
+            this->map[i][0] = 0.0;
+            circle_point(k, b, offset, this->radius, &this->map[i][1], &this->map[i][2]);
+            i++;
+        }
+    }
+
+    assert(i == n);
+}
+
+// A uniform double in [0, 1), from a xorshift generator kept in this->seed
+static double uniform(struct quantizer *this)
+{
+    unsigned int x = this->seed ? this->seed : 1;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    this->seed = x;
+    return (x - 1) / 4294967296.0;
+}
+
+/*
+ * Read-only view of training samples in any of the gesture layouts, for
+ * the code that is written once for all of them.
+ */
+struct samples {
+    int len;
+    const struct coordinate *data;  // struct gesture, or
+    const float *x, *y, *z;         // struct gesture_soa columns, or
+    const uint8_t *bx, *by, *bz;    // raw 8-bit report columns
+};
+
+static void sample_at(const struct samples *samples, int j, double *out)
+{
+    if (samples->data) {
+        out[0] = samples->data[j].x;
+        out[1] = samples->data[j].y;
+        out[2] = samples->data[j].z;
+    } else if (samples->bx) {
+        out[0] = samples->bx[j];
+        out[1] = samples->by[j];
+        out[2] = samples->bz[j];
+    } else {
+        out[0] = samples->x[j];
+        out[1] = samples->y[j];
+        out[2] = samples->z[j];
+    }
+}
+
+/*
+ * k-means++: the first centroid is a uniformly drawn sample, every further
+ * one a sample drawn with probability proportional to its squared distance
+ * from the nearest centroid chosen so far.
+ */
+static void seed_kmeanspp(struct quantizer *this, const struct samples *samples)
+{
+    int len = samples->len;
+    double *d2 = scratch_alloc(this, sizeof(double) * len);
+
+    for (int i = 0; i < this->map_size; i++) {
+        int pick = 0;
+
+        if (i == 0) {
+            pick = (int)(uniform(this) * len);
+        } else {
+            double total = 0;
+            for (int j = 0; j < len; j++)
+                total += d2[j];
+
+            if (total > 0) {
+                double r = uniform(this) * total;
+                for (pick = 0; pick < len - 1; pick++) {
+                    r -= d2[pick];
+                    if (r < 0)
+                        break;
+                }
+            } else {
+                // Fewer distinct samples than centroids; duplicates stay empty
+                pick = (int)(uniform(this) * len);
+            }
+        }
+
+        sample_at(samples, pick, this->map[i]);
+
+        for (int j = 0; j < len; j++) {
+            double sample[3];
+            sample_at(samples, j, sample);
+
+            double dx = sample[0] - this->map[i][0];
+            double dy = sample[1] - this->map[i][1];
+            double dz = sample[2] - this->map[i][2];
+            double d  = dx*dx + dy*dy + dz*dz;
+
+            if (i == 0 || d < d2[j])
+                d2[j] = d;
+        }
+    }
+
+    scratch_free(this, d2);
+}
+
+static void seed_centroids(struct quantizer *this, double minacc, double maxacc, const struct samples *samples)
+{
+    this->radius = (minacc + maxacc) / 2;
+
+    debug("Using radius: %f\n", this->radius);
+
+    if (this->seeding == SEED_KMEANSPP && samples->len > 0)
+        seed_kmeanspp(this, samples);
+    else
+        seed_circle(this);
 
     debug("Initial centroids:\n");
-    for (int i = 0; i < MAP_SIZE; i++) {
+    for (int i = 0; i < this->map_size; i++) {
         debug("   %2d:  %9.5f  %9.5f  %9.5f\n",
             i,
             this->map[i][0],
@@ -69,16 +279,60 @@ void initialize_centroids(struct quantizer *this, struct gesture *gesture)
     debug("\n");
 }
 
-int *deriveGroups(struct quantizer *this, struct gesture *gesture)
+void initialize_centroids(struct quantizer *this, struct gesture *gesture)
 {
-    int groups[MAP_SIZE * gesture->data_len];
+    struct samples samples = { gesture->data_len, gesture->data, NULL, NULL, NULL };
+    seed_centroids(this, gesture->minacc, gesture->maxacc, &samples);
+}
 
-    double d[MAP_SIZE * gesture->data_len];
+/*
+ * Place the initial centroids for gesture, the way training would start,
+ * without iterating; quantizer_updateCenteroids() can carry on from there.
+ */
+void quantizer_seed(struct quantizer *this, struct gesture *gesture)
+{
+    quantizer_dropLookup(this);
+    initialize_centroids(this, gesture);
+    this->initialized = 1;
+}
+
+/*
+ * Index of the centroid closest to (x, y, z).  Ties go to the lower index,
+ * the same way deriveGroups() breaks them.
+ */
+static int nearest_centroid(struct quantizer *this, double x, double y, double z)
+{
+    double smallest = DBL_MAX;
+    int row = 0;
+
+    for (int i = 0; i < this->map_size; i++) {
+        double vector[3];
+        vector[0] = this->map[i][0] - x;
+        vector[1] = this->map[i][1] - y;
+        vector[2] = this->map[i][2] - z;
+
+        double d = sqrt((vector[0] * vector[0])
+                      + (vector[1] * vector[1])
+                      + (vector[2] * vector[2]));
+        if (d < smallest) {
+            smallest = d;
+            row = i;
+        }
+    }
+
+    return row;
+}
+
+// One-hot map_size x data_len matrix of sample-to-centroid assignments, into groups
+static void derive_groups(struct quantizer *this, struct gesture *gesture, int *groups)
+{
+
+    double d[this->map_size * gesture->data_len];
 
     debug("\nderiveGroups\n");
 
     // Calculate cartesian distance
-    for (int i = 0; i < MAP_SIZE; i++) { // lines
+    for (int i = 0; i < this->map_size; i++) { // lines
         double ref[3];
         ref[0] = this->map[i][0];
         ref[1] = this->map[i][1];
@@ -99,7 +353,7 @@ int *deriveGroups(struct quantizer *this, struct gesture *gesture)
             double newd = sqrt((vector[0] * vector[0])
                              + (vector[1] * vector[1])
                              + (vector[2] * vector[2]));
-            d[ row_col(MAP_SIZE, gesture->data_len, i, j) ] = newd;
+            d[ row_col(this->map_size, gesture->data_len, i, j) ] = newd;
             debug("%5.0f |", newd);
         }
         debug("\n");
@@ -112,7 +366,7 @@ int *deriveGroups(struct quantizer *this, struct gesture *gesture)
         double smallest = DBL_MAX;
         int row = 0;
 
-        for (int i = 0; i < MAP_SIZE; i++) {
+        for (int i = 0; i < this->map_size; i++) {
             if (d[i*gesture->data_len+j] < smallest) {
                 smallest = d[i*gesture->data_len+j];
                 row = i;
@@ -122,17 +376,22 @@ int *deriveGroups(struct quantizer *this, struct gesture *gesture)
 
         groups[row*gesture->data_len+j] = 1; // guppe gesetzt ("groups set")
     }
+}
 
-    int *ret = xalloc(sizeof(groups));
-    return memcpy(ret, groups, sizeof(groups));
+int *deriveGroups(struct quantizer *this, struct gesture *gesture)
+{
+    int *groups = scratch_alloc(this, sizeof(int) * this->map_size * gesture->data_len);
+    derive_groups(this, gesture, groups);
+    return groups;
 }
 
 void quantizer_trainCenteroids(struct quantizer *this, struct gesture *gesture)
 {
-    int size   = MAP_SIZE * gesture->data_len * sizeof(int);
-    int *g     = xalloc(size);
-    int *g_old = xalloc(size);
+    int size   = this->map_size * gesture->data_len * sizeof(int);
+    int *g     = scratch_alloc(this, size);
+    int *g_old = scratch_alloc(this, size);
 
+    quantizer_dropLookup(this);
     initialize_centroids(this, gesture);
 
     do {
@@ -140,11 +399,10 @@ void quantizer_trainCenteroids(struct quantizer *this, struct gesture *gesture)
 
         debug("Still in the loop\n");
         memcpy(g_old, g, size);
-        free(g);
-        g = deriveGroups(this, gesture);
+        derive_groups(this, gesture, g);
 
         // calculate new centeroids
-        for (int i = 0; i < MAP_SIZE; i++) {
+        for (int i = 0; i < this->map_size; i++) {
             debug("iter i %d\n", i);
             double countX = 0; // "zaehler"
             double countY = 0;
@@ -170,16 +428,16 @@ void quantizer_trainCenteroids(struct quantizer *this, struct gesture *gesture)
         }
 
         debug("old g:\n");
-        for (int row = 0; row < MAP_SIZE; row++) {
+        for (int row = 0; row < this->map_size; row++) {
             for (int col = 0; col < gesture->data_len; col++) {
-                debug("%d ", g_old[ row_col(MAP_SIZE, gesture->data_len, row, col) ]);
+                debug("%d ", g_old[ row_col(this->map_size, gesture->data_len, row, col) ]);
             }
             debug("\n");
         }
         debug("new g:\n");
-        for (int row = 0; row < MAP_SIZE; row++) {
+        for (int row = 0; row < this->map_size; row++) {
             for (int col = 0; col < gesture->data_len; col++) {
-                debug("%d ", g[ row_col(MAP_SIZE, gesture->data_len, row, col) ]);
+                debug("%d ", g[ row_col(this->map_size, gesture->data_len, row, col) ]);
             }
             debug("\n");
         }
@@ -190,16 +448,15 @@ void quantizer_trainCenteroids(struct quantizer *this, struct gesture *gesture)
 
     debug("Final g output:\n");
     //for (int i = 0; i < this->states; i++) {
-    for (int i = 0; i < MAP_SIZE; i++) {
+    for (int i = 0; i < this->map_size; i++) {
         for (int j = 0; j < gesture->data_len; j++) {
-            debug("%d|", g[ row_col(MAP_SIZE, gesture->data_len, i, j) ]);
+            debug("%d|", g[ row_col(this->map_size, gesture->data_len, i, j) ]);
         }
         debug("\n");
     }
 
     debug("Final map value:\n");
-    // double map[MAP_SIZE][3];
-    for (int i = 0; i < MAP_SIZE; i++) {
+    for (int i = 0; i < this->map_size; i++) {
         debug("   %2d:  %5.1f  %5.1f  %5.1f\n",
             i,
             this->map[i][0],
@@ -207,29 +464,94 @@ void quantizer_trainCenteroids(struct quantizer *this, struct gesture *gesture)
             this->map[i][2]);
     }
 
-    free(g);
-    free(g_old);
+    // Remember the cluster sizes, so quantizer_updateCenteroids() can keep
+    // refining this codebook online at the right learning rate
+    for (int i = 0; i < this->map_size; i++) {
+        this->counts[i] = 0;
+        for (int j = 0; j < gesture->data_len; j++)
+            this->counts[i] += g[ row_col(this->map_size, gesture->data_len, i, j) ];
+    }
+    this->initialized = 1;
+
+    scratch_free(this, g);
+    scratch_free(this, g_old);
     debug("trainCenteroids returning\n");
 }
 
+/*
+ * One step of mini-batch k-means (Sculley 2010, "Web-scale k-means
+ * clustering"), using the gesture as the batch.
+ *
+ * All samples are assigned to their nearest centroid first, then each
+ * centroid is pulled towards its samples with its own learning rate of
+ * 1/count, which leaves every centroid at the running mean of everything it
+ * has absorbed.  Nothing but the gesture itself is held in memory, so a
+ * codebook can be trained over an arbitrarily large stream, or an existing
+ * codebook from quantizer_trainCenteroids() refined as new gestures arrive.
+ *
+ * A quantizer without a codebook is seeded from this gesture's min/max.
+ */
+void quantizer_updateCenteroids(struct quantizer *this, struct gesture *gesture)
+{
+    if (gesture->data_len < 1)
+        return;
+
+    quantizer_dropLookup(this);
+
+    if (!this->initialized) {
+        initialize_centroids(this, gesture);
+        this->initialized = 1;
+    }
+
+    int *groups = scratch_alloc(this, sizeof(int) * gesture->data_len);
+
+    for (int j = 0; j < gesture->data_len; j++)
+        groups[j] = nearest_centroid(this,
+                                     gesture->data[j].x,
+                                     gesture->data[j].y,
+                                     gesture->data[j].z);
+
+    for (int j = 0; j < gesture->data_len; j++) {
+        int i = groups[j];
+        double eta = 1.0 / ++this->counts[i];
+
+        this->map[i][0] += eta * (gesture->data[j].x - this->map[i][0]);
+        this->map[i][1] += eta * (gesture->data[j].y - this->map[i][1]);
+        this->map[i][2] += eta * (gesture->data[j].z - this->map[i][2]);
+    }
+
+    debug("updateCenteroids: absorbed %d samples\n", gesture->data_len);
+    scratch_free(this, groups);
+}
+
+/*
+ * Train the codebook from a stream of gestures, one mini-batch per gesture.
+ * Unlike gesturemodel_train(), which concatenates the whole training set
+ * into a single gesture first, memory use does not grow with the dataset.
+ */
+void quantizer_trainCenteroidsStream(struct quantizer *this, gesture_source next, void *ctx)
+{
+    struct gesture *gesture;
+
+    while ((gesture = next(ctx)))
+        quantizer_updateCenteroids(this, gesture);
+}
+
 struct observation *quantizer_getObservationSequence(struct quantizer *this, struct gesture *gesture)
 {
     debug("getObservationSequence starting\n");
-    int *groups = deriveGroups(this, gesture);
-    struct observation *observation = observation_new();
+    struct observation *observation = observation_new_in(this->arena);
+    observation_reserve(observation, MAX(gesture->data_len, this->states));
 
     debug("Visible symbol sequence:\n");
 
-    for (int j = 0; j < gesture->data_len; j++) {  // spalten
-        for (int i = 0; i < MAP_SIZE; i++) { // zeilen
-            if (groups[ row_col(MAP_SIZE, gesture->data_len, i, j) ] == 1) {
-                debug("%d\n", i);
-                observation_append(observation, i);
-                break;
-            } else {
-                debug("skipping groups[%d][%d] == %d)\n", i, j, groups[row_col(MAP_SIZE, gesture->data_len, i, j) ]);
-            }
-        }
+    for (int j = 0; j < gesture->data_len; j++) {
+        int symbol = quantizer_symbol(this,
+                                      gesture->data[j].x,
+                                      gesture->data[j].y,
+                                      gesture->data[j].z);
+        debug("%d\n", symbol);
+        observation_append(observation, symbol);
     }
 
     while (observation->sequence_len < this->states) {
@@ -238,6 +560,513 @@ struct observation *quantizer_getObservationSequence(struct quantizer *this, str
     }
 
     debug("returning\n\n\n");
-    free(groups);
     return observation;
 }
+
+/*
+ * The observation symbol for a single sample.  Integral samples on the
+ * lookup grid cost one table load (plus a handful of distances in boundary
+ * cells); everything else falls back to comparing against every centroid.
+ * Either way the answer is the one deriveGroups() would give.
+ */
+int quantizer_symbol(struct quantizer *this, double x, double y, double z)
+{
+    struct quantizer_lookup *lookup = this->lookup;
+
+    // Only convert what's on the grid: (int) of a NaN or an out of range
+    // double is undefined, and comparisons with NaN are false
+    if (lookup && x >= lookup->origin && x < lookup->origin + 256
+               && y >= lookup->origin && y < lookup->origin + 256
+               && z >= lookup->origin && z < lookup->origin + 256) {
+        int ix = (int)x - lookup->origin;
+        int iy = (int)y - lookup->origin;
+        int iz = (int)z - lookup->origin;
+
+        if (ix + lookup->origin == x && iy + lookup->origin == y && iz + lookup->origin == z) {
+            int cells = lookup->cells;
+            int shift = lookup->shift;
+            unsigned short entry = lookup->table[((ix >> shift) * cells + (iy >> shift)) * cells + (iz >> shift)];
+
+            if (!(entry & LOOKUP_LIST))
+                return entry;
+
+            if (entry != LOOKUP_EXACT) {
+                unsigned char *list = &lookup->pool[ lookup->lists[entry & ~LOOKUP_LIST] ];
+                double smallest = DBL_MAX;
+                int row = 0;
+
+                // Candidates are in ascending order, so ties break as in nearest_centroid()
+                for (int k = 1; k <= list[0]; k++) {
+                    double vector[3];
+                    vector[0] = this->map[list[k]][0] - x;
+                    vector[1] = this->map[list[k]][1] - y;
+                    vector[2] = this->map[list[k]][2] - z;
+
+                    double d = sqrt((vector[0] * vector[0])
+                                  + (vector[1] * vector[1])
+                                  + (vector[2] * vector[2]));
+                    if (d < smallest) {
+                        smallest = d;
+                        row = list[k];
+                    }
+                }
+                return row;
+            }
+        }
+    }
+
+    return nearest_centroid(this, x, y, z);
+}
+
+/*
+ * Column kernels, shared by the struct-of-arrays and the raw 8-bit paths.
+ *
+ * Samples are widened to double a block at a time, by a loop per layout,
+ * and compared centroid by centroid over the block in loops without
+ * branches or square roots, over contiguous doubles, so they vectorize.
+ *
+ * The symbols are still exactly nearest_centroid()'s, which compares
+ * sqrt()s: two different squared distances can have the same root, and
+ * the tie then goes to the lower index.  So the first pass only finds
+ * each sample's smallest squared distance, and the second takes the
+ * lowest centroid whose squared distance has the same root as that, all
+ * of which lie in a range of a few doubles above it.  With a lookup table
+ * built, samples go through quantizer_symbol() instead.
+ */
+#define COLUMN_BLOCK    64
+
+// Samples start to start + n - 1, widened to double
+static void load_block(const struct samples *samples, int start, int n, double *x, double *y, double *z)
+{
+    if (samples->data) {
+        const struct coordinate *data = samples->data + start;
+        for (int j = 0; j < n; j++) {
+            x[j] = data[j].x;
+            y[j] = data[j].y;
+            z[j] = data[j].z;
+        }
+    } else if (samples->bx) {
+        const uint8_t *bx = samples->bx + start, *by = samples->by + start, *bz = samples->bz + start;
+        for (int j = 0; j < n; j++) {
+            x[j] = bx[j];
+            y[j] = by[j];
+            z[j] = bz[j];
+        }
+    } else {
+        const float *fx = samples->x + start, *fy = samples->y + start, *fz = samples->z + start;
+        for (int j = 0; j < n; j++) {
+            x[j] = fx[j];
+            y[j] = fy[j];
+            z[j] = fz[j];
+        }
+    }
+}
+
+// The largest squared distance with the same root as d, or -1 for none
+static double same_root(double d)
+{
+    if (d == INFINITY)
+        return -1;      // nearest_centroid() takes no infinite distance
+
+    double root = sqrt(d);
+    while (sqrt(nextafter(d, INFINITY)) == root)
+        d = nextafter(d, INFINITY);
+    return d;
+}
+
+static void nearest_columns(struct quantizer *this, const struct samples *samples, uint8_t *symbols)
+{
+    double x[COLUMN_BLOCK], y[COLUMN_BLOCK], z[COLUMN_BLOCK], best[COLUMN_BLOCK];
+    int row[COLUMN_BLOCK];
+
+    for (int start = 0; start < samples->len; start += COLUMN_BLOCK) {
+        int n = MIN(COLUMN_BLOCK, samples->len - start);
+        uint8_t *out = symbols + start;
+
+        load_block(samples, start, n, x, y, z);
+
+        if (this->lookup) {
+            for (int j = 0; j < n; j++)
+                out[j] = quantizer_symbol(this, x[j], y[j], z[j]);
+            continue;
+        }
+
+        for (int j = 0; j < n; j++) {
+            best[j] = INFINITY;
+            row[j] = 0;
+        }
+
+        for (int i = 0; i < this->map_size; i++) {
+            const double cx = this->map[i][0];
+            const double cy = this->map[i][1];
+            const double cz = this->map[i][2];
+
+            for (int j = 0; j < n; j++) {
+                double dx = cx - x[j];
+                double dy = cy - y[j];
+                double dz = cz - z[j];
+                double d  = (dx * dx) + (dy * dy) + (dz * dz);
+
+                best[j] = d < best[j] ? d : best[j];
+            }
+        }
+
+        for (int j = 0; j < n; j++)
+            best[j] = same_root(best[j]);
+
+        // Backwards, so the lowest of the closest is the one left
+        for (int i = this->map_size - 1; i >= 0; i--) {
+            const double cx = this->map[i][0];
+            const double cy = this->map[i][1];
+            const double cz = this->map[i][2];
+
+            for (int j = 0; j < n; j++) {
+                double dx = cx - x[j];
+                double dy = cy - y[j];
+                double dz = cz - z[j];
+                double d  = (dx * dx) + (dy * dy) + (dz * dz);
+
+                row[j] = d <= best[j] ? i : row[j];
+            }
+        }
+
+        for (int j = 0; j < n; j++)
+            out[j] = row[j];
+    }
+}
+
+// Lloyd's k-means as in quantizer_trainCenteroids(), over columns
+static void train_columns(struct quantizer *this, const struct samples *samples, double minacc, double maxacc)
+{
+    int n = samples->len;
+    uint8_t *g     = scratch_alloc(this, n);
+    uint8_t *g_old = scratch_alloc(this, n);
+    double (*sum)[3] = scratch_alloc(this, sizeof(*sum) * this->map_size);
+
+    quantizer_dropLookup(this);
+    seed_centroids(this, minacc, maxacc, samples);
+
+    memset(g, MAX_SYMBOLS - 1, n);    // no centroid has that index
+
+    int changed;
+    do {
+        uint8_t *tmp = g_old; g_old = g; g = tmp;
+        nearest_columns(this, samples, g);
+
+        for (int i = 0; i < this->map_size; i++) {
+            sum[i][0] = sum[i][1] = sum[i][2] = 0;
+            this->counts[i] = 0;
+        }
+        for (int start = 0; start < n; start += COLUMN_BLOCK) {
+            double x[COLUMN_BLOCK], y[COLUMN_BLOCK], z[COLUMN_BLOCK];
+            int len = MIN(COLUMN_BLOCK, n - start);
+
+            load_block(samples, start, len, x, y, z);
+            for (int j = 0; j < len; j++) {
+                int i = g[start + j];
+                sum[i][0] += x[j];
+                sum[i][1] += y[j];
+                sum[i][2] += z[j];
+                this->counts[i]++;
+            }
+        }
+        for (int i = 0; i < this->map_size; i++) {
+            if (this->counts[i]) {
+                this->map[i][0] = sum[i][0] / this->counts[i];
+                this->map[i][1] = sum[i][1] / this->counts[i];
+                this->map[i][2] = sum[i][2] / this->counts[i];
+            }
+        }
+
+        changed = memcmp(g, g_old, n) != 0;
+    } while (changed);
+
+    this->initialized = 1;
+
+    scratch_free(this, g);
+    scratch_free(this, g_old);
+    scratch_free(this, sum);
+}
+
+// Mini-batch k-means step as in quantizer_updateCenteroids(), over columns
+static void update_columns(struct quantizer *this, const struct samples *samples, double minacc, double maxacc)
+{
+    int n = samples->len;
+
+    if (n < 1)
+        return;
+
+    quantizer_dropLookup(this);
+
+    if (!this->initialized) {
+        seed_centroids(this, minacc, maxacc, samples);
+        this->initialized = 1;
+    }
+
+    uint8_t *groups = scratch_alloc(this, n);
+
+    nearest_columns(this, samples, groups);
+
+    for (int j = 0; j < n; j++) {
+        int i = groups[j];
+        double eta = 1.0 / ++this->counts[i];
+        double sample[3];
+
+        sample_at(samples, j, sample);
+        this->map[i][0] += eta * (sample[0] - this->map[i][0]);
+        this->map[i][1] += eta * (sample[1] - this->map[i][1]);
+        this->map[i][2] += eta * (sample[2] - this->map[i][2]);
+    }
+
+    scratch_free(this, groups);
+}
+
+static struct observation *observe_columns(struct quantizer *this, const struct samples *samples)
+{
+    int n = samples->len;
+    struct observation *observation = observation_new_in(this->arena);
+    observation_reserve(observation, MAX(n, this->states));
+
+    nearest_columns(this, samples, observation->sequence);
+    observation->sequence_len = n;
+
+    while (observation->sequence_len < this->states)
+        observation_append(observation, observation->sequence[observation->sequence_len-1]);
+
+    return observation;
+}
+
+void quantizer_trainCenteroids_soa(struct quantizer *this, struct gesture_soa *gesture)
+{
+    struct samples samples = { gesture->data_len, NULL, gesture->x, gesture->y, gesture->z };
+    train_columns(this, &samples, gesture->minacc, gesture->maxacc);
+}
+
+void quantizer_updateCenteroids_soa(struct quantizer *this, struct gesture_soa *gesture)
+{
+    struct samples samples = { gesture->data_len, NULL, gesture->x, gesture->y, gesture->z };
+    update_columns(this, &samples, gesture->minacc, gesture->maxacc);
+}
+
+struct observation *quantizer_getObservationSequence_soa(struct quantizer *this, struct gesture_soa *gesture)
+{
+    struct samples samples = { gesture->data_len, NULL, gesture->x, gesture->y, gesture->z };
+    return observe_columns(this, &samples);
+}
+
+/*
+ * Raw 8-bit report kernels, for columns used in place (capture files, see
+ * capture.h).  The min/max acceleration that seeds SEED_CIRCLE is taken
+ * from the samples, as gesture_minmax() would.
+ */
+static void minmax_u8(const struct samples *samples, double *minacc, double *maxacc)
+{
+    int lo = 255, hi = 0;
+
+    for (int j = 0; j < samples->len; j++) {
+        lo = MIN(lo, MIN(samples->bx[j], MIN(samples->by[j], samples->bz[j])));
+        hi = MAX(hi, MAX(samples->bx[j], MAX(samples->by[j], samples->bz[j])));
+    }
+    *minacc = samples->len ? lo : DBL_MAX;
+    *maxacc = samples->len ? hi : DBL_MIN;
+}
+
+void quantizer_trainCenteroids_u8(struct quantizer *this, const uint8_t *x, const uint8_t *y, const uint8_t *z, int n)
+{
+    struct samples samples = { n, NULL, NULL, NULL, NULL, x, y, z };
+    double minacc, maxacc;
+
+    minmax_u8(&samples, &minacc, &maxacc);
+    train_columns(this, &samples, minacc, maxacc);
+}
+
+void quantizer_updateCenteroids_u8(struct quantizer *this, const uint8_t *x, const uint8_t *y, const uint8_t *z, int n)
+{
+    struct samples samples = { n, NULL, NULL, NULL, NULL, x, y, z };
+    double minacc, maxacc;
+
+    minmax_u8(&samples, &minacc, &maxacc);
+    update_columns(this, &samples, minacc, maxacc);
+}
+
+struct observation *quantizer_getObservationSequence_u8(struct quantizer *this,
+                                                        const uint8_t *x, const uint8_t *y, const uint8_t *z, int n)
+{
+    struct samples samples = { n, NULL, NULL, NULL, NULL, x, y, z };
+    return observe_columns(this, &samples);
+}
+
+// Squared distance from c to the nearest and farthest points of [lo, hi]
+static void interval_distance(double c, double lo, double hi, double *dmin, double *dmax)
+{
+    double near = c < lo ? lo - c : (c > hi ? c - hi : 0.0);
+    double far  = MAX(fabs(c - lo), fabs(c - hi));
+
+    *dmin += near * near;
+    *dmax += far * far;
+}
+
+// Hash set of candidate lists, so every distinct list is only pooled once
+struct list_set {
+    int *slots;                 // List index + 1, or 0 for empty
+    int size;
+};
+
+static unsigned int list_hash(const unsigned char *list)
+{
+    unsigned int h = 2166136261u;   // FNV-1a
+    for (int k = 0; k <= list[0]; k++)
+        h = (h ^ list[k]) * 16777619u;
+    return h;
+}
+
+/*
+ * Index of the candidate list equal to `list`, adding it to the pool if it
+ * is new.  Returns -1 once the table entries cannot address any more lists.
+ */
+static int intern_list(struct quantizer_lookup *lookup, struct list_set *set, const unsigned char *list)
+{
+    if (2 * (lookup->lists_len + 1) > set->size) {
+        int size = set->size ? set->size * 2 : 64;
+        int *slots = xalloc(sizeof(int) * size);
+
+        for (int i = 0; i < set->size; i++) {
+            if (!set->slots[i])
+                continue;
+            unsigned int h = list_hash(&lookup->pool[ lookup->lists[set->slots[i] - 1] ]) & (size - 1);
+            while (slots[h])
+                h = (h + 1) & (size - 1);
+            slots[h] = set->slots[i];
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->size = size;
+    }
+
+    unsigned int h = list_hash(list) & (set->size - 1);
+    while (set->slots[h]) {
+        const unsigned char *other = &lookup->pool[ lookup->lists[set->slots[h] - 1] ];
+        if (memcmp(other, list, list[0] + 1) == 0)
+            return set->slots[h] - 1;
+        h = (h + 1) & (set->size - 1);
+    }
+
+    if (lookup->lists_len == LOOKUP_EXACT - LOOKUP_LIST)
+        return -1;
+
+    lookup->lists = xrealloc(lookup->lists, sizeof(unsigned int) * (lookup->lists_len + 1));
+    lookup->lists[lookup->lists_len] = lookup->pool_len;
+    lookup->pool = xrealloc(lookup->pool, lookup->pool_len + list[0] + 1);
+    memcpy(&lookup->pool[lookup->pool_len], list, list[0] + 1);
+    lookup->pool_len += list[0] + 1;
+
+    set->slots[h] = ++lookup->lists_len;
+    return lookup->lists_len - 1;
+}
+
+/*
+ * Precompute the nearest centroid for every 8-bit sample, so quantizing a
+ * wiimote report becomes a table load instead of map_size distances.
+ *
+ * origin is the sample value of the grid's first cell (0 for raw reports,
+ * -128 for reports cast to signed char), and cells are 2^shift values wide on
+ * every axis: shift 0 is a full 16M-entry table, each step up divides that by
+ * eight at the price of more cells straddling a boundary.  Must be rebuilt
+ * after training, which drops any existing table.
+ *
+ * Returns the memory footprint of the table in bytes.
+ */
+long quantizer_buildLookup(struct quantizer *this, int origin, int shift)
+{
+    assert(this->initialized);
+    assert(shift >= 0 && shift <= 8);
+    assert(this->map_size < LOOKUP_LIST && this->map_size <= 255);
+
+    quantizer_dropLookup(this);
+
+    struct quantizer_lookup *lookup = xalloc(sizeof(struct quantizer_lookup));
+    lookup->origin = origin;
+    lookup->shift  = shift;
+    lookup->cells  = 256 >> shift;
+
+    int cells = lookup->cells;
+    int width = 1 << shift;
+    lookup->table = xalloc(sizeof(unsigned short) * cells * cells * cells);
+
+    double *dmin = xalloc(sizeof(double) * this->map_size);
+    double *dmax = xalloc(sizeof(double) * this->map_size);
+    unsigned char *list = xalloc(this->map_size + 1);
+    struct list_set set = { NULL, 0 };
+
+    for (int cx = 0; cx < cells; cx++) {
+        for (int cy = 0; cy < cells; cy++) {
+            for (int cz = 0; cz < cells; cz++) {
+                // Only the integral samples in the cell matter, so bound by those
+                double lo[3], hi[3];
+                lo[0] = origin + cx * width; hi[0] = lo[0] + width - 1;
+                lo[1] = origin + cy * width; hi[1] = lo[1] + width - 1;
+                lo[2] = origin + cz * width; hi[2] = lo[2] + width - 1;
+
+                double best = DBL_MAX;
+                for (int i = 0; i < this->map_size; i++) {
+                    dmin[i] = dmax[i] = 0.0;
+                    for (int axis = 0; axis < 3; axis++)
+                        interval_distance(this->map[i][axis], lo[axis], hi[axis], &dmin[i], &dmax[i]);
+                    best = MIN(best, dmax[i]);
+                }
+
+                // Any centroid that might be closest somewhere in the cell; the
+                // slack keeps rounding from dropping the true winner
+                best += best * 1e-9 + 1e-9;
+                list[0] = 0;
+                for (int i = 0; i < this->map_size; i++)
+                    if (dmin[i] <= best)
+                        list[ ++list[0] ] = i;
+
+                unsigned short entry = list[1];
+                if (list[0] > 1) {
+                    int index = intern_list(lookup, &set, list);
+                    entry = index < 0 ? LOOKUP_EXACT : (LOOKUP_LIST | index);
+                }
+                lookup->table[(cx * cells + cy) * cells + cz] = entry;
+            }
+        }
+    }
+
+    free(set.slots);
+    free(list);
+    free(dmin);
+    free(dmax);
+
+    this->lookup = lookup;
+
+    debug("buildLookup: %d^3 cells, %d candidate lists, %ld bytes\n",
+          cells, lookup->lists_len, quantizer_lookupSize(this));
+    return quantizer_lookupSize(this);
+}
+
+// Bytes held by the lookup table, or 0 if there is none
+long quantizer_lookupSize(struct quantizer *this)
+{
+    struct quantizer_lookup *lookup = this->lookup;
+
+    if (!lookup)
+        return 0;
+
+    return sizeof(struct quantizer_lookup)
+         + sizeof(unsigned short) * (long)lookup->cells * lookup->cells * lookup->cells
+         + sizeof(unsigned int) * lookup->lists_len
+         + lookup->pool_len;
+}
+
+void quantizer_dropLookup(struct quantizer *this)
+{
+    if (!this->lookup)
+        return;
+
+    free(this->lookup->table);
+    free(this->lookup->lists);
+    free(this->lookup->pool);
+    free(this->lookup);
+    this->lookup = NULL;
+}
@@ -0,0 +1,210 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // sockets, MSG_NOSIGNAL
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "recognizerd.h"
+#include "util.h"
+
+static int address(struct sockaddr_un *addr, const char *path)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+// A socket listening at path, replacing any stale one; -1 on errors
+int recognizerd_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (address(&addr, path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 64)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// A connection to the daemon at path; -1 on errors
+int recognizerd_connect(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (address(&addr, path) || (fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        return -1;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const char *p = data;
+
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/*
+ * Writes one frame, all of it.  Frames from different threads to the same
+ * fd need outside locking.  Returns 0, or -1 on errors.
+ */
+int recognizerd_send(int fd, int type, uint32_t session, const void *payload, uint32_t length)
+{
+    struct recognizerd_header header = { length, type, 0, session };
+
+    if (write_all(fd, &header, sizeof(header)))
+        return -1;
+    return length ? write_all(fd, payload, length) : 0;
+}
+
+/*
+ * Appends one frame to what's waiting to be written.  Frames from
+ * different threads to the same writer need outside locking.
+ */
+void recognizerd_queue(struct recognizerd_writer *this, int type, uint32_t session, const void *payload, uint32_t length)
+{
+    struct recognizerd_header header = { length, type, 0, session };
+    size_t need = sizeof(header) + length;
+
+    if (this->cap - this->len < need) {
+        // Drop what's been written, and grow if that wasn't enough
+        memmove(this->buf, this->buf + this->pos, this->len - this->pos);
+        this->len -= this->pos;
+        this->pos = 0;
+        if (this->cap - this->len < need) {
+            this->cap = MAX(2 * this->cap, MAX(this->len + need, 8192));
+            this->buf = xrealloc(this->buf, this->cap);
+        }
+    }
+
+    memcpy(this->buf + this->len, &header, sizeof(header));
+    if (length)
+        memcpy(this->buf + this->len + sizeof(header), payload, length);
+    this->len += need;
+}
+
+/*
+ * Writes as much of what's queued as the socket takes; it should be
+ * non-blocking, so this never waits for the other end.  Doesn't raise
+ * SIGPIPE.  Returns the bytes still queued, or -1 on errors.
+ */
+int recognizerd_flush(struct recognizerd_writer *this, int fd)
+{
+    while (this->pos < this->len) {
+        ssize_t n = send(fd, this->buf + this->pos, this->len - this->pos, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        this->pos += n;
+    }
+    if (this->pos == this->len)
+        this->pos = this->len = 0;
+    return this->len - this->pos;
+}
+
+void recognizerd_writer_free(struct recognizerd_writer *this)
+{
+    free(this->buf);
+    this->buf = NULL;
+    this->len = this->pos = this->cap = 0;
+}
+
+/*
+ * Reads whatever fd has (one read, so it only blocks if fd does and has
+ * nothing).  Frames returned by recognizerd_next() before are gone after
+ * this.  Returns the bytes read, 0 at end of file, or -1 on errors.
+ */
+int recognizerd_fill(struct recognizerd_reader *this, int fd)
+{
+    // Drop what's been parsed, and make room for a good-sized read
+    memmove(this->buf, this->buf + this->pos, this->len - this->pos);
+    this->len -= this->pos;
+    this->pos = 0;
+
+    if (this->cap - this->len < 4096) {
+        this->cap = MAX(2 * this->cap, 8192);
+        this->buf = xrealloc(this->buf, this->cap);
+    }
+
+    ssize_t n;
+    do
+        n = read(fd, this->buf + this->len, this->cap - this->len);
+    while (n < 0 && errno == EINTR);
+
+    if (n > 0)
+        this->len += n;
+    return n;
+}
+
+/*
+ * The next complete frame held, if any: returns 1 and sets frame, 0 if
+ * more bytes are needed, or -1 if the stream is garbage (a payload longer
+ * than RECOGNIZERD_MAX_PAYLOAD).
+ */
+int recognizerd_next(struct recognizerd_reader *this, struct recognizerd_frame *frame)
+{
+    int got = recognizerd_peek(this, frame);
+
+    if (got > 0)
+        this->pos += sizeof(struct recognizerd_header) + frame->header.length;
+    return got;
+}
+
+// As recognizerd_next(), but the frame stays held, to be returned again
+int recognizerd_peek(struct recognizerd_reader *this, struct recognizerd_frame *frame)
+{
+    size_t held = this->len - this->pos;
+
+    if (held < sizeof(struct recognizerd_header))
+        return 0;
+
+    memcpy(&frame->header, this->buf + this->pos, sizeof(struct recognizerd_header));
+    if (frame->header.length > RECOGNIZERD_MAX_PAYLOAD)
+        return -1;
+    if (held < sizeof(struct recognizerd_header) + frame->header.length)
+        return 0;
+
+    frame->payload = this->buf + this->pos + sizeof(struct recognizerd_header);
+    return 1;
+}
+
+void recognizerd_reader_free(struct recognizerd_reader *this)
+{
+    free(this->buf);
+    this->buf = NULL;
+    this->len = this->pos = this->cap = 0;
+}
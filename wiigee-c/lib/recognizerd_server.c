@@ -0,0 +1,418 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "recognizerd.h"
+#include "recognizerd_server.h"
+#include "util.h"
+
+struct stream {
+    uint32_t id;
+    struct session *session;
+    int in_segment;
+    int held;                   // Samples went in since the last END
+    int64_t last_t;
+};
+
+typedef struct recognizerd_client {
+    struct recognizerd_server *server;
+    int fd;                     // Non-blocking
+    struct recognizerd_reader in;
+    int resume;                 // Samples of the first frame held already pushed
+    int stalled;                // That frame didn't fit in its session's ring
+    int hung_up;                // Read to the end; dropped once all is answered
+    pthread_mutex_t lock;       // Workers queue results concurrently
+    struct recognizerd_writer out;  // Under the lock
+    int broken;                 // Writing failed; under the lock
+    struct stream *streams;
+    int n_streams;
+    int cap;
+} recognizerd_client;
+
+static int by_probability(const void *a, const void *b)
+{
+    const struct recognizerd_score *x = a, *y = b;
+    return (x->probability < y->probability) - (x->probability > y->probability);
+}
+
+static void wake(struct recognizerd_server *this)
+{
+    if (write(this->wake[1], "", 1) < 0)
+        return;     // The pipe is full, so the poll wakes up anyway
+}
+
+/*
+ * Queues a frame for the client and writes what the socket takes right
+ * away.  Nothing here waits for the client: the rest goes out from the
+ * poll loop, which is woken to watch for the socket taking more.  A
+ * client that went away is noticed, and dropped, there too.
+ */
+static void reply(struct recognizerd_client *client, int type, uint32_t id, const void *payload, uint32_t length)
+{
+    pthread_mutex_lock(&client->lock);
+    recognizerd_queue(&client->out, type, id, payload, length);
+    int left = client->broken ? -1 : recognizerd_flush(&client->out, client->fd);
+    client->broken = left < 0;
+    pthread_mutex_unlock(&client->lock);
+
+    if (left)
+        wake(client->server);
+}
+
+// Session callback, on a worker thread: send the ranked scores back
+static void deliver(struct session *session, const struct session_result *r, void *ctx)
+{
+    struct recognizerd_client *client = ctx;
+    struct modelbank *bank = client->server->bank;
+    int n = r->probabilities ? bank->n_models : 0;
+    size_t length = sizeof(struct recognizerd_result) + n * sizeof(struct recognizerd_score);
+    struct recognizerd_result *frame = xalloc(length);
+
+    struct recognizerd_score *scores = (struct recognizerd_score *)(frame + 1);
+    frame->samples = r->samples;
+    frame->n_scores = n;
+    for (int m = 0; m < n; m++)
+        scores[m] = (struct recognizerd_score){ bank->models[m]->id, 0, r->probabilities[m] };
+    qsort(scores, n, sizeof(struct recognizerd_score), by_probability);
+
+    int type = r->kind == SESSION_FINAL ? RECOGNIZERD_RESULT
+        : r->kind == SESSION_COMMITTED ? RECOGNIZERD_COMMIT : RECOGNIZERD_PROVISIONAL;
+    reply(client, type, session->id, frame, length);
+    free(frame);
+}
+
+static void reply_error(struct recognizerd_client *client, uint32_t id)
+{
+    reply(client, RECOGNIZERD_ERROR, id, NULL, 0);
+}
+
+static struct stream *find_stream(struct recognizerd_client *client, uint32_t id)
+{
+    for (int i = 0; i < client->n_streams; i++)
+        if (client->streams[i].id == id)
+            return &client->streams[i];
+    return NULL;
+}
+
+// Nonzero if the ring is full: the workers are behind on this session
+static int push(struct stream *stream, int type, int buttons, int64_t t, int x, int y, int z)
+{
+    struct ring_event e = { t, type, buttons, x, y, z };
+
+    return session_push(stream->session, &e);
+}
+
+static void open_stream(struct recognizerd_client *client, uint32_t id)
+{
+    struct recognizerd_server *server = client->server;
+
+    if (find_stream(client, id)) {
+        reply_error(client, id);
+        return;
+    }
+    if (client->n_streams == client->cap) {
+        client->cap = client->cap ? 2 * client->cap : 4;
+        client->streams = xrealloc(client->streams, sizeof(struct stream) * client->cap);
+    }
+
+    struct stream *stream = &client->streams[client->n_streams++];
+    stream->id = id;
+    stream->in_segment = 0;
+    stream->held = 0;
+    stream->last_t = 0;
+    stream->session = session_new(id, server->bank, server->period, RECOGNIZERD_RING, deliver, client);
+    session_anytime(stream->session, server->cadence, server->margin, RECOGNIZERD_COMMIT_MIN);
+    if (server->by_motion)
+        session_endpoint(stream->session, NULL);
+    session_pool_add(server->pool, stream->session);
+}
+
+/*
+ * Whatever is still in the stream's ring gets processed before it goes,
+ * so an END right before the CLOSE (or the hangup) still gets its result.
+ */
+static void close_stream(struct recognizerd_client *client, struct stream *stream)
+{
+    session_pool_remove(client->server->pool, stream->session);
+    session_process(stream->session);
+    session_free(stream->session);
+    *stream = client->streams[--client->n_streams];
+}
+
+/*
+ * A segment without samples still gets its (empty) result.  Segmenting by
+ * motion, the release only ends the stream: any gesture in progress is
+ * delivered, and there may have been any number before.
+ */
+static int end_segment(struct recognizerd_client *client, struct stream *stream)
+{
+    if (!stream->in_segment && !client->server->by_motion) {
+        if (push(stream, RING_BUTTON, SESSION_TRIGGER, stream->last_t, 0, 0, 0))
+            return 1;
+        stream->in_segment = 1;
+    }
+    if (push(stream, RING_BUTTON, 0, stream->last_t, 0, 0, 0))
+        return 1;
+    stream->in_segment = 0;
+    stream->held = 0;
+    client->server->segments++;
+    return 0;
+}
+
+/*
+ * Pushes the frame's samples from client->resume on.  Returns nonzero if
+ * the ring filled up first; client->resume is where to pick up again.
+ * Times only go forwards, and not by more than RECOGNIZERD_MAX_GAP
+ * periods within a segment: a longer gap (a stalled client, or a bad
+ * time) ends the segment there, rather than have the session resample
+ * all of it.
+ */
+static int samples(struct recognizerd_client *client, struct stream *stream, const struct recognizerd_frame *frame)
+{
+    int by_motion = client->server->by_motion;
+    uint64_t max_gap = RECOGNIZERD_MAX_GAP * (uint64_t)client->server->period;
+    const char *p = frame->payload;
+    int n = frame->header.length / sizeof(struct recognizerd_sample);
+
+    for (; client->resume < n; client->resume++) {
+        struct recognizerd_sample s;
+
+        memcpy(&s, p + client->resume * sizeof(s), sizeof(s));
+        if (s.t < stream->last_t)
+            s.t = stream->last_t;
+        if (stream->held && (uint64_t)s.t - (uint64_t)stream->last_t > max_gap && end_segment(client, stream))
+            return 1;
+        if (!stream->in_segment && !by_motion) {
+            if (push(stream, RING_BUTTON, SESSION_TRIGGER, s.t, 0, 0, 0))
+                return 1;
+            stream->in_segment = 1;
+        }
+        if (push(stream, RING_ACC, SESSION_TRIGGER, s.t, s.x, s.y, s.z))
+            return 1;
+        stream->held = 1;
+        stream->last_t = s.t;
+        client->server->samples++;
+    }
+    return 0;
+}
+
+// Nonzero if the frame didn't fit in its session's ring (yet)
+static int handle(struct recognizerd_client *client, const struct recognizerd_frame *frame)
+{
+    uint32_t id = frame->header.session;
+    struct stream *stream = find_stream(client, id);
+
+    switch (frame->header.type) {
+    case RECOGNIZERD_OPEN:
+        open_stream(client, id);
+        return 0;
+    case RECOGNIZERD_SAMPLES:
+        if (stream && frame->header.length % sizeof(struct recognizerd_sample) == 0)
+            return samples(client, stream, frame);
+        break;
+    case RECOGNIZERD_END:
+        if (stream)
+            return end_segment(client, stream);
+        break;
+    case RECOGNIZERD_CLOSE:
+        if (stream) {
+            close_stream(client, stream);
+            return 0;
+        }
+        break;
+    }
+    reply_error(client, id);
+    return 0;
+}
+
+static void add_client(struct recognizerd_server *this, int fd)
+{
+    struct recognizerd_client *client = xalloc(sizeof(struct recognizerd_client));
+
+    this->clients = xrealloc(this->clients, sizeof(struct recognizerd_client *) * (this->n_clients + 1));
+    client->server = this;
+    client->fd = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&client->lock, NULL);
+    this->clients[this->n_clients++] = client;
+}
+
+static void drop_client(struct recognizerd_server *this, int i)
+{
+    struct recognizerd_client *client = this->clients[i];
+
+    while (client->n_streams)
+        close_stream(client, &client->streams[0]);
+
+    // The workers are done with it; whatever still fits goes out
+    recognizerd_flush(&client->out, client->fd);
+    close(client->fd);
+    pthread_mutex_destroy(&client->lock);
+    recognizerd_reader_free(&client->in);
+    recognizerd_writer_free(&client->out);
+    free(client->streams);
+    free(client);
+    this->clients[i] = this->clients[--this->n_clients];
+}
+
+/*
+ * Handles the frames held, as far as the sessions' rings take them.  A
+ * frame that doesn't fit stays held, and the client isn't read from until
+ * it does; other clients carry on.  Returns 0, or -1 if the client is
+ * talking nonsense.
+ */
+static int parse(struct recognizerd_client *client)
+{
+    struct recognizerd_frame frame;
+    int more;
+
+    while ((more = recognizerd_peek(&client->in, &frame)) > 0) {
+        if ((client->stalled = handle(client, &frame)))
+            return 0;
+        recognizerd_next(&client->in, &frame);
+        client->resume = 0;
+    }
+    return more;
+}
+
+// Whatever the client sent; 0, or -1 if it's broken or talking nonsense
+static int serve(struct recognizerd_client *client)
+{
+    int n = recognizerd_fill(&client->in, client->fd);
+
+    if (n == 0)
+        client->hung_up = 1;
+    else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        return -1;
+    return parse(client);
+}
+
+/*
+ * Everything to do for a client after a poll.  Returns nonzero when it's
+ * time to drop it: it's broken, or hung up and has had all its answers.
+ */
+static int tend(struct recognizerd_client *client, short revents)
+{
+    if (revents & (POLLERR | POLLNVAL))
+        return 1;
+    if (client->stalled && parse(client))
+        return 1;
+    if ((revents & (POLLIN | POLLHUP)) && !client->stalled && !client->hung_up && serve(client))
+        return 1;
+
+    // Done reading: what's left in the rings is answered before it goes
+    int done = client->hung_up && !client->stalled;
+    while (done && client->n_streams)
+        close_stream(client, &client->streams[0]);
+
+    pthread_mutex_lock(&client->lock);
+    int left = client->broken ? -1 : recognizerd_flush(&client->out, client->fd);
+    client->broken = left < 0;
+    pthread_mutex_unlock(&client->lock);
+    return left < 0 || (done && left == 0);
+}
+
+// A server for the bank, taking over the listening socket
+struct recognizerd_server *recognizerd_server_new(struct modelbank *bank, int listener, int threads)
+{
+    struct recognizerd_server *this = xalloc(sizeof(struct recognizerd_server));
+
+    this->bank = bank;
+    this->listener = listener;
+    this->period = 100000000;
+    if (pipe(this->wake))
+        die("recognizerd_server_new: can't make a pipe\n");
+    fcntl(this->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(this->wake[1], F_SETFL, O_NONBLOCK);
+    this->pool = session_pool_new(threads);
+    return this;
+}
+
+// Hangs up on every client, after processing what they sent
+void recognizerd_server_free(struct recognizerd_server *this)
+{
+    while (this->n_clients)
+        drop_client(this, this->n_clients - 1);
+    session_pool_free(this->pool);
+    close(this->listener);
+    close(this->wake[0]);
+    close(this->wake[1]);
+    free(this->clients);
+    free(this);
+}
+
+/*
+ * Serves clients until recognizerd_server_stop().  Returns 0, or -1 if
+ * polling failed.
+ */
+int recognizerd_server_run(struct recognizerd_server *this)
+{
+    struct pollfd *fds = NULL;
+    int status = 0;
+
+    while (!__atomic_load_n(&this->stopping, __ATOMIC_ACQUIRE)) {
+        int stalled = 0;
+
+        fds = xrealloc(fds, sizeof(struct pollfd) * (this->n_clients + 2));
+        fds[0] = (struct pollfd){ this->wake[0], POLLIN, 0 };
+        fds[1] = (struct pollfd){ this->listener, POLLIN, 0 };
+        for (int i = 0; i < this->n_clients; i++) {
+            struct recognizerd_client *client = this->clients[i];
+            short events = 0;
+
+            pthread_mutex_lock(&client->lock);
+            size_t queued = client->out.len - client->out.pos;
+            pthread_mutex_unlock(&client->lock);
+
+            // One not reading its answers isn't read from either
+            if (queued)
+                events |= POLLOUT;
+            if (!client->stalled && !client->hung_up && queued < RECOGNIZERD_BACKLOG)
+                events |= POLLIN;
+            stalled |= client->stalled;
+            fds[i+2] = (struct pollfd){ client->fd, events, 0 };
+        }
+
+        // Nothing says when a ring has room again, so look every millisecond
+        if (poll(fds, this->n_clients + 2, stalled ? 1 : -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            status = -1;
+            break;
+        }
+
+        // Back to front, so dropping a client doesn't move one not yet seen
+        for (int i = this->n_clients - 1; i >= 0; i--)
+            if (tend(this->clients[i], fds[i+2].revents))
+                drop_client(this, i);
+
+        if (fds[1].revents & POLLIN) {
+            int fd = accept(this->listener, NULL, NULL);
+            if (fd >= 0)
+                add_client(this, fd);
+        }
+
+        char drained[64];
+        if (fds[0].revents & POLLIN)
+            while (read(this->wake[0], drained, sizeof(drained)) > 0)
+                ;
+    }
+
+    free(fds);
+    return status;
+}
+
+// Makes recognizerd_server_run() return; safe in a signal handler
+void recognizerd_server_stop(struct recognizerd_server *this)
+{
+    __atomic_store_n(&this->stopping, 1, __ATOMIC_RELEASE);
+    wake(this);
+}
@@ -0,0 +1,178 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // clock_nanosleep
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "replay.h"
+#include "capture.h"
+#include "wmdump.h"
+#include "util.h"
+
+struct loader {
+    struct replay *replay;
+    int64_t end;                // Timeline time of the last report so far, ns
+    int64_t last;               // Its recorded time, us
+    const char *user;           // The recording it came from
+    int hand;
+};
+
+static void add(struct replay *this, int64_t t, int type, int buttons, int x, int y, int z)
+{
+    if (this->n_reports == this->cap) {
+        this->cap = MAX(2 * this->cap, 1024);
+        this->reports = xrealloc(this->reports, sizeof(struct ring_event) * this->cap);
+    }
+    this->reports[this->n_reports++] = (struct ring_event){ t, type, buttons, x, y, z, 0 };
+}
+
+// One gesture: press, reports at their recorded times (in us), release
+static void add_gesture(struct loader *l, const uint8_t *x, const uint8_t *y, const uint8_t *z,
+                        const int64_t *t, int n, const char *user, int hand)
+{
+    struct replay *this = l->replay;
+    int64_t start = 0;
+
+    if (n < 1)
+        return;
+
+    if (this->n_gestures > 0) {
+        int64_t gap = (t[0] - l->last) * 1000;
+        if (user != l->user || hand != l->hand || gap < 0 || gap > REPLAY_MAX_GAP)
+            gap = REPLAY_GAP;
+        start = l->end + gap;
+    }
+
+    int64_t at = start;
+    add(this, at, RING_BUTTON, 0x0004, 0, 0, 0);
+    for (int i = 0; i < n; i++) {
+        at = MAX(at, start + (t[i] - t[0]) * 1000);
+        add(this, at, RING_ACC, 0x0004, x[i], y[i], z[i]);
+    }
+    add(this, at, RING_BUTTON, 0, 0, 0, 0);
+
+    this->n_gestures++;
+    l->end = at;
+    l->last = t[n-1];
+    l->user = user;
+    l->hand = hand;
+}
+
+static int add_segment(void *arg, const struct wmdump_segment *segment)
+{
+    struct loader *l = arg;
+    add_gesture(l, segment->x, segment->y, segment->z, segment->t, segment->data_len, NULL, 0);
+    return 0;
+}
+
+static int load_capture(struct loader *l, const char *path)
+{
+    struct capture *capture = capture_open(path);
+    struct capture_view view;
+
+    if (!capture)
+        return -1;
+
+    for (int i = 0; i < capture_count(capture); i++) {
+        capture_get(capture, i, &view);
+
+        int64_t *t = xalloc(sizeof(int64_t) * MAX(view.data_len, 1));
+        capture_timestamps(&view, t);
+        // Capture strings are stored once, so one user is one pointer
+        add_gesture(l, view.x, view.y, view.z, t, view.data_len, view.user, view.hand);
+        free(t);
+    }
+
+    capture_close(capture);
+    return 0;
+}
+
+/*
+ * The gestures of a binary capture file (see capture.h) or of a wmdump
+ * text log, whichever path is; NULL if it can't be read.
+ */
+struct replay *replay_load(const char *path)
+{
+    struct replay *this = xalloc(sizeof(struct replay));
+    struct loader l = { this, 0, 0, NULL, 0 };
+    char magic[4] = { 0 };
+    FILE *f;
+    int failed;
+
+    if (!(f = fopen(path, "rb"))) {
+        free(this);
+        return NULL;
+    }
+    failed = fread(magic, 1, 4, f) != 4 && ferror(f);
+    fclose(f);
+
+    if (!failed) {
+        if (!memcmp(magic, CAPTURE_MAGIC, 4))
+            failed = load_capture(&l, path);
+        else
+            failed = wmdump_parse(path, add_segment, &l) < 0;
+    }
+
+    if (failed) {
+        replay_free(this);
+        return NULL;
+    }
+    replay_start(this, 1);
+    return this;
+}
+
+void replay_free(struct replay *this)
+{
+    free(this->reports);
+    free(this);
+}
+
+// (Re)starts the replay from its first report, now, at the given speed
+void replay_start(struct replay *this, double speed)
+{
+    this->speed = speed;
+    this->started = ring_now();
+    this->next = 0;
+    this->late = 0;
+}
+
+/*
+ * Waits until the next report is due, then returns it and every other one
+ * recorded at the same time (a wiimote delivers those together), up to
+ * max; 0 when the replay is over.
+ */
+int replay_next(struct replay *this, struct ring_event *reports, int max)
+{
+    if (this->next >= this->n_reports)
+        return 0;
+
+    int64_t due = this->reports[this->next].t;
+
+    if (this->speed > 0) {
+        int64_t target = this->started + (int64_t)(due / this->speed);
+        int64_t now = ring_now();
+
+        if (now < target) {
+            struct timespec ts = { target / 1000000000, target % 1000000000 };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+                ;
+        } else {
+            this->late = MAX(this->late, now - target);
+        }
+    }
+
+    int n = 0;
+    while (n < max && this->next < this->n_reports && this->reports[this->next].t == due)
+        reports[n++] = this->reports[this->next++];
+    return n;
+}
+
+// Length of the replay's timeline at speed 1, ns
+int64_t replay_duration(struct replay *this)
+{
+    return this->n_reports ? this->reports[this->n_reports - 1].t : 0;
+}
@@ -0,0 +1,129 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <assert.h>
+
+#include "resampler.h"
+
+/*
+ * Sets up a resampler emitting one sample per period into the cap entries
+ * of out, with frac_bits fractional bits (0 for plain truncated means).
+ * Nothing is allocated; the caller owns both structures.
+ */
+void resampler_init(struct resampler *this, int64_t period, int frac_bits,
+                    struct resampler_sample *out, int cap)
+{
+    assert(period > 0 && frac_bits >= 0 && frac_bits < 24);
+
+    this->period    = period;
+    this->frac_bits = frac_bits;
+    this->out       = out;
+    this->out_cap   = cap;
+    resampler_reset(this);
+}
+
+// Start a new stream, overwriting the buffer from the beginning
+void resampler_reset(struct resampler *this)
+{
+    this->ax = this->ay = this->az = this->at = 0;
+    this->start     = 0;
+    this->have_last = 0;
+    this->out_len   = 0;
+    this->overflow  = 0;
+}
+
+// The samples in the buffer have been used: let the next ones overwrite them
+void resampler_consume(struct resampler *this)
+{
+    this->out_len = 0;
+}
+
+static void emit(struct resampler *this)
+{
+    if (this->out_len == this->out_cap) {
+        this->overflow++;
+    } else {
+        struct resampler_sample *s = &this->out[this->out_len++];
+        int64_t one = (int64_t)1 << this->frac_bits;   // values may be negative: scale, don't shift
+
+        s->x = this->ax * one / this->period;
+        s->y = this->ay * one / this->period;
+        s->z = this->az * one / this->period;
+        s->t = this->start;
+    }
+
+    this->ax = this->ay = this->az = this->at = 0;
+    this->start += this->period;
+}
+
+/*
+ * Hold the latest report for dt, closing every period that fills up.  Once
+ * out is full, the whole periods left are only counted as lost, all at
+ * once: a long gap costs no more than out has room for.
+ */
+static void hold(struct resampler *this, int64_t dt)
+{
+    int64_t missing = this->period - this->at;
+
+    // A report exactly filling a period closes it on the next report (or
+    // at the end), not now, as downsample_acc_stream() did
+    while (missing < dt) {
+        this->ax += this->lx * missing;
+        this->ay += this->ly * missing;
+        this->az += this->lz * missing;
+        this->at += missing;
+        dt -= missing;
+        emit(this);
+        missing = this->period;
+
+        if (this->out_len == this->out_cap && dt > this->period) {
+            int64_t skipped = (dt - 1) / this->period;
+
+            this->overflow += skipped;
+            this->start += skipped * this->period;
+            dt -= skipped * this->period;
+        }
+    }
+
+    this->ax += this->lx * dt;
+    this->ay += this->ly * dt;
+    this->az += this->lz * dt;
+    this->at += dt;
+}
+
+/*
+ * Takes a report made at time t and returns how many samples that
+ * completed; they are at the end of out.  A report earlier than the
+ * previous one is taken as made at the same time.
+ */
+int resampler_push(struct resampler *this, int x, int y, int z, int64_t t)
+{
+    int before = this->out_len;
+
+    if (this->have_last) {
+        if (t < this->lt)
+            t = this->lt;
+        hold(this, t - this->lt);
+    } else {
+        this->start = t;
+        this->have_last = 1;
+    }
+
+    this->lx = x;
+    this->ly = y;
+    this->lz = z;
+    this->lt = t;
+    return this->out_len - before;
+}
+
+// Ends the stream: the last report fills out the final period
+int resampler_finish(struct resampler *this)
+{
+    if (!this->have_last)
+        return 0;
+
+    int before = this->out_len;
+    hold(this, this->period - this->at);
+    emit(this);
+    this->have_last = 0;
+    return this->out_len - before;
+}
@@ -0,0 +1,114 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // clock_gettime, nanosleep
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring.h"
+#include "util.h"
+
+// A ring holding at least capacity events
+struct ring *ring_new(size_t capacity)
+{
+    struct ring *this = xalloc(sizeof(struct ring));
+    size_t size = 2;
+
+    while (size < capacity)
+        size *= 2;
+
+    this->slots = xalloc(sizeof(struct ring_event) * size);
+    this->mask = size - 1;
+    return this;
+}
+
+void ring_free(struct ring *this)
+{
+    free(this->slots);
+    free(this);
+}
+
+/*
+ * Producer side.  Returns 0, or -1 if the ring is full, in which case the
+ * event is dropped (and counted) rather than blocking the caller.
+ */
+int ring_push(struct ring *this, const struct ring_event *event)
+{
+    size_t head = this->head;
+
+    // Only reload the consumer's index when the cached one says full
+    if (head - this->tail_seen > this->mask) {
+        this->tail_seen = __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE);
+        if (head - this->tail_seen > this->mask) {
+            __atomic_store_n(&this->dropped, this->dropped + 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    this->slots[head & this->mask] = *event;
+    __atomic_store_n(&this->head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * Consumer side.  Copies out up to max events, oldest first, and returns
+ * how many; 0 if the ring is empty.
+ */
+size_t ring_pop(struct ring *this, struct ring_event *events, size_t max)
+{
+    size_t tail = this->tail;
+
+    if (this->head_seen == tail)
+        this->head_seen = __atomic_load_n(&this->head, __ATOMIC_ACQUIRE);
+
+    size_t n = MIN(this->head_seen - tail, max);
+
+    for (size_t i = 0; i < n; i++)
+        events[i] = this->slots[(tail + i) & this->mask];
+
+    __atomic_store_n(&this->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/*
+ * ring_pop(), but if the ring is empty, poll it (backing off from 50us to
+ * 1ms between looks) for up to timeout nanoseconds, or forever if timeout
+ * is negative.  The producer never has to wake anybody up.
+ */
+size_t ring_pop_wait(struct ring *this, struct ring_event *events, size_t max, int64_t timeout)
+{
+    int64_t deadline = timeout < 0 ? INT64_MAX : ring_now() + timeout;
+    long pause = 50000;
+    size_t n;
+
+    while (!(n = ring_pop(this, events, max)) && ring_now() < deadline) {
+        struct timespec ts = { 0, pause };
+        nanosleep(&ts, NULL);
+        pause = MIN(2 * pause, 1000000);
+    }
+    return n;
+}
+
+/*
+ * How many events are waiting.  Safe from any thread, but only a hint
+ * from anywhere but the consumer: more may arrive at any moment.
+ */
+size_t ring_pending(struct ring *this)
+{
+    size_t tail = __atomic_load_n(&this->tail, __ATOMIC_ACQUIRE);
+    return __atomic_load_n(&this->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+unsigned long ring_dropped(struct ring *this)
+{
+    return __atomic_load_n(&this->dropped, __ATOMIC_RELAXED);
+}
+
+// The clock ring events are stamped with: monotonic, in nanoseconds
+int64_t ring_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
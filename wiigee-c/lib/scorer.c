@@ -0,0 +1,111 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "scorer.h"
+#include "util.h"
+
+struct scorer *scorer_new(struct gesturemodel **models, int n_models)
+{
+    struct scorer *this = xalloc(sizeof(struct scorer));
+
+    this->n_models = n_models;
+    this->models = models;
+
+    for (int m = 0; m < n_models; m++)
+        this->max_states = MAX(this->max_states, (int)models[m]->hmm->numStates);
+
+    this->alpha   = xalloc(sizeof(double) * n_models * this->max_states);
+    this->scratch = xalloc(sizeof(double) * this->max_states * 2);
+    this->last    = xalloc(sizeof(int) * n_models);
+    this->leader  = xalloc(sizeof(int) * n_models);
+
+    for (int m = 0; m < n_models; m++) {
+        int k = 0;
+        while (!quantizer_same(models[k]->quantizer, models[m]->quantizer))
+            k++;
+        this->leader[m] = k;
+        if (k == m)
+            this->n_codebooks++;
+    }
+    return this;
+}
+
+void scorer_free(struct scorer *this)
+{
+    free(this->alpha);
+    free(this->scratch);
+    free(this->last);
+    free(this->leader);
+    free(this);
+}
+
+// Start over with a new gesture
+void scorer_reset(struct scorer *this)
+{
+    this->length = 0;
+}
+
+void scorer_push(struct scorer *this, double x, double y, double z)
+{
+    for (int m = 0; m < this->n_models; m++) {
+        struct gesturemodel *model = this->models[m];
+        double *alpha = &this->alpha[m * this->max_states];
+        int symbol;
+
+        // Leaders come first, so theirs is already this sample's symbol
+        if (this->leader[m] == m)
+            symbol = quantizer_symbol(model->quantizer, x, y, z);
+        else
+            symbol = this->last[ this->leader[m] ];
+
+        if (this->length == 0) {
+            forwardInit(model->hmm, alpha, symbol);
+        } else {
+            forwardStep(model->hmm, alpha, this->scratch, symbol);
+            memcpy(alpha, this->scratch, sizeof(double) * model->hmm->numStates);
+        }
+        this->last[m] = symbol;
+    }
+
+    this->length++;
+}
+
+void scorer_push_gesture(struct scorer *this, struct gesture *gesture)
+{
+    for (int j = 0; j < gesture->data_len; j++)
+        scorer_push(this, gesture->data[j].x, gesture->data[j].y, gesture->data[j].z);
+}
+
+/*
+ * P(gesture so far | model) for every model, written to out[n_models].
+ * Sequences shorter than a quantizer's `states` are padded with their last
+ * symbol, as quantizer_getObservationSequence() does, so the result equals
+ * matches() on the same samples.  Does not disturb the running state, so
+ * more samples can still be pushed afterwards.
+ */
+void scorer_probabilities(struct scorer *this, double *out)
+{
+    for (int m = 0; m < this->n_models; m++) {
+        struct gesturemodel *model = this->models[m];
+        double *alpha = &this->alpha[m * this->max_states];
+
+        if (this->length == 0) {
+            out[m] = 0.0;
+            continue;
+        }
+
+        double *cur  = this->scratch;
+        double *next = this->scratch + this->max_states;
+        memcpy(cur, alpha, sizeof(double) * model->hmm->numStates);
+
+        for (int t = this->length; t < model->quantizer->states; t++) {
+            double *tmp;
+            forwardStep(model->hmm, cur, next, this->last[m]);
+            tmp = cur; cur = next; next = tmp;
+        }
+
+        out[m] = forwardSum(model->hmm, cur);
+    }
+}
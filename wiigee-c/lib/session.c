@@ -0,0 +1,324 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // nanosleep
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "session.h"
+#include "classifier.h"
+#include "util.h"
+
+/*
+ * A session for one device, recognizing against bank's models.  Reports
+ * are resampled to one per period (in ring_now() units, nanoseconds), and
+ * up to capacity of them may wait in the input ring.
+ */
+struct session *session_new(int id, struct modelbank *bank, int64_t period, size_t capacity,
+                            session_callback callback, void *ctx)
+{
+    struct session *this = xalloc(sizeof(struct session));
+
+    this->id       = id;
+    this->bank     = bank;
+    this->input    = ring_new(capacity);
+    this->scorer   = scorer_new(bank->models, bank->n_models);
+    this->matches  = xalloc(sizeof(double) * MAX(bank->n_models, 1));
+    this->callback = callback;
+    this->ctx      = ctx;
+    resampler_init(&this->resampler, period, 0, this->resampled, SESSION_BATCH);
+    return this;
+}
+
+void session_free(struct session *this)
+{
+    ring_free(this->input);
+    scorer_free(this->scorer);
+    free(this->matches);
+    free(this->endpoint);
+    free(this);
+}
+
+/*
+ * While the trigger is held, deliver a provisional result every cadence
+ * (in report time, so a replay gives the same ones at any speed; 0 for
+ * none), and commit early once the leading model's posterior is margin
+ * ahead of the runner-up's on at least min_samples samples (margin 0 for
+ * never).  Set before the session is processed.
+ */
+void session_anytime(struct session *this, int64_t cadence, double margin, int min_samples)
+{
+    this->cadence       = cadence;
+    this->commit_margin = margin;
+    this->commit_min    = MAX(min_samples, 1);
+}
+
+/*
+ * Find gestures by motion, with config's settings (NULL for the defaults),
+ * instead of following the trigger.  Set before the session is processed.
+ */
+void session_endpoint(struct session *this, const struct endpoint *config)
+{
+    if (!this->endpoint)
+        this->endpoint = xalloc(sizeof(struct endpoint));
+
+    if (config)
+        *this->endpoint = *config;
+    else
+        endpoint_init(this->endpoint);
+    endpoint_reset(this->endpoint);
+}
+
+// Producer side, see ring_push(): never blocks, drops the report if full
+int session_push(struct session *this, const struct ring_event *event)
+{
+    return ring_push(this->input, event);
+}
+
+// Score the samples the resampler just completed
+static void feed(struct session *this)
+{
+    for (int i = 0; i < this->resampler.out_len; i++) {
+        struct resampler_sample *s = &this->resampled[i];
+        scorer_push(this->scorer, s->x, s->y, s->z);
+    }
+    resampler_consume(&this->resampler);
+}
+
+// Rank the models on the samples so far; the scorer can keep going after
+static void decide(struct session *this, struct session_result *result)
+{
+    result->samples = this->scorer->length;
+    if (result->samples == 0 || this->bank->n_models == 0)
+        return;
+
+    scorer_probabilities(this->scorer, this->matches);
+    result->model = classifier_decide(this->bank->models, this->bank->n_models, this->matches, this->matches);
+    if (result->model < 0)
+        return;
+
+    double second = 0;
+    for (int m = 0; m < this->bank->n_models; m++)
+        if (m != result->model)
+            second = MAX(second, this->matches[m]);
+
+    result->id = this->bank->models[result->model]->id;
+    result->probability = this->matches[result->model];
+    result->margin = result->probability - second;
+    result->probabilities = this->matches;
+}
+
+static void deliver(struct session *this, struct session_result *result)
+{
+    if (this->callback)
+        this->callback(this, result, this->ctx);
+}
+
+static void provisional(struct session *this, int64_t t)
+{
+    struct session_result result = { SESSION_PROVISIONAL, -1, -1, 0, 0, NULL, 0, this->pressed_at, t };
+
+    this->next_provisional = t + this->cadence;
+    decide(this, &result);
+
+    if (!this->committed && this->commit_margin > 0 && result.model >= 0
+        && result.samples >= this->commit_min && result.margin >= this->commit_margin) {
+        result.kind = SESSION_COMMITTED;
+        this->committed = 1;
+    } else if (this->cadence == 0) {
+        return;     // Only watching for the commit
+    }
+    deliver(this, &result);
+}
+
+static void finish(struct session *this, int64_t released_at)
+{
+    struct session_result result = { SESSION_FINAL, -1, -1, 0, 0, NULL, 0, this->pressed_at, released_at };
+
+    resampler_finish(&this->resampler);
+    feed(this);
+    decide(this, &result);
+
+    this->gestures++;
+    deliver(this, &result);
+}
+
+static void dispatch(struct session *this, const struct ring_event *e)
+{
+    if (e->type == RING_BUTTON) {
+        int was = this->buttons & SESSION_TRIGGER;
+        int is = e->buttons & SESSION_TRIGGER;
+
+        this->buttons = e->buttons;
+        if (is && !was) {
+            resampler_reset(&this->resampler);
+            scorer_reset(this->scorer);
+            this->pressed_at = e->t;
+            this->next_provisional = e->t + this->cadence;
+            this->committed = 0;
+        } else if (was && !is) {
+            finish(this, e->t);
+        }
+    } else if (e->type == RING_ACC && (this->buttons & SESSION_TRIGGER)) {
+        if (resampler_push(&this->resampler, e->x, e->y, e->z, e->t)) {
+            feed(this);
+            if ((this->cadence > 0 || this->commit_margin > 0) && !this->committed && e->t >= this->next_provisional)
+                provisional(this, e->t);
+        }
+    }
+}
+
+// Between the ring and dispatch(), the endpointer stands in for the trigger
+static void handle(struct session *this, const struct ring_event *e)
+{
+    struct ring_event out[ENDPOINT_MAX_OUT];
+    int n;
+
+    if (!this->endpoint) {
+        dispatch(this, e);
+        return;
+    }
+
+    if (e->type == RING_ACC)
+        n = endpoint_push(this->endpoint, e, out);
+    else if (e->type == RING_BUTTON)
+        n = endpoint_flush(this->endpoint, out);
+    else
+        return;
+
+    for (int i = 0; i < n; i++)
+        dispatch(this, &out[i]);
+}
+
+/*
+ * Consumer side: handles every report waiting in the ring, delivering a
+ * result for each gesture completed, and returns how many there were.
+ * Only one thread at a time may process a given session.
+ */
+size_t session_process(struct session *this)
+{
+    struct ring_event events[SESSION_BATCH];
+    size_t total = 0, n;
+
+    while ((n = ring_pop(this->input, events, SESSION_BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++)
+            handle(this, &events[i]);
+        total += n;
+    }
+    return total;
+}
+
+// Claim the next idle session with reports waiting, under the lock
+static struct session *claim(struct session_pool *this)
+{
+    for (int i = 0; i < this->n_sessions; i++) {
+        int k = (this->next + i) % this->n_sessions;
+        struct session *s = this->sessions[k];
+
+        if (!s->busy && ring_pending(s->input)) {
+            s->busy = 1;
+            this->next = k + 1;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Producers don't signal anybody, so an idle worker polls, backing off
+ * from 50us to 1ms like ring_pop_wait().
+ */
+static void *worker(void *arg)
+{
+    struct session_pool *this = arg;
+    long pause = 50000;
+
+    pthread_mutex_lock(&this->lock);
+    while (!this->stop) {
+        struct session *s = claim(this);
+
+        pthread_mutex_unlock(&this->lock);
+        if (s) {
+            session_process(s);
+            pause = 50000;
+        } else {
+            struct timespec ts = { 0, pause };
+            nanosleep(&ts, NULL);
+            pause = MIN(2 * pause, 1000000);
+        }
+        pthread_mutex_lock(&this->lock);
+
+        if (s) {
+            s->busy = 0;
+            pthread_cond_broadcast(&this->released);
+        }
+    }
+    pthread_mutex_unlock(&this->lock);
+    return NULL;
+}
+
+struct session_pool *session_pool_new(int threads)
+{
+    struct session_pool *this = xalloc(sizeof(struct session_pool));
+
+    this->n_threads = MAX(threads, 1);
+    this->threads = xalloc(sizeof(pthread_t) * this->n_threads);
+    pthread_mutex_init(&this->lock, NULL);
+    pthread_cond_init(&this->released, NULL);
+
+    for (int i = 0; i < this->n_threads; i++)
+        if (pthread_create(&this->threads[i], NULL, worker, this))
+            die("session_pool_new: can't start worker %d\n", i);
+    return this;
+}
+
+// Stops the workers; the sessions are left to their owners
+void session_pool_free(struct session_pool *this)
+{
+    pthread_mutex_lock(&this->lock);
+    this->stop = 1;
+    pthread_mutex_unlock(&this->lock);
+
+    for (int i = 0; i < this->n_threads; i++)
+        pthread_join(this->threads[i], NULL);
+
+    pthread_cond_destroy(&this->released);
+    pthread_mutex_destroy(&this->lock);
+    free(this->sessions);
+    free(this->threads);
+    free(this);
+}
+
+void session_pool_add(struct session_pool *this, struct session *session)
+{
+    pthread_mutex_lock(&this->lock);
+    if (this->n_sessions == this->cap) {
+        this->cap = MAX(2 * this->cap, 8);
+        this->sessions = xrealloc(this->sessions, sizeof(struct session *) * this->cap);
+    }
+    this->sessions[this->n_sessions++] = session;
+    pthread_mutex_unlock(&this->lock);
+}
+
+/*
+ * Takes a session out of the pool, waiting for a worker that's processing
+ * it to finish; afterwards the caller may process or free it.  Reports
+ * still in its ring stay there.
+ */
+void session_pool_remove(struct session_pool *this, struct session *session)
+{
+    pthread_mutex_lock(&this->lock);
+    while (session->busy)
+        pthread_cond_wait(&this->released, &this->lock);
+
+    for (int i = 0; i < this->n_sessions; i++) {
+        if (this->sessions[i] == session) {
+            memmove(&this->sessions[i], &this->sessions[i+1],
+                    sizeof(struct session *) * (this->n_sessions - i - 1));
+            this->n_sessions--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&this->lock);
+}
@@ -0,0 +1,379 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spotter.h"
+#include "util.h"
+
+static const struct spotter_token dead = { -INFINITY, 0, 0, -1 };
+
+static int alive(const struct spotter_token *token)
+{
+    return token->score > -INFINITY;
+}
+
+static double floored_log(double p)
+{
+    return log(MAX(p, SPOTTER_FLOOR));
+}
+
+// Log tables for each model, and the filler made of their states
+static void build_tables(struct spotter *this)
+{
+    for (int m = 0; m < this->n_models; m++) {
+        struct spotter_model *sm = &this->models[m];
+        HmmState *hmm = sm->model->hmm;
+
+        sm->leader = 0;
+        while (!quantizer_same(this->models[sm->leader].model->quantizer, sm->model->quantizer))
+            sm->leader++;
+
+        sm->states       = hmm->numStates;
+        sm->observations = hmm->numObservations;
+        sm->log_init     = xalloc(sizeof(double) * sm->states);
+        sm->log_change   = xalloc(sizeof(double) * sm->states * sm->states);
+        sm->log_emit     = xalloc(sizeof(double) * sm->states * sm->observations);
+
+        for (int j = 0; j < sm->states; j++) {
+            sm->log_init[j] = floored_log(getInitP(hmm, j));
+            for (int k = 0; k < sm->states; k++)
+                sm->log_change[k * sm->states + j] = floored_log(getChangeP(hmm, k, j));
+            for (int o = 0; o < sm->observations; o++)
+                sm->log_emit[j * sm->observations + o] = floored_log(getEmitP(hmm, j, o));
+        }
+        this->n_filler += sm->states;
+    }
+
+    this->filler_model = xalloc(sizeof(int) * MAX(this->n_filler, 1));
+    this->filler_state = xalloc(sizeof(int) * MAX(this->n_filler, 1));
+    this->filler_stay  = xalloc(sizeof(double) * MAX(this->n_filler, 1));
+
+    for (int m = 0, f = 0; m < this->n_models; m++) {
+        for (int j = 0; j < this->models[m].states; j++, f++) {
+            this->filler_model[f] = m;
+            this->filler_state[f] = j;
+            this->filler_stay[f]  = floored_log(getChangeP(this->models[m].model->hmm, j, j));
+        }
+    }
+}
+
+/*
+ * A spotter for n_models models, calling back with every detection.  The
+ * parameters can be changed before the first sample.  The models must
+ * outlive the spotter, unchanged: their tables are copied now.
+ */
+struct spotter *spotter_new(struct gesturemodel **models, int n_models, spotter_callback callback, void *ctx)
+{
+    if (n_models < 1)
+        die("spotter_new: nothing to spot\n");
+
+    struct spotter *this = xalloc(sizeof(struct spotter));
+
+    this->penalty  = 3;
+    this->beam     = 30;
+    this->min_len  = 0;
+    this->max_len  = 100;
+    this->callback = callback;
+    this->ctx      = ctx;
+
+    this->n_models = n_models;
+    this->models = xalloc(sizeof(struct spotter_model) * n_models);
+    for (int m = 0; m < n_models; m++) {
+        this->models[m].model = models[m];
+        this->max_states = MAX(this->max_states, (int)models[m]->hmm->numStates);
+    }
+    build_tables(this);
+
+    this->n_tokens = n_models * this->max_states + this->n_filler;
+    this->tokens = xalloc(sizeof(struct spotter_token) * this->n_tokens);
+    this->next   = xalloc(sizeof(struct spotter_token) * this->n_tokens);
+
+    // After a traceback, the live records are a tree whose leaves are the
+    // tokens' and the hub's and whose other nodes branch; one more record
+    // may be made per sample
+    this->n_records = 2 * (this->n_tokens + 1) + 1;
+    this->records = xalloc(sizeof(struct spotter_record) * this->n_records);
+
+    spotter_reset(this);
+    return this;
+}
+
+void spotter_free(struct spotter *this)
+{
+    for (int m = 0; m < this->n_models; m++) {
+        free(this->models[m].log_init);
+        free(this->models[m].log_change);
+        free(this->models[m].log_emit);
+    }
+    free(this->models);
+    free(this->filler_model);
+    free(this->filler_state);
+    free(this->filler_stay);
+    free(this->tokens);
+    free(this->next);
+    free(this->records);
+    free(this);
+}
+
+// Start a new stream; whatever wasn't reported is forgotten
+void spotter_reset(struct spotter *this)
+{
+    for (int i = 0; i < this->n_tokens; i++)
+        this->tokens[i] = dead;
+    this->hub = (struct spotter_token){ 0, 0, 0, -1 };
+
+    for (int r = 0; r < this->n_records; r++) {
+        this->records[r].refs = 0;
+        this->records[r].parent = r + 1 < this->n_records ? r + 1 : -1;
+    }
+    this->free_record = 0;
+}
+
+static void retain(struct spotter *this, int r)
+{
+    if (r >= 0)
+        this->records[r].refs++;
+}
+
+static void release(struct spotter *this, int r)
+{
+    while (r >= 0 && --this->records[r].refs == 0) {
+        int parent = this->records[r].parent;
+
+        this->records[r].parent = this->free_record;
+        this->free_record = r;
+        r = parent;
+    }
+}
+
+// Latest detection on both chains
+static int common(struct spotter *this, int a, int b)
+{
+    while (a != b) {
+        if (a < 0 || b < 0)
+            return -1;
+        if (this->records[a].depth >= this->records[b].depth)
+            a = this->records[a].parent;
+        else
+            b = this->records[b].parent;
+    }
+    return a;
+}
+
+// Report the chain up to r, oldest first
+static void report(struct spotter *this, int r)
+{
+    if (r < 0 || this->records[r].reported)
+        return;
+
+    report(this, this->records[r].parent);
+
+    struct spotter_record *record = &this->records[r];
+    struct spotter_detection d = {
+        record->model, this->models[record->model].model->id, record->start, record->end, record->score
+    };
+
+    record->reported = 1;
+    this->detections++;
+    if (this->callback)
+        this->callback(this, &d, this->ctx);
+}
+
+// Everything every live token agrees on is final: report it, and cut the chains there
+static void traceback(struct spotter *this)
+{
+    int r = this->hub.record;
+
+    for (int i = 0; i < this->n_tokens && r >= 0; i++)
+        if (alive(&this->tokens[i]))
+            r = common(this, r, this->tokens[i].record);
+
+    if (r < 0)
+        return;
+
+    report(this, r);
+    release(this, this->records[r].parent);
+    this->records[r].parent = -1;
+}
+
+/*
+ * Out of records, which the pool's size should rule out: decide now for
+ * the path through r, dropping the tokens whose history doesn't include it.
+ */
+static void force(struct spotter *this, int r)
+{
+    for (int i = 0; i < this->n_tokens; i++) {
+        struct spotter_token *token = &this->tokens[i];
+
+        if (alive(token) && common(this, r, token->record) != r) {
+            release(this, token->record);
+            *token = dead;
+        }
+    }
+    retain(this, r);
+    release(this, this->hub.record);
+    this->hub.record = r;
+
+    traceback(this);
+    this->forced++;
+}
+
+static int new_record(struct spotter *this, int parent)
+{
+    if (this->free_record < 0)
+        force(this, parent);
+    if (this->free_record < 0)
+        die("spotter: out of records\n");
+
+    int r = this->free_record;
+    struct spotter_record *record = &this->records[r];
+
+    this->free_record = record->parent;
+    record->parent = parent;
+    record->depth = parent >= 0 ? this->records[parent].depth + 1 : 0;
+    record->refs = 0;
+    record->reported = 0;
+    retain(this, parent);
+    return r;
+}
+
+/*
+ * Takes the next sample of the stream, at time t, reporting whatever
+ * detections it settles.
+ */
+void spotter_push(struct spotter *this, double x, double y, double z, int64_t t)
+{
+    struct spotter_token *filler = &this->tokens[this->n_models * this->max_states];
+    struct spotter_token *next_filler = &this->next[this->n_models * this->max_states];
+    double best = -INFINITY;
+
+    // Models sharing a codebook share the quantization
+    for (int m = 0; m < this->n_models; m++) {
+        struct spotter_model *sm = &this->models[m];
+
+        if (sm->leader == m)
+            sm->symbol = quantizer_symbol(sm->model->quantizer, x, y, z);
+        else
+            sm->symbol = this->models[sm->leader].symbol;
+    }
+
+    for (int m = 0; m < this->n_models; m++) {
+        struct spotter_model *sm = &this->models[m];
+        struct spotter_token *tokens = &this->tokens[m * this->max_states];
+        struct spotter_token *next = &this->next[m * this->max_states];
+
+        for (int j = 0; j < sm->states; j++) {
+            struct spotter_token token = dead;
+
+            for (int k = 0; k < sm->states; k++) {
+                double score = tokens[k].score + sm->log_change[k * sm->states + j];
+                if (score > token.score) {
+                    token = tokens[k];
+                    token.score = score;
+                }
+            }
+
+            double entry = this->hub.score + sm->log_init[j] - this->penalty;
+            if (entry > token.score)
+                token = (struct spotter_token){ entry, t, 0, this->hub.record };
+
+            if (alive(&token)) {
+                token.score += sm->log_emit[j * sm->observations + sm->symbol];
+                if (++token.len > this->max_len)
+                    token = dead;
+            }
+            next[j] = token;
+            best = MAX(best, token.score);
+        }
+        for (int j = sm->states; j < this->max_states; j++)
+            next[j] = dead;
+    }
+
+    // The filler: stay, or come through the hub from anywhere
+    double spread = this->n_filler > 1 ? log(1.0 / (this->n_filler - 1)) : 0;
+    for (int f = 0; f < this->n_filler; f++) {
+        struct spotter_model *sm = &this->models[this->filler_model[f]];
+        struct spotter_token token = filler[f];
+        double enter = this->hub.score + spread;
+
+        token.score += this->filler_stay[f];
+        if (enter > token.score)
+            token = (struct spotter_token){ enter, 0, 0, this->hub.record };
+
+        token.score += sm->log_emit[this->filler_state[f] * sm->observations + sm->symbol];
+        next_filler[f] = token;
+        best = MAX(best, token.score);
+    }
+
+    // The hub takes the best of the filler and the gestures just completed
+    struct spotter_token hub = dead;
+    int exit_model = -1;
+
+    for (int f = 0; f < this->n_filler; f++)
+        if (next_filler[f].score > hub.score)
+            hub = next_filler[f];
+    double without = hub.score;
+
+    for (int m = 0; m < this->n_models; m++) {
+        struct spotter_token *last = &this->next[m * this->max_states + this->models[m].states - 1];
+        int min_len = this->min_len > 0 ? this->min_len : this->models[m].states;
+
+        if (alive(last) && last->len >= min_len && last->score > hub.score) {
+            hub = *last;
+            exit_model = m;
+        }
+    }
+
+    // The new tokens take their records over from the old ones (all
+    // retained before any is released, as they are shared); the hub's is
+    // kept even if the beam drops its token
+    retain(this, hub.record);
+    for (int i = 0; i < this->n_tokens; i++) {
+        struct spotter_token *token = &this->next[i];
+
+        if (token->score < best - this->beam)
+            *token = dead;
+        retain(this, token->record);
+    }
+    for (int i = 0; i < this->n_tokens; i++)
+        release(this, this->tokens[i].record);
+    release(this, this->hub.record);
+
+    struct spotter_token *swap = this->tokens;
+    this->tokens = this->next;
+    this->next = swap;
+
+    if (exit_model >= 0) {
+        int r = new_record(this, hub.record);
+        struct spotter_record *record = &this->records[r];
+
+        record->model = exit_model;
+        record->start = hub.start;
+        record->end   = t;
+        record->score = hub.score - without + this->penalty;
+
+        retain(this, r);
+        release(this, hub.record);
+        hub.record = r;
+    }
+    this->hub = (struct spotter_token){ 0, 0, 0, hub.record };
+
+    // Keep the numbers small: everything relative to the hub
+    for (int i = 0; i < this->n_tokens; i++)
+        this->tokens[i].score -= hub.score;
+
+    traceback(this);
+    this->samples++;
+}
+
+/*
+ * The stream is over: the best path is the hub's, so its detections are
+ * reported, and gestures still in progress dropped.
+ */
+void spotter_flush(struct spotter *this)
+{
+    report(this, this->hub.record);
+    spotter_reset(this);
+}
@@ -0,0 +1,171 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <math.h>
+
+#include "synth.h"
+#include "quantizer.h"
+#include "hmm.h"
+#include "util.h"
+
+#define PI 3.14159265358979323846
+
+// Defaults: gestures like the recorded ones, at wmdump's 100Hz
+void synth_init(struct synth *this, uint64_t seed)
+{
+    this->seed        = seed ? seed : 1;
+    this->spare_valid = 0;
+    this->min_len     = 30;
+    this->max_len     = 90;
+    this->jitter      = 4;
+    this->warp        = 0.2;
+    this->rotation    = 0.3;
+    this->noise       = 2;
+    this->period      = 10000;
+}
+
+// A uniform double in [0, 1), from a 64-bit xorshift generator
+double synth_uniform(struct synth *this)
+{
+    uint64_t x = this->seed;
+
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    this->seed = x;
+    return (x >> 11) / 9007199254740992.0;
+}
+
+// A standard normal, by Box-Muller
+double synth_normal(struct synth *this)
+{
+    if (this->spare_valid) {
+        this->spare_valid = 0;
+        return this->spare;
+    }
+
+    double u = 1 - synth_uniform(this);     // (0, 1]: log() is finite
+    double v = synth_uniform(this);
+    double r = sqrt(-2 * log(u));
+
+    this->spare = r * sin(2 * PI * v);
+    this->spare_valid = 1;
+    return r * cos(2 * PI * v);
+}
+
+// Index drawn from the n weights p (which needn't sum to exactly 1)
+static int draw(struct synth *this, const double *p, int n)
+{
+    double total = 0;
+    for (int i = 0; i < n; i++)
+        total += p[i];
+
+    double r = synth_uniform(this) * total;
+    for (int i = 0; i < n - 1; i++) {
+        if (r < p[i])
+            return i;
+        r -= p[i];
+    }
+    return n - 1;
+}
+
+static uint8_t report(double v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : (uint8_t)floor(v + 0.5);
+}
+
+/*
+ * A gesture sampled from model: a walk through its HMM, each state emitting
+ * a symbol, each symbol becoming that centroid of the model's codebook
+ * plus jitter.  Writes between min_len and max_len reports (at most max),
+ * period apart from 0, and returns how many.
+ */
+int synth_sample(struct synth *this, struct gesturemodel *model,
+                 uint8_t *x, uint8_t *y, uint8_t *z, int64_t *t, int max)
+{
+    HmmState *hmm = model->hmm;
+    double (*map)[3] = model->quantizer->map;
+    int n_states = hmm->numStates, n_obs = hmm->numObservations;
+    int len = this->min_len + (int)(synth_uniform(this) * (this->max_len - this->min_len + 1));
+    int state = draw(this, hmm->p_initial, n_states);
+
+    len = MIN(MAX(len, 1), max);
+    for (int i = 0; i < len; i++) {
+        int symbol = draw(this, &hmm->p_emit[state * n_obs], n_obs);
+
+        x[i] = report(map[symbol][0] + this->jitter * synth_normal(this));
+        y[i] = report(map[symbol][1] + this->jitter * synth_normal(this));
+        z[i] = report(map[symbol][2] + this->jitter * synth_normal(this));
+        t[i] = i * this->period;
+
+        state = draw(this, &hmm->p_change[state * n_states], n_states);
+    }
+    return len;
+}
+
+// A rotation by up to this->rotation about a random axis (Rodrigues)
+static void random_rotation(struct synth *this, double r[3][3])
+{
+    double a[3], norm = 0;
+
+    for (int i = 0; i < 3; i++) {
+        a[i] = synth_normal(this);
+        norm += a[i] * a[i];
+    }
+    norm = sqrt(norm);
+    for (int i = 0; i < 3; i++)
+        a[i] = norm > 0 ? a[i] / norm : i == 2;
+
+    double angle = this->rotation * (2 * synth_uniform(this) - 1);
+    double c = cos(angle), s = sin(angle), k = 1 - c;
+
+    r[0][0] = c + a[0] * a[0] * k;
+    r[0][1] = a[0] * a[1] * k - a[2] * s;
+    r[0][2] = a[0] * a[2] * k + a[1] * s;
+    r[1][0] = a[1] * a[0] * k + a[2] * s;
+    r[1][1] = c + a[1] * a[1] * k;
+    r[1][2] = a[1] * a[2] * k - a[0] * s;
+    r[2][0] = a[2] * a[0] * k - a[1] * s;
+    r[2][1] = a[2] * a[1] * k + a[0] * s;
+    r[2][2] = c + a[2] * a[2] * k;
+}
+
+/*
+ * A variation on the n reports in x, y, z, t: played back at a random
+ * speed that also drifts within the gesture (a monotone warp of its
+ * time), rotated about SYNTH_REST and with noise added.  Writes at most
+ * max reports, as far apart as the original's were on average, and
+ * returns how many.
+ */
+int synth_augment(struct synth *this, const uint8_t *x, const uint8_t *y, const uint8_t *z,
+                  const int64_t *t, int n, uint8_t *ox, uint8_t *oy, uint8_t *oz, int64_t *ot, int max)
+{
+    if (n < 1 || max < 1)
+        return 0;
+
+    double speed = 1 + this->warp * (2 * synth_uniform(this) - 1);
+    double bend = this->warp * (2 * synth_uniform(this) - 1);   // |bend| < 1 keeps the warp monotone
+    int m = MIN(MAX((int)floor(n / speed + 0.5), 1), max);
+    int64_t dt = n > 1 ? (t[n-1] - t[0]) / (n - 1) : this->period;
+    double r[3][3];
+
+    random_rotation(this, r);
+
+    for (int i = 0; i < m; i++) {
+        double s = m > 1 ? (double)i / (m - 1) : 0;
+        double p = (n - 1) * (s + bend * sin(PI * s) / PI);
+        int j = MAX(MIN((int)p, n - 2), 0);
+        int k = MIN(j + 1, n - 1);
+        double f = p - j;
+        double v[3];
+
+        v[0] = x[j] + f * (x[k] - x[j]) - SYNTH_REST;
+        v[1] = y[j] + f * (y[k] - y[j]) - SYNTH_REST;
+        v[2] = z[j] + f * (z[k] - z[j]) - SYNTH_REST;
+
+        ox[i] = report(SYNTH_REST + r[0][0] * v[0] + r[0][1] * v[1] + r[0][2] * v[2] + this->noise * synth_normal(this));
+        oy[i] = report(SYNTH_REST + r[1][0] * v[0] + r[1][1] * v[1] + r[1][2] * v[2] + this->noise * synth_normal(this));
+        oz[i] = report(SYNTH_REST + r[2][0] * v[0] + r[2][1] * v[1] + r[2][2] * v[2] + this->noise * synth_normal(this));
+        ot[i] = t[0] + i * dt;
+    }
+    return m;
+}
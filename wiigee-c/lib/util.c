@@ -23,10 +23,9 @@ int debug(const char *format, ...)
 int die(const char *format, ...)
 {
     va_list ap;
-    int out;
 
     va_start(ap, format);
-    out = vfprintf(stderr, format, ap);
+    vfprintf(stderr, format, ap);
     va_end(ap);
     abort();
 }
@@ -0,0 +1,200 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // mmap, posix_madvise
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wmdump.h"
+#include "gesture.h"
+#include "util.h"
+
+static void segment_append(struct wmdump_segment *this, int x, int y, int z, int64_t t)
+{
+    if (this->data_len == this->data_cap) {
+        this->data_cap = MAX(2 * this->data_cap, 64);
+        this->x = xrealloc(this->x, this->data_cap);
+        this->y = xrealloc(this->y, this->data_cap);
+        this->z = xrealloc(this->z, this->data_cap);
+        this->t = xrealloc(this->t, sizeof(int64_t) * this->data_cap);
+    }
+    this->x[this->data_len] = x;
+    this->y[this->data_len] = y;
+    this->z[this->data_len] = z;
+    this->t[this->data_len] = t;
+    this->data_len++;
+}
+
+#define BUTTON_B    0x0004      // CWIID_BTN_B, the capture trigger
+
+// The next unsigned decimal number on the line, or NULL if the line ends first
+static const char *scan_decimal(const char *p, const char *end, long *out)
+{
+    while (p < end && (unsigned)(*p - '0') > 9) {
+        if (*p == '\n')
+            return NULL;
+        p++;
+    }
+    if (p == end)
+        return NULL;
+
+    long v = 0;
+    while (p < end && (unsigned)(*p - '0') <= 9 && v < 100000000000L)
+        v = v * 10 + (*p++ - '0');
+    *out = v;
+    return p;
+}
+
+static const char *scan_hex(const char *p, const char *end, long *out)
+{
+    long v = 0;
+    int digits = 0;
+
+    for (; p < end && digits < 8; p++, digits++) {
+        int c = *p | 0x20;      // fold case, leaves digits alone
+        if ((unsigned)(c - '0') <= 9)
+            v = v * 16 + (c - '0');
+        else if ((unsigned)(c - 'a') < 6)
+            v = v * 16 + (c - 'a' + 10);
+        else
+            break;
+    }
+    *out = v;
+    return digits ? p : NULL;
+}
+
+static const char *line_end(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+#define ACC_PREFIX      "Acc Report: "
+#define BUTTON_PREFIX   "Button Report: "
+
+/*
+ * Hands every gesture in the log at path to handler.  A gesture is the
+ * reports between the B button going down and coming back up; they are
+ * numbered the way noodling/process/process.sh numbers them.  The file is
+ * mapped and scanned in one pass.  Returns the number of segments handed
+ * out, or -1 if the file can't be read.
+ */
+int wmdump_parse(const char *path, wmdump_handler handler, void *ctx)
+{
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st)) {
+        close(fd);
+        return -1;
+    }
+
+    const char *text = NULL;
+    if (st.st_size > 0) {
+        text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (text == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        posix_madvise((void *)text, st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    struct wmdump_segment segment = { 0 };
+    const char *p = text, *end = text + st.st_size;
+    int pressed = 0;
+    int segments = 0;
+    int stop = 0;
+
+    while (!stop && p < end) {
+        const char *next = line_end(p, end);
+        long v[5];
+
+        if (next - p > (long)sizeof(ACC_PREFIX) && !memcmp(p, ACC_PREFIX, sizeof(ACC_PREFIX) - 1)) {
+            const char *q = p + sizeof(ACC_PREFIX) - 1;
+            int i;
+
+            for (i = 0; i < 5 && q; i++)
+                q = scan_decimal(q, next, &v[i]);
+
+            if (q && pressed && v[0] < 256 && v[1] < 256 && v[2] < 256)
+                segment_append(&segment, v[0], v[1], v[2], (int64_t)v[3] * 1000000 + v[4]);
+        } else if (next - p > (long)sizeof(BUTTON_PREFIX) && !memcmp(p, BUTTON_PREFIX, sizeof(BUTTON_PREFIX) - 1)) {
+            if (scan_hex(p + sizeof(BUTTON_PREFIX) - 1, next, &v[0])) {
+                int now = (v[0] & BUTTON_B) != 0;
+
+                if (pressed && !now) {
+                    if (segment.data_len) {
+                        stop = handler(ctx, &segment);
+                        segments++;
+                    }
+                    segment.gesture++;
+                    segment.data_len = 0;
+                }
+                pressed = now;
+            }
+        }
+        p = next;
+    }
+
+    // A log cut off mid-gesture still has that gesture in it
+    if (!stop && segment.data_len) {
+        handler(ctx, &segment);
+        segments++;
+    }
+
+    if (text)
+        munmap((void *)text, st.st_size);
+    free(segment.x);
+    free(segment.y);
+    free(segment.z);
+    free(segment.t);
+    return segments;
+}
+
+// The segment as a struct gesture, for the trainer; its times stay in segment->t
+struct gesture *wmdump_gesture(const struct wmdump_segment *segment, struct arena *arena)
+{
+    struct gesture *gesture = gesture_new_in(arena);
+
+    gesture_reserve(gesture, segment->data_len);
+    for (int i = 0; i < segment->data_len; i++)
+        gesture_append(gesture, segment->x[i], segment->y[i], segment->z[i]);
+    gesture_minmax(gesture);
+    return gesture;
+}
+
+/*
+ * Splits a capture file name, "user.hand.txt", into its user and hand
+ * parts.  Returns 0, or -1 if the name doesn't have that shape.
+ */
+int wmdump_name(const char *path, char *user, int user_len, char *hand, int hand_len)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+
+    const char *dot = strchr(base, '.');
+    if (!dot)
+        return -1;
+    const char *end = strchr(dot + 1, '.');
+    if (!end)
+        end = dot + 1 + strlen(dot + 1);
+
+    int u = dot - base;
+    int h = end - (dot + 1);
+    if (u == 0 || h == 0 || u >= user_len || h >= hand_len)
+        return -1;
+
+    memcpy(user, base, u);
+    user[u] = '\0';
+    memcpy(hand, dot + 1, h);
+    hand[h] = '\0';
+    return 0;
+}
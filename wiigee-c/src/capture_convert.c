@@ -0,0 +1,62 @@
+/*
+ * Converts wmdump text captures (noodling/training-data-capture-*) into one
+ * binary capture file, see capture.h.
+ *
+ * Usage: capture_convert out.wgc user.hand.txt [user.hand.txt ...]
+ *    or: capture_convert out.wgc capture-directory
+ *
+ * User and hand come from the file names, gesture numbers from the button
+ * releases, the same way noodling/process/process.sh assigns them.  The
+ * inputs are read in parallel, see corpus.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#include "capture.h"
+#include "corpus.h"
+
+int main(int argc, char *argv[])
+{
+  struct stat st;
+  struct corpus *corpus;
+
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s out.wgc {user.hand.txt ... | directory}\n", argv[0]);
+    exit(1);
+  }
+
+  if (argc == 3 && !stat(argv[2], &st) && S_ISDIR(st.st_mode))
+    corpus = corpus_load_dir(argv[2], 0);
+  else
+    corpus = corpus_load((const char *const *)argv + 2, argc - 2, 0);
+
+  if (!corpus) {
+    perror(argv[2]);
+    exit(1);
+  }
+  corpus_report(corpus, stdout);
+  if (corpus->n_failed) {
+    fprintf(stderr, "%d inputs couldn't be read, or aren't named user.hand.txt\n", corpus->n_failed);
+    exit(1);
+  }
+
+  struct capture_writer *writer = capture_writer_new();
+
+  for (int i = 0; i < corpus->n_gestures; i++) {
+    struct corpus_gesture *g = &corpus->gestures[i];
+    capture_writer_add(writer, corpus->users[g->user], g->hand, g->gesture,
+                       g->x, g->y, g->z, g->t, g->data_len);
+  }
+
+  if (capture_writer_save(writer, argv[1])) {
+    perror(argv[1]);
+    exit(1);
+  }
+  printf("%s: %d gestures, %ld samples\n", argv[1], writer->n_gestures, corpus->n_samples);
+
+  capture_writer_free(writer);
+  corpus_free(corpus);
+  return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * Makes synthetic capture files (see capture.h) of any size, for scaling
+ * benchmarks; see synth.h for how the gestures are made.
+ *
+ * Usage: capture_synth out.wgc n -m bank.wmb [options]
+ *    or: capture_synth out.wgc n -a in.wgc [options]
+ *
+ * -m samples n gestures from the models of a bank, taking the models in
+ * turn; each gesture's user is "model<id>" so the label survives.  -a
+ * makes n variations on the gestures of a capture, taking those in turn;
+ * each keeps its original's user, hand and gesture number.
+ *
+ * Options: -s seed, -j jitter, -w warp, -r rotation (radians), -e noise,
+ * -l min_len,max_len (sampling only).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "modelbank.h"
+#include "synth.h"
+
+#define MAX_REPORTS 4096
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "Usage: %s out.wgc n {-m bank.wmb | -a in.wgc} [-s seed] [-j jitter] "
+          "[-w warp] [-r rotation] [-e noise] [-l min,max]\n", name);
+  exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *bank_path = NULL, *capture_path = NULL;
+  struct synth synth;
+  int opt;
+
+  if (argc < 3)
+    usage(argv[0]);
+
+  const char *out = argv[1];
+  long n = atol(argv[2]);
+  optind = 3;
+
+  synth_init(&synth, 1);
+  while ((opt = getopt(argc, argv, "m:a:s:j:w:r:e:l:")) != -1) {
+    switch (opt) {
+    case 'm': bank_path = optarg; break;
+    case 'a': capture_path = optarg; break;
+    case 's': synth.seed = strtoull(optarg, NULL, 0) ? strtoull(optarg, NULL, 0) : 1; break;
+    case 'j': synth.jitter = atof(optarg); break;
+    case 'w': synth.warp = atof(optarg); break;
+    case 'r': synth.rotation = atof(optarg); break;
+    case 'e': synth.noise = atof(optarg); break;
+    case 'l':
+      if (sscanf(optarg, "%d,%d", &synth.min_len, &synth.max_len) != 2)
+        usage(argv[0]);
+      break;
+    default: usage(argv[0]);
+    }
+  }
+  if (n < 1 || optind != argc || !bank_path == !capture_path
+      || synth.min_len < 1 || synth.max_len < synth.min_len || synth.max_len > MAX_REPORTS
+      || synth.warp < 0 || synth.warp >= 1)
+    usage(argv[0]);
+
+  static uint8_t x[MAX_REPORTS], y[MAX_REPORTS], z[MAX_REPORTS];
+  static int64_t t[MAX_REPORTS], in_t[MAX_REPORTS];
+  struct capture_writer *writer = capture_writer_new();
+  long samples = 0;
+
+  if (bank_path) {
+    struct modelbank *bank = modelbank_open(bank_path);
+    if (!bank || bank->n_models < 1) {
+      fprintf(stderr, "%s: can't read model bank\n", bank_path);
+      exit(1);
+    }
+
+    char user[32];
+    for (long i = 0; i < n; i++) {
+      struct gesturemodel *model = bank->models[i % bank->n_models];
+      int len = synth_sample(&synth, model, x, y, z, t, MAX_REPORTS);
+
+      // A second or more apart, as if recorded back to back
+      int64_t t0 = i * ((synth.max_len + 100) * synth.period);
+      for (int k = 0; k < len; k++)
+        t[k] += t0;
+
+      snprintf(user, sizeof(user), "model%d", model->id);
+      capture_writer_add(writer, user, HAND_UNKNOWN, i / bank->n_models, x, y, z, t, len);
+      samples += len;
+    }
+    modelbank_close(bank);
+  } else {
+    struct capture *capture = capture_open(capture_path);
+    struct capture_view view;
+
+    if (!capture || capture_count(capture) < 1) {
+      fprintf(stderr, "%s: can't read captures\n", capture_path);
+      exit(1);
+    }
+
+    for (long i = 0; i < n; i++) {
+      capture_get(capture, i % capture_count(capture), &view);
+      if (view.data_len > MAX_REPORTS)
+        view.data_len = MAX_REPORTS;
+      capture_timestamps(&view, in_t);
+
+      int len = synth_augment(&synth, view.x, view.y, view.z, in_t, view.data_len,
+                              x, y, z, t, MAX_REPORTS);
+      capture_writer_add(writer, view.user, view.hand, view.gesture, x, y, z, t, len);
+      samples += len;
+    }
+    capture_close(capture);
+  }
+
+  if (capture_writer_save(writer, out)) {
+    perror(out);
+    exit(1);
+  }
+  printf("%s: %d gestures, %ld samples\n", out, writer->n_gestures, samples);
+
+  capture_writer_free(writer);
+  return 0;
+}
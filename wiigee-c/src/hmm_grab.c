@@ -7,15 +7,22 @@
  * Usage: just run the binary, then hold down trigger to capture, release to
  * analyze.  Prints to stdout.
  *
+ * Or replay recorded gestures instead (see replay.h): hmm_grab 3 -r file
+ * [speed|asap], where speed 1 is real time.
+ *
  * I mentioned kludgy, right?  Good.
  *
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <pthread.h>
 
 #include <cwiid.h>
 
@@ -23,7 +30,11 @@
 #include <math.h>
 
 #include "util.h"
+#include "arena.h"
 #include "quantizer.h"
+#include "ring.h"
+#include "resampler.h"
+#include "replay_cwiid.h"
 
 cwiid_mesg_callback_t cwiid_callback;
 
@@ -52,11 +63,29 @@ HmmStateRef *hmms;
 
 int n_trained = -1;
 
+/* Everything one capture + recognition needs; reset after each gesture */
+struct arena *scratch;
+
+/* Reports on their way from the cwiid callback to the recognition thread */
+struct ring *events;
+void *recognition_thread(void *);
+void init_acc_stream();
+
+/* A replay can wait for the recognition thread, a live wiimote can't.
+ * Both counters are only touched through __atomic builtins. */
+int replaying;
+unsigned long pushed, handled;
+
+/* Live events are stamped with ring_now(), replayed ones with the time
+ * their report was made; this is what to add to a stamp to get
+ * ring_now(), as of the latest callback */
+int64_t made_to_now;
+
 
 int main(int argc, char *argv[]) 
 {
-  if (argc != 2) {
-    printf("Usage: %s 3, where 3 is the number of gestures to recognize\n", argv[0]);
+  if (argc != 2 && !((argc == 4 || argc == 5) && !strcmp(argv[2], "-r"))) {
+    printf("Usage: %s 3 [-r capture [speed|asap]], where 3 is the number of gestures to recognize\n", argv[0]);
     exit(1);
   }
   n_gestures = atoi(argv[1]);
@@ -69,6 +98,17 @@ int main(int argc, char *argv[])
     hmms[i] = hmm_new(n_states, n_obs);
   }
 
+  scratch = arena_new(64 * 1024);
+  init_acc_stream();
+
+  /* A few seconds of reports at 100Hz, plus button reports */
+  events = ring_new(1024);
+  pthread_t recognizer;
+  if (pthread_create(&recognizer, NULL, recognition_thread, NULL)) {
+    fprintf(stderr, "Unable to start the recognition thread\n");
+    exit(1);
+  }
+
   cwiid_wiimote_t *wiimote;	/* wiimote handle */
   //struct cwiid_state state;	/* wiimote state */
   bdaddr_t bdaddr;	/* bluetooth device address */
@@ -81,6 +121,18 @@ int main(int argc, char *argv[])
    * this program into a timestamping utility, such as tai64n(1) */
   setvbuf(stdout, NULL, _IOLBF, 0);
 
+  if (argc > 2) {
+    replaying = 1;
+    if (replay_cwiid(argv[3], replay_speed(argv[4]), cwiid_callback)) {
+      fprintf(stderr, "%s: can't replay\n", argv[3]);
+      exit(1);
+    }
+    struct timespec ms = { 0, 1000000 };
+    while (__atomic_load_n(&handled, __ATOMIC_ACQUIRE) < __atomic_load_n(&pushed, __ATOMIC_ACQUIRE))
+      nanosleep(&ms, NULL);
+    exit(0);
+  }
+
   cwiid_set_err(err);
 
 #if WE_ACTUALLY_CARE_ABOUT_BLUETOOTH
@@ -130,181 +182,191 @@ void set_rpt_mode(cwiid_wiimote_t *wiimote, unsigned char rpt_mode)
 }
 
 
-struct acc_report {
-  int x,y,z;
-  time_t t;
-  suseconds_t u;
-  struct acc_report *next;
-};
-
-struct acc_report accs = { 0,0,0, 0,0, NULL };
-struct acc_report *acc_cursor = &accs;
-
-struct acc_report * add_acc_report(struct acc_report *cur_in, int x, int y, int z, time_t t, suseconds_t u) {
-  struct acc_report *cur = cur_in;
-  cur->next = malloc(sizeof(struct acc_report));
-  cur = cur->next;
+/*
+ * Reports are downsampled as they arrive, and the downsampled samples go
+ * straight into the gesture, so a release only leaves training and
+ * scoring to do.
+ *
+ * We'll treat this as a noisy sensor stream, so we want to downsample to the
+ * center of buckets, holding each report's value until the next one (see
+ * resampler.h).
+ *
+ * 100ms buckets (10Hz) for now; 20000 would be 50Hz.
+ */
+#define SAMPLE_PERIOD   100000  /* microseconds */
+#define RESAMPLED_MAX   1024    /* ~100s of gesture at 10Hz */
 
-  cur->x = x;
-  cur->y = y;
-  cur->z = z;
+struct resampler stream;
+struct resampler_sample resampled[RESAMPLED_MAX];
+int resampled_fed;              /* how many of them are in captured */
+struct gesture *captured;       /* in scratch; NULL between gestures */
 
-  cur->t = t;
-  cur->u = u;
+void add_acc_report(int x, int y, int z, int64_t usec) {
+  resampler_push(&stream, x, y, z, usec);
+}
 
-  cur->next = NULL;
+/* Move any new downsampled samples into the gesture */
+void feed_gesture() {
+  if (!captured)
+    captured = gesture_new_in(scratch);
 
-  return cur;
+  for (; resampled_fed < stream.out_len; resampled_fed++)
+    gesture_append(captured, resampled[resampled_fed].x, resampled[resampled_fed].y, resampled[resampled_fed].z);
 }
 
-void dump_acc_stream(struct acc_report *a) {
-  printf("dump(%p)\n", a);
-  while(a) {
-    printf("  x=%d  y=%d  z=%d ; t=%ld.%ld\n", a->x, a->y, a->z, a->t, a->u);
-    a = a->next;
-  }
+void dump_resampled() {
+  for (int i = 0; i < stream.out_len; i++)
+    printf("  x=%d  y=%d  z=%d\n", resampled[i].x, resampled[i].y, resampled[i].z);
+  if (stream.overflow)
+    printf("  (%lu more samples didn't fit)\n", stream.overflow);
 }
 
-struct acc_report *reset_acc_stream(struct acc_report *head) {
-  struct acc_report *a = head->next;
-  printf("reset(%p)\n", a);
-  while(a) {
-    struct acc_report *next = a->next;
-    free(a);
-    a = next;
-  }
-  head->next = NULL;
-  return head;
+void init_acc_stream() {
+  resampler_init(&stream, SAMPLE_PERIOD, 0, resampled, RESAMPLED_MAX);
 }
 
-/*
- *
- * Downsample the collected sensor input.
- *
- * We'll treat this as a noisy sensor stream, so we want to downsample to the
- * center of buckets.  We'll interpolate with constant values instead of
- * anything clever, and we'll extend datapoints at the end out to the end of
- * the final bucket to "round out" (instead of doing a partial bucket).
- *
- * We'll shoot for a sample rate of 50Hz for now
- *
- *
- */
-struct acc_report * downsample_acc_stream(struct acc_report *head) {
-  struct acc_report *output_head = malloc(sizeof(struct acc_report));
-  memset(output_head, 0, sizeof(struct acc_report));
-  struct acc_report *output_cursor = output_head;
-
-  //long sample_period = 20000; // 1e6us/50samples = 2e4 us/sample
-  long sample_period = 100000; // 1e6us/10samples = 1e5 us/sample
+/* The gesture is in scratch; arena_reset() reclaims it */
+void reset_acc_stream() {
+  resampler_reset(&stream);
+  resampled_fed = 0;
+  captured = NULL;
+}
 
-  long x,y,z,t; // accumulators
-  x = y = z = t = 0;
+struct observation * run_quantizer(struct gesture *gesture) {
+    struct quantizer *quantizer = quantizer_new_in(scratch, 8, MAP_SIZE, SEED_CIRCLE);
+    struct observation *observation = NULL;
 
-  struct acc_report *a = head->next;
-  if (!a) return output_head; // Short circuit if we have no data
+    gesture_minmax(gesture);
 
-  struct acc_report *next = a->next;
+    // Train
+    quantizer_trainCenteroids(quantizer, gesture);
 
-  long t_missing;
+    // Get out observation object back
+    observation = quantizer_getObservationSequence(quantizer, gesture);
 
-  while(next) {
-    long dt = (next->t - a->t) * 1000000 + (next->u - a->u);
+    // Dump it
+    for (int i = 0; i < observation->sequence_len; i++) {
+        printf("%d\n", observation->sequence[i]);
+    }
 
-    t_missing = sample_period - t; // time left to accumulate
+    quantizer_free(quantizer);
+    return observation;
+}
 
-    while (t_missing < dt) {
-      // spans off into next bucket. need to split off a slice, accumulate, emit, and then accumulate the remainder of x,y,z,t
 
-      x += a->x * t_missing;
-      y += a->y * t_missing;
-      z += a->z * t_missing;
-      t += t_missing;
-      dt -= t_missing;
 
-      output_cursor = add_acc_report(output_cursor, x/sample_period,y/sample_period,z/sample_period, 0,0);
-      // reset state
-      x = y = z = t = 0;
-      t_missing = sample_period - t;
-    }
+/* Recognize (or train on) the gesture that just ended, then start over */
+void recognize() {
+    resampler_finish(&stream);
+    feed_gesture();
 
-    // Now left with a dt == 0 or dt < t_missing, so need to accumulate
-    x += a->x * dt;
-    y += a->y * dt;
-    z += a->z * dt;
-    t += dt;
+    printf("\n\nDOWNSAMPLED\n");
+    dump_resampled();
 
-    a = next;
-    next = a->next;
-  }
-  // fill out the final bucket with constant interpolation on t_missing and the last x,y,z reading.  (*a points to the last reading)
+    printf("\n\nQUANTIZED\n");
 
-  t_missing = sample_period - t;
-  x += a->x * t_missing;
-  y += a->y * t_missing;
-  z += a->z * t_missing;
-  t += t_missing;
+    struct observation *obs = run_quantizer(captured);
+    StateSequence view = observation_view(obs);
+    StateSequenceRef sequence = &view;
 
-  output_cursor = add_acc_report(output_cursor, x/sample_period,y/sample_period,z/sample_period, 0,0);
-  // reset state
-      x = y = z = t = 0;
-  t_missing = sample_period - t;
+    int n_trained_index = n_trained / 3;
 
-  return output_head;
-}
+    if (n_trained == -1) {
+      printf("GOOD, YOU'VE SYNCED.  PROCEEDING TO TRAIN 0.");
+      n_trained++;
+    } else if (n_trained_index < n_gestures) {
+      hmm_train(hmms[n_trained_index], &sequence, 1);
+      printf("TRAINED %d\n", n_trained_index);
+      n_trained++;
+      n_trained_index = n_trained / 3;
+      if (n_trained_index < n_gestures)
+        printf("PROCEEDING TO TRAIN %d\n", n_trained_index);
+      else
+        printf("DONE TRAINING, WOO.  On to classifying.\n");
+    } else {
+      printf("\nCLASSIFYING\n");
 
-void acc_reports_to_gesture(struct acc_report *head, struct gesture *gesture) {
-  struct acc_report *a = head->next;
-  printf("reset(%p)\n", a);
-  while(a) {
-    gesture_append(gesture, a->x, a->y, a->z);
-    a = a->next;
-  }
+      double max_p = 0.0;
+      int max_i = 0;
 
-  double minacc = DBL_MAX;
-  double maxacc = DBL_MIN;
 
-  for (int i = 0; i < gesture->data_len; i++) {
-      maxacc = MAX(maxacc, fabs(gesture->data[i].x));
-      maxacc = MAX(maxacc, fabs(gesture->data[i].y));
-      maxacc = MAX(maxacc, fabs(gesture->data[i].z));
+      for(int i = 0; i < n_gestures; i++) {
+        double p = getProbability(hmms[i], sequence);
+        printf("  P(%d) = %f\n", i, p);
+        if (p > max_p) {
+          max_p = p;
+          max_i = i;
+        }
+      }
 
-      minacc = MIN(minacc, fabs(gesture->data[i].x));
-      minacc = MIN(minacc, fabs(gesture->data[i].y));
-      minacc = MIN(minacc, fabs(gesture->data[i].z));
-  }
+      printf("\n  CLASSIFICATION RESULTS: %d with P=%f\n", max_i, max_p);
+    }
 
-  gesture->maxacc = maxacc;
-  gesture->minacc = minacc;
+    reset_acc_stream();
+    arena_reset(scratch);
 }
 
-struct observation * run_quantizer(struct acc_report *head) {
-    struct quantizer *quantizer = quantizer_new(8);
-    struct gesture *gesture = gesture_new();
-    struct observation *observation = NULL;
-
-    // Initialize our gesture object
-    acc_reports_to_gesture(head, gesture);
+unsigned long dropped_reported;
 
-    // Train
-    quantizer_trainCenteroids(quantizer, gesture);
-
-    // Get out observation object back
-    observation = quantizer_getObservationSequence(quantizer, gesture);
-
-    // Dump it
-    for (int i = 0; i < observation->sequence_len; i++) {
-        printf("%d\n", observation->sequence[i]);
+/*
+ * Everything that takes time happens here, off the cwiid callback thread:
+ * collecting reports, downsampling, training and classifying.
+ */
+void *recognition_thread(void *arg) {
+  struct ring_event batch[64];
+
+  for (;;) {
+    size_t n = ring_pop_wait(events, batch, 64, -1);
+
+    for (size_t i = 0; i < n; i++) {
+      struct ring_event *e = &batch[i];
+
+      if (e->type == RING_ACC) {
+        add_acc_report(
+          (signed char)e->x,
+          (signed char)e->y,
+          (signed char)e->z,
+          e->t / 1000);
+        feed_gesture();
+      } else {
+        printf("Button Report: %.4X\n", e->buttons);
+        if (e->buttons == 0 && stream.have_last) {
+          recognize();
+          int64_t released = e->t + __atomic_load_n(&made_to_now, __ATOMIC_RELAXED);
+          printf("LATENCY: %.3f ms\n", (ring_now() - released) / 1e6);
+        }
+      }
     }
+    __atomic_add_fetch(&handled, n, __ATOMIC_RELEASE);
 
-    quantizer_free(quantizer);
-    gesture_free(gesture);
-    return observation;
+    if (ring_dropped(events) != dropped_reported) {
+      dropped_reported = ring_dropped(events);
+      printf("WARNING: %lu reports dropped, recognition is falling behind\n", dropped_reported);
+    }
+  }
+  return NULL;
 }
 
+int button_state;
 
+void push_event(int type, int64_t t, int buttons, union cwiid_mesg *mesg) {
+  struct ring_event e = { t, type, buttons, 0, 0, 0, 0 };
 
-int button_state;
+  if (mesg) {
+    e.x = mesg->acc_mesg.acc[CWIID_X];
+    e.y = mesg->acc_mesg.acc[CWIID_Y];
+    e.z = mesg->acc_mesg.acc[CWIID_Z];
+  }
+  __atomic_add_fetch(&pushed, 1, __ATOMIC_RELEASE);
+  while (ring_push(events, &e)) {   /* drops (and counts) if full, never blocks */
+    if (!replaying) {
+      __atomic_sub_fetch(&pushed, 1, __ATOMIC_RELEASE);
+      break;
+    }
+    struct timespec wait = { 0, 100000 };
+    nanosleep(&wait, NULL);
+  }
+}
 
 /* Prototype cwiid_callback with cwiid_callback_t, define it with the actual
  * type - this will cause a compile error (rather than some undefined bizarre
@@ -322,6 +384,20 @@ void cwiid_callback(cwiid_wiimote_t *wiimote, int mesg_count,
   int i;
   //int valid_source;
 
+  /* The messages in one call arrived together; stamp them once, so that
+   * button and accelerometer events share one timeline.  Live, that's
+   * ring_now(): cwiid's timestamp is wall-clock time, which NTP or the
+   * admin may step.  A replay's times are when the reports were made,
+   * which may run faster than ours; the latency printout maps them back
+   * to ring_now().  Either way, never backwards, for the resampler. */
+  static int64_t last_made;
+  int64_t now = ring_now();
+  int64_t made = replaying ? (int64_t)timestamp->tv_sec * 1000000000 + timestamp->tv_nsec : now;
+  if (made < last_made)
+    made = last_made;
+  last_made = made;
+  __atomic_store_n(&made_to_now, now - made, __ATOMIC_RELAXED);
+
   for (i=0; i < mesg_count; i++)
     {
       switch (mesg[i].type) {
@@ -345,82 +421,12 @@ void cwiid_callback(cwiid_wiimote_t *wiimote, int mesg_count,
 	printf("\n");
 	break;
       case CWIID_MESG_BTN:
-	printf("Button Report: %.4X\n", mesg[i].btn_mesg.buttons);
 	button_state = mesg[i].btn_mesg.buttons;
-
-  if (button_state == 0 && accs.next) {
-    dump_acc_stream(&accs);
-
-    printf("\n\nDOWNSAMPLED\n");
-
-    struct acc_report *ds = downsample_acc_stream(&accs);
-    dump_acc_stream(ds);
-
-    printf("\n\nQUANTIZED\n");
-
-    struct observation *obs = run_quantizer(ds);
-    StateSequenceRef sequence = createStateSequence(obs->sequence, obs->sequence_len);
-    observation_free(obs); // gets copied
-
-    int n_trained_index = n_trained / 3;
-
-    if (n_trained == -1) {
-      printf("GOOD, YOU'VE SYNCED.  PROCEEDING TO TRAIN 0.");
-      n_trained++;
-    } else if (n_trained_index < n_gestures) {
-      hmm_train(hmms[n_trained_index], &sequence, 1);
-      printf("TRAINED %d\n", n_trained_index);
-      n_trained++;
-      n_trained_index = n_trained / 3;
-      if (n_trained_index < n_gestures)
-        printf("PROCEEDING TO TRAIN %d\n", n_trained_index);
-      else
-        printf("DONE TRAINING, WOO.  On to classifying.\n");
-    } else {
-      printf("\nCLASSIFYING\n");
-
-      double max_p = 0.0;
-      int max_i = 0;
-
-
-      for(int i = 0; i < n_gestures; i++) {
-        double p = getProbability(hmms[i], sequence);
-        printf("  P(%d) = %f\n", i, p);
-        if (p > max_p) {
-          max_p = p;
-          max_i = i;
-        }
-      }
-
-      printf("\n  CLASSIFICATION RESULTS: %d with P=%f\n", max_i, max_p);
-    }
-
-    reset_acc_stream(ds);
-    free(ds);
-
-    acc_cursor = reset_acc_stream(&accs);
-  }
-
+	push_event(RING_BUTTON, made, button_state, NULL);
 	break;
       case CWIID_MESG_ACC:
-
-	if (button_state & 0x0004) {
-	  struct timeval now;
-	  gettimeofday(&now, NULL);
-    /*
-	  printf("Acc Report: x=%d, y=%d, z=%d   %ld %ld\n",
-		 mesg[i].acc_mesg.acc[CWIID_X],
-		 mesg[i].acc_mesg.acc[CWIID_Y],
-		 mesg[i].acc_mesg.acc[CWIID_Z],
-		 now.tv_sec, now.tv_usec);
-    */
-    acc_cursor = add_acc_report(
-     acc_cursor,
-		 (signed char)mesg[i].acc_mesg.acc[CWIID_X],
-		 (signed char)mesg[i].acc_mesg.acc[CWIID_Y],
-		 (signed char)mesg[i].acc_mesg.acc[CWIID_Z],
-		 now.tv_sec, now.tv_usec);
-	}
+	if (button_state & 0x0004)
+	  push_event(RING_ACC, made, button_state, &mesg[i]);
 	break;
       case CWIID_MESG_IR:
 	printf("IR Report: elided");
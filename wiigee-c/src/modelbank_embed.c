@@ -0,0 +1,47 @@
+/*
+ * Turns a model bank file (see modelbank_save()) into C source with the
+ * same models as static tables, for builds that should start up without
+ * reading any files.
+ *
+ * Usage: modelbank_embed bank.wmb name > name.c
+ *
+ * Compile name.c into the program and modelbank_lookup("name") finds the
+ * bank.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "modelbank.h"
+
+int main(int argc, char *argv[])
+{
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s bank.wmb name > name.c\n", argv[0]);
+    exit(1);
+  }
+
+  // name becomes a C identifier prefix
+  int identifier = argv[2][0] != '\0' && !isdigit((unsigned char)argv[2][0]);
+  for (const char *p = argv[2]; *p; p++)
+    identifier &= isalnum((unsigned char)*p) || *p == '_';
+  if (!identifier) {
+    fprintf(stderr, "'%s': name must be a C identifier\n", argv[2]);
+    exit(1);
+  }
+
+  struct modelbank *bank = modelbank_open(argv[1]);
+  if (!bank) {
+    fprintf(stderr, "%s: can't read model bank\n", argv[1]);
+    exit(1);
+  }
+
+  if (modelbank_emit(stdout, argv[2], bank->models, bank->n_models) || fflush(stdout)) {
+    perror("stdout");
+    exit(1);
+  }
+
+  modelbank_close(bank);
+  return 0;
+}
@@ -7,13 +7,19 @@
  * Usage: just run the binary, then hold down trigger to capture, release to
  * analyze.  Prints to stdout.
  *
+ * Or replay recorded gestures instead (see replay.h): quantizer_grab -r file
+ * [speed|asap], where speed 1 is real time.
+ *
  * I mentioned kludgy, right?  Good.
  *
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
 
@@ -24,6 +30,7 @@
 
 #include "util.h"
 #include "quantizer.h"
+#include "replay_cwiid.h"
 
 cwiid_mesg_callback_t cwiid_callback;
 
@@ -64,6 +71,14 @@ int main(int argc, char *argv[])
    * this program into a timestamping utility, such as tai64n(1) */
   setvbuf(stdout, NULL, _IOLBF, 0);
 
+  if (argc > 2 && !strcmp(argv[1], "-r")) {
+    if (replay_cwiid(argv[2], replay_speed(argv[3]), cwiid_callback)) {
+      fprintf(stderr, "%s: can't replay\n", argv[2]);
+      exit(1);
+    }
+    exit(0);
+  }
+
   cwiid_set_err(err);
 
   /* Connect to address given on command-line, if present */
@@ -349,8 +364,8 @@ void cwiid_callback(cwiid_wiimote_t *wiimote, int mesg_count,
       case CWIID_MESG_ACC:
 
 	if (button_state & 0x0004) {
-	  struct timeval now;
-	  gettimeofday(&now, NULL);
+	  /* When the report was made, by cwiid's clock or the replay's */
+	  struct timeval now = { timestamp->tv_sec, timestamp->tv_nsec / 1000 };
     /*
 	  printf("Acc Report: x=%d, y=%d, z=%d   %ld %ld\n",
 		 mesg[i].acc_mesg.acc[CWIID_X],
@@ -0,0 +1,76 @@
+/*
+ * Stands in for a wiimote on machines without one (or without Bluetooth):
+ * plays recorded gestures, see replay.h, through a cwiid message callback.
+ * Reports recorded together arrive in one call, as from cwiid, and the
+ * timestamp is when they were recorded, shifted to start now, so timing
+ * code sees the original spacing even when the replay runs faster.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "replay.h"
+#include "replay_cwiid.h"
+
+#define BATCH 16
+
+// "asap", or a speed factor: 1 is real time
+double replay_speed(const char *arg)
+{
+  if (!arg)
+    return 1;
+  if (!strcmp(arg, "asap"))
+    return REPLAY_ASAP;
+  return atof(arg) > 0 ? atof(arg) : 1;
+}
+
+int replay_cwiid(const char *path, double speed, cwiid_mesg_callback_t *callback)
+{
+  struct replay *replay = replay_load(path);
+  struct ring_event reports[BATCH];
+  union cwiid_mesg mesg[BATCH];
+  struct timespec epoch, timestamp;
+  long n_reports = 0;
+  int n;
+
+  if (!replay)
+    return -1;
+
+  clock_gettime(CLOCK_REALTIME, &epoch);
+  int64_t base = (int64_t)epoch.tv_sec * 1000000000 + epoch.tv_nsec;
+
+  replay_start(replay, speed);
+  while ((n = replay_next(replay, reports, BATCH)) > 0) {
+    for (int i = 0; i < n; i++) {
+      memset(&mesg[i], 0, sizeof(mesg[i]));
+      if (reports[i].type == RING_BUTTON) {
+        mesg[i].btn_mesg.type = CWIID_MESG_BTN;
+        mesg[i].btn_mesg.buttons = reports[i].buttons;
+      } else {
+        mesg[i].acc_mesg.type = CWIID_MESG_ACC;
+        mesg[i].acc_mesg.acc[CWIID_X] = reports[i].x;
+        mesg[i].acc_mesg.acc[CWIID_Y] = reports[i].y;
+        mesg[i].acc_mesg.acc[CWIID_Z] = reports[i].z;
+      }
+    }
+
+    int64_t t = base + reports[0].t;
+    timestamp.tv_sec = t / 1000000000;
+    timestamp.tv_nsec = t % 1000000000;
+    callback(NULL, n, mesg, &timestamp);
+    n_reports += n;
+  }
+
+  double wall = (ring_now() - replay->started) / 1e9;
+  printf("REPLAYED %d gestures, %ld reports (%.1fs recorded) in %.3fs: %.0f reports/s, "
+         "worst lateness %.3f ms\n",
+         replay->n_gestures, n_reports, replay_duration(replay) / 1e9, wall,
+         wall > 0 ? n_reports / wall : 0, replay->late / 1e6);
+
+  replay_free(replay);
+  return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef _replay_cwiid_h
+#define _replay_cwiid_h    1
+
+#include <cwiid.h>
+
+double replay_speed(const char *);
+int replay_cwiid(const char *, double, cwiid_mesg_callback_t *);
+
+#endif
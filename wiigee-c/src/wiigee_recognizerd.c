@@ -0,0 +1,101 @@
+/*
+ * Recognizes gestures for local clients, so front-ends (and load tests
+ * standing in for real controllers) don't have to link the library and
+ * load a model bank each.  See recognizerd.h for the protocol.
+ *
+ * Usage: wiigee-recognizerd [-s socket] [-t threads] [-p period_ms]
+ *                           [-c cadence_ms] [-m margin] [-e] bank
+ *
+ * bank is a model bank file, or the name of one compiled in.  The server
+ * itself is in recognizerd_server.h: every client session gets a
+ * recognition session, and a pool of workers classifies whichever
+ * sessions have samples waiting.  -c and -m turn on provisional results
+ * and early commits, see session_anytime().  -e has the sessions find the
+ * gestures in the samples by motion (see endpoint.h), for clients without
+ * a trigger.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "recognizerd.h"
+#include "recognizerd_server.h"
+
+static struct recognizerd_server *server;
+
+static void stop(int sig)
+{
+  recognizerd_server_stop(server);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *path = RECOGNIZERD_SOCKET;
+  struct modelbank *bank;
+  int64_t period = 100000000;   // ns, as hmm_grab's SAMPLE_PERIOD
+  int64_t cadence = 0;
+  double margin = 0;
+  int by_motion = 0;
+  int threads = 2;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:t:p:c:m:e")) != -1) {
+    switch (opt) {
+    case 's': path = optarg; break;
+    case 't': threads = atoi(optarg); break;
+    case 'p': period = atoll(optarg) * 1000000; break;
+    case 'c': cadence = atoll(optarg) * 1000000; break;
+    case 'm': margin = atof(optarg); break;
+    case 'e': by_motion = 1; break;
+    default: optind = argc + 1;
+    }
+  }
+  if (optind != argc - 1 || threads < 1 || period <= 0 || cadence < 0 || margin < 0) {
+    fprintf(stderr, "Usage: %s [-s socket] [-t threads] [-p period_ms] [-c cadence_ms] [-m margin] [-e] bank\n", argv[0]);
+    exit(1);
+  }
+
+  if (!(bank = modelbank_lookup(argv[optind])) && !(bank = modelbank_open(argv[optind]))) {
+    fprintf(stderr, "%s: can't read model bank\n", argv[optind]);
+    exit(1);
+  }
+
+  int listener = recognizerd_listen(path);
+  if (listener < 0) {
+    perror(path);
+    exit(1);
+  }
+
+  server = recognizerd_server_new(bank, listener, threads);
+  server->period = period;
+  server->cadence = cadence;
+  server->margin = margin;
+  server->by_motion = by_motion;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = stop;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("%s: %d models, %d workers\n", path, bank->n_models, threads);
+  fflush(stdout);
+
+  if (recognizerd_server_run(server))
+    perror("poll");
+
+  unsigned long segments = server->segments, samples = server->samples;
+  recognizerd_server_free(server);
+  unlink(path);
+
+  printf("%lu segments, %lu samples\n", segments, samples);
+  if (!bank->name)
+    modelbank_close(bank);
+  return 0;
+}
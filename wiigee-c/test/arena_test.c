@@ -0,0 +1,138 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "quantizer.h"
+#include "util.h"
+
+/*
+ * Checks the arena hands out zeroed, aligned, separate memory and grows the
+ * last allocation in place, and that arena_reset() really keeps the memory:
+ * a recognition round that overflowed a small first block leaves one block
+ * behind that the following rounds fit in, at the same address and with
+ * the same symbols as a round done on the heap.
+ */
+
+#define ROUNDS      5
+#define SAMPLES     400
+
+static int is_zero(const char *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (p[i])
+            return 0;
+    return 1;
+}
+
+static int basics(void)
+{
+    struct arena *arena = arena_new(256);
+    char *a = arena_alloc(arena, 10);
+    char *b = arena_alloc(arena, 100);
+    char *c = arena_alloc(arena, 1000);
+    int errors = 0;
+
+    if (!is_zero(a, 10) || !is_zero(b, 100) || !is_zero(c, 1000)) {
+        printf("ERROR: arena memory isn't zeroed\n");
+        errors++;
+    }
+    if ((uintptr_t)a % 16 || (uintptr_t)b % 16 || (uintptr_t)c % 16) {
+        printf("ERROR: arena memory isn't aligned\n");
+        errors++;
+    }
+    if (b < a + 10 && a < b + 100) {
+        printf("ERROR: arena allocations overlap\n");
+        errors++;
+    }
+
+    memset(a, 'a', 10);
+    memset(b, 'b', 100);
+    char *grown = arena_grow(arena, b, 100, 120);
+    if (grown != b && arena->blocks->next == NULL) {
+        printf("ERROR: the last allocation wasn't grown in place\n");
+        errors++;
+    }
+    char *moved = arena_grow(arena, a, 10, 50);
+    if (moved == a || memcmp(moved, "aaaaaaaaaa", 10) || !is_zero(moved + 10, 40)) {
+        printf("ERROR: growing an earlier allocation didn't copy it\n");
+        errors++;
+    }
+
+    arena_free(arena);
+    return errors;
+}
+
+// What hmm_grab does with one gesture, in the arena or on the heap
+static struct observation *one_round(struct arena *arena)
+{
+    struct gesture *gesture = gesture_new_in(arena);
+
+    srand(32);
+    for (int j = 0; j < SAMPLES; j++)
+        gesture_append(gesture, 128 + rand() % 60 - 30, 128 + rand() % 60 - 30, 128 + rand() % 60 - 30);
+    gesture_minmax(gesture);
+
+    struct quantizer *quantizer = quantizer_new_in(arena, 8, MAP_SIZE, SEED_CIRCLE);
+    quantizer_trainCenteroids(quantizer, gesture);
+    struct observation *observation = quantizer_getObservationSequence(quantizer, gesture);
+
+    quantizer_free(quantizer);
+    gesture_free(gesture);
+    return observation;
+}
+
+int main(int argc, char **argv)
+{
+    struct arena *arena = arena_new(1024);
+    int errors = basics();
+
+    struct observation *heap = one_round(NULL);
+
+    char *data = NULL;
+    size_t first = 0, steady = 0;
+
+    for (int r = 0; r < ROUNDS; r++) {
+        struct observation *observation = one_round(arena);
+
+        if (observation->sequence_len != heap->sequence_len
+            || memcmp(observation->sequence, heap->sequence, heap->sequence_len)) {
+            printf("ERROR: round %d: the arena gave different symbols than the heap\n", r);
+            errors++;
+        }
+        if (r == 0) {
+            first = arena->used;
+            if (!arena->blocks->next) {
+                printf("ERROR: the first round didn't overflow the first block\n");
+                errors++;
+            }
+        } else if (r == 1) {
+            steady = arena->used;
+        }
+        if (r > 0 && (arena->blocks->next || arena->blocks->data != data || arena->used != steady)) {
+            printf("ERROR: round %d: %zu bytes in %s block, at %s address\n", r, arena->used,
+                   arena->blocks->next ? "a new" : "the kept", arena->blocks->data != data ? "another" : "the same");
+            errors++;
+        }
+
+        arena_reset(arena);
+        if (arena->blocks->next || arena->blocks->used || arena->used || arena->high_water != MAX(first, steady)) {
+            printf("ERROR: round %d: the reset left %s block, %zu bytes used, high water %zu\n", r,
+                   arena->blocks->next ? "more than one" : "one", arena->blocks->used, arena->high_water);
+            errors++;
+        }
+        if (arena->blocks->size < first) {
+            printf("ERROR: round %d: the kept block holds %zu of the %zu bytes a round takes\n",
+                   r, arena->blocks->size, first);
+            errors++;
+        }
+        data = arena->blocks->data;
+    }
+
+    observation_free(heap);
+    arena_free(arena);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#define _POSIX_C_SOURCE 200809L     // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "capture.h"
+#include "wmdump.h"
+#include "quantizer.h"
+
+/*
+ * Round-trips a small wmdump log through the binary capture format, and
+ * checks the 8-bit quantizer kernels against the struct gesture ones.
+ */
+
+static const char *log_text =
+  "Button Report: 0004\n"
+  "Acc Report: x=121, y=128, z=151   1244700070 407808\n"
+  "Acc Report: x=119, y=129, z=153   1244700070 413778\n"
+  "Acc Report: x=60, y=200, z=10   1244700070 428789\n"
+  "Acc Report: x=255, y=0, z=131   1244700071 2\n"
+  "Button Report: 0000\n"
+  "Button Report: 0004\n"
+  "Button Report: 0000\n"
+  "Button Report: 0004\n"
+  "Acc Report: x=1, y=2, z=3   1244700090 999999\n"
+  "Acc Report: x=4, y=5, z=6   1244700090 999990\n"
+  "Button Report: 0000\n";
+
+struct expect {
+  struct capture_writer *writer;
+  int64_t t[4];
+};
+
+static int add(void *ctx, const struct wmdump_segment *s)
+{
+  struct expect *e = ctx;
+  if (s->gesture == 0)
+    memcpy(e->t, s->t, sizeof(e->t));
+  capture_writer_add(e->writer, "mct", HAND_RIGHT, s->gesture, s->x, s->y, s->z, s->t, s->data_len);
+  return 0;
+}
+
+int main(int argc, char const* argv[])
+{
+  int errors = 0;
+  char text[] = "/tmp/capture_test.XXXXXX";
+  char user[16], hand[16];
+
+  int fd = mkstemp(text);
+  if (fd < 0 || write(fd, log_text, strlen(log_text)) < 0)
+    return 1;
+  close(fd);
+
+  if (wmdump_name("data/mct.right.txt", user, sizeof(user), hand, sizeof(hand))
+      || strcmp(user, "mct") || strcmp(hand, "right")) {
+    printf("ERROR: wmdump_name\n");
+    errors++;
+  }
+
+  struct expect e = { capture_writer_new() };
+  int segments = wmdump_parse(text, add, &e);
+  if (segments != 2) {
+    printf("ERROR: %d segments, expected 2\n", segments);
+    errors++;
+  }
+
+  char binary[64];
+  snprintf(binary, sizeof(binary), "%s.wgc", text);
+  if (capture_writer_save(e.writer, binary)) {
+    printf("ERROR: save failed\n");
+    return 1;
+  }
+  capture_writer_free(e.writer);
+
+  struct capture *c = capture_open(binary);
+  if (!c || capture_count(c) != 2) {
+    printf("ERROR: open failed\n");
+    return 1;
+  }
+
+  struct capture_view v;
+  int64_t t[4];
+  capture_get(c, 0, &v);
+  capture_timestamps(&v, t);
+  if (strcmp(v.user, "mct") || v.hand != HAND_RIGHT || v.gesture != 0 || v.data_len != 4
+      || v.x[2] != 60 || v.y[3] != 0 || v.z[3] != 131 || memcmp(t, e.t, sizeof(t))) {
+    printf("ERROR: gesture 0 didn't round-trip\n");
+    errors++;
+  }
+
+  capture_get(c, 1, &v);
+  capture_timestamps(&v, t);
+  if (v.gesture != 2 || v.data_len != 2 || v.x[1] != 4 || t[1] - t[0] != -9) {
+    printf("ERROR: gesture 2 didn't round-trip\n");
+    errors++;
+  }
+
+  // the view quantizes like its struct gesture copy, with or without a table
+  capture_get(c, 0, &v);
+  struct gesture *g = capture_gesture(&v, NULL);
+  struct quantizer *q = quantizer_new(8);
+  quantizer_trainCenteroids_u8(q, v.x, v.y, v.z, v.data_len);
+  for (int pass = 0; pass < 2; pass++) {
+    struct observation *a = quantizer_getObservationSequence(q, g);
+    struct observation *b = quantizer_getObservationSequence_u8(q, v.x, v.y, v.z, v.data_len);
+    if (a->sequence_len != b->sequence_len || memcmp(a->sequence, b->sequence, a->sequence_len)) {
+      printf("ERROR: 8-bit observation sequence differs (pass %d)\n", pass);
+      errors++;
+    }
+    observation_free(a);
+    observation_free(b);
+    quantizer_buildLookup(q, 0, 2);
+  }
+
+  quantizer_free(q);
+  gesture_free(g);
+  capture_close(c);
+
+  // not a capture file
+  if (capture_open(text)) {
+    printf("ERROR: opened a text file as a capture\n");
+    errors++;
+  }
+
+  unlink(text);
+  unlink(binary);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,61 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "circle_fixture.h"
+
+// Report i of a circle of the given kind
+void circle_report(int kind, int i, double *x, double *y, double *z)
+{
+    double a = 2 * 3.14159265358979 * i / CIRCLE_REPORTS;
+    double u = 128 + 30 * cos(a) + rand() % 5;
+    double v = 128 + 30 * sin(a) + rand() % 5;
+    double w = 128 + rand() % 5;
+
+    *x = kind == 0 ? u : kind == 1 ? w : v;
+    *y = kind == 0 ? v : kind == 1 ? u : w;
+    *z = kind == 0 ? w : kind == 1 ? v : u;
+}
+
+// A whole circle, into g, which is overwritten
+void circle_gesture(struct gesture *g, int kind)
+{
+    double x, y, z;
+
+    memset(g, 0, sizeof(*g));
+    for (int i = 0; i < CIRCLE_REPORTS; i++) {
+        circle_report(kind, i, &x, &y, &z);
+        gesture_append(g, x, y, z);
+    }
+    gesture_minmax(g);
+}
+
+// CIRCLE_SET circles of kind k into sets[k], for each of n_kinds kinds
+void circle_sets(struct gesture (*sets)[CIRCLE_SET], int n_kinds)
+{
+    for (int k = 0; k < n_kinds; k++)
+        for (int i = 0; i < CIRCLE_SET; i++)
+            circle_gesture(&sets[k][i], k);
+}
+
+// Model k on sets[k], all over one codebook (see gesturemodel_trainShared())
+void circle_train(struct gesturemodel **models, int n_models, struct gesture (*sets)[CIRCLE_SET])
+{
+    struct gesture *shared[n_models];
+    int lens[n_models];
+
+    for (int k = 0; k < n_models; k++) {
+        shared[k] = sets[k];
+        lens[k] = CIRCLE_SET;
+    }
+    gesturemodel_trainShared(models, n_models, shared, lens);
+}
+
+void circle_free(struct gesture (*sets)[CIRCLE_SET], int n_kinds)
+{
+    for (int k = 0; k < n_kinds; k++)
+        for (int i = 0; i < CIRCLE_SET; i++)
+            free(sets[k][i].data);
+}
@@ -0,0 +1,24 @@
+// vim:set ts=4 sw=4 ai et:
+
+#ifndef _circle_fixture_h
+#define _circle_fixture_h    1
+
+#include "gesturemodel.h"
+
+/*
+ * Test vocabulary shared by the tests that need trained models: noisy
+ * circles drawn in the xy, yz or zx plane (the kind, 0 to 2), around 128
+ * like raw reports, but not rounded to them.  Everything comes from
+ * rand(), so srand() first for a repeatable fixture.
+ */
+
+#define CIRCLE_REPORTS  40      // Per circle
+#define CIRCLE_SET      6       // Training circles per kind
+
+void circle_report(int, int, double *, double *, double *);
+void circle_gesture(struct gesture *, int);
+void circle_sets(struct gesture (*)[CIRCLE_SET], int);
+void circle_train(struct gesturemodel **, int, struct gesture (*)[CIRCLE_SET]);
+void circle_free(struct gesture (*)[CIRCLE_SET], int);
+
+#endif
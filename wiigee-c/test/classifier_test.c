@@ -0,0 +1,100 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "classifier.h"
+#include "circle_fixture.h"
+
+/*
+ * A vocabulary trained with gesturemodel_trainShared() has to share one
+ * codebook, so the classifier quantizes once per sample; a model trained
+ * on its own adds a second.  Either way classifying has to give what the
+ * bayes decision over every model's matches() gives.  The codebooks are
+ * seeded k-means++, as the circles are centred on 128.
+ */
+
+#define PROBES  12
+
+static int check(struct classifier *classifier, struct gesture *probes, const char *name)
+{
+    int n = classifier->n_models;
+    int errors = 0;
+
+    for (int i = 0; i < PROBES; i++) {
+        double got[n], expected[n], raw[n];
+
+        for (int m = 0; m < n; m++)
+            raw[m] = matches(classifier->models[m], &probes[i]);
+        int want = classifier_decide(classifier->models, n, raw, expected);
+        int m = classifier_classify(classifier, &probes[i], got);
+
+        if (m != want) {
+            printf("ERROR: %s: probe %d classified as %d, not %d\n", name, i, m, want);
+            errors++;
+        }
+        for (int k = 0; k < n; k++) {
+            if (got[k] != expected[k]) {
+                printf("ERROR: %s: probe %d, model %d: posterior %g, not %g\n", name, i, k, got[k], expected[k]);
+                errors++;
+            }
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture sets[3][CIRCLE_SET];
+    struct gesture probes[PROBES];
+    struct gesturemodel *models[4];
+    int errors = 0;
+
+    srand(30);
+    circle_sets(sets, 3);
+    for (int i = 0; i < PROBES; i++)
+        circle_gesture(&probes[i], i % 3);
+
+    struct classifier *classifier = classifier_new();
+    if (classifier_codebooks(classifier) != 0 || classifier_classify(classifier, &probes[0], NULL) != -1) {
+        printf("ERROR: an empty classifier has codebooks or recognizes something\n");
+        errors++;
+    }
+
+    for (int k = 0; k < 4; k++)
+        models[k] = gesturemodel_new_sized(k, 8, MAP_SIZE, SEED_KMEANSPP);
+    circle_train(models, 3, sets);
+    for (int k = 0; k < 3; k++)
+        classifier_add(classifier, models[k]);
+
+    if (classifier_codebooks(classifier) != 1) {
+        printf("ERROR: shared training left %d codebooks, not 1\n", classifier_codebooks(classifier));
+        errors++;
+    }
+    errors += check(classifier, probes, "shared");
+
+    int right = 0;
+    for (int i = 0; i < PROBES; i++)
+        right += classifier_classify(classifier, &probes[i], NULL) == i % 3;
+    if (right < PROBES - 1) {
+        printf("ERROR: only %d of %d circles recognized\n", right, PROBES);
+        errors++;
+    }
+
+    // A model with a codebook of its own
+    gesturemodel_train(models[3], sets[1], CIRCLE_SET);
+    classifier_add(classifier, models[3]);
+    if (classifier_codebooks(classifier) != 2) {
+        printf("ERROR: %d codebooks with a separate model, not 2\n", classifier_codebooks(classifier));
+        errors++;
+    }
+    errors += check(classifier, probes, "separate");
+
+    classifier_free(classifier);
+    for (int k = 0; k < 4; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    for (int i = 0; i < PROBES; i++)
+        free(probes[i].data);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+// vim:set ts=4 sw=4 ai et:
+
+/*
+ * Checks that the struct-of-arrays and raw 8-bit paths quantize every
+ * sample to exactly the symbol the struct gesture path and
+ * quantizer_symbol() give: random reports, fractional samples, and the
+ * points right at and next to the midpoint of every two centroids, where
+ * the distances (nearly) tie and the lower index has to win.  For a
+ * trained codebook and one moved onto even coordinates, so that the
+ * midpoints are exact ties, with and without a lookup table.  And a sample
+ * whose squared distances to two centroids differ, but not their roots,
+ * which is a tie too.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "quantizer.h"
+#include "gesture_soa.h"
+
+#define RANDOM      2000
+
+static int compare(struct quantizer *q, struct gesture *g,
+                   const uint8_t *x, const uint8_t *y, const uint8_t *z, const char *name)
+{
+    struct gesture_soa *soa = gesture_soa_from(g);
+    struct observation *aos = quantizer_getObservationSequence(q, g);
+    struct observation *columns = quantizer_getObservationSequence_soa(q, soa);
+    struct observation *raw = x ? quantizer_getObservationSequence_u8(q, x, y, z, g->data_len) : NULL;
+    int errors = 0;
+
+    for (int j = 0; j < g->data_len; j++) {
+        int want = quantizer_symbol(q, g->data[j].x, g->data[j].y, g->data[j].z);
+
+        if (aos->sequence[j] != want || columns->sequence[j] != want || (raw && raw->sequence[j] != want)) {
+            printf("ERROR: %s: (%.9g, %.9g, %.9g) is %d, struct gesture says %d, soa %d, u8 %d\n",
+                   name, g->data[j].x, g->data[j].y, g->data[j].z, want, aos->sequence[j],
+                   columns->sequence[j], raw ? raw->sequence[j] : -1);
+            errors++;
+        }
+    }
+
+    observation_free(aos);
+    observation_free(columns);
+    if (raw)
+        observation_free(raw);
+    gesture_soa_free(soa);
+    return errors;
+}
+
+// Every midpoint and its neighbours along x, all exact in float
+static struct gesture *midpoints(struct quantizer *q)
+{
+    struct gesture *g = gesture_new();
+
+    for (int a = 0; a < q->map_size; a++) {
+        for (int b = a + 1; b < q->map_size; b++) {
+            float m[3];
+
+            for (int axis = 0; axis < 3; axis++)
+                m[axis] = (q->map[a][axis] + q->map[b][axis]) / 2;
+            gesture_append(g, m[0], m[1], m[2]);
+            gesture_append(g, nextafterf(m[0], 0), m[1], m[2]);
+            gesture_append(g, nextafterf(m[0], 256), m[1], m[2]);
+        }
+    }
+    for (int j = 0; j < RANDOM; j++)
+        gesture_append(g, 40 + rand() % 1760 / 8.0, 40 + rand() % 1760 / 8.0, 40 + rand() % 1760 / 8.0);
+    gesture_minmax(g);
+    return g;
+}
+
+// How many samples are exactly as far from two nearest centroids
+static int ties(struct quantizer *q, struct gesture *g)
+{
+    int ties = 0;
+
+    for (int j = 0; j < g->data_len; j++) {
+        double d[q->map_size], smallest = INFINITY;
+        int n = 0;
+
+        for (int i = 0; i < q->map_size; i++) {
+            d[i] = sqrt(pow(q->map[i][0] - g->data[j].x, 2) + pow(q->map[i][1] - g->data[j].y, 2)
+                        + pow(q->map[i][2] - g->data[j].z, 2));
+            smallest = fmin(smallest, d[i]);
+        }
+        for (int i = 0; i < q->map_size; i++)
+            n += d[i] == smallest;
+        ties += n > 1;
+    }
+    return ties;
+}
+
+static int check(struct quantizer *q, const char *name, int *n_ties)
+{
+    uint8_t x[RANDOM], y[RANDOM], z[RANDOM];
+    struct gesture *reports = gesture_new();
+    struct gesture *g = midpoints(q);
+    char what[64];
+    int errors = 0;
+
+    for (int j = 0; j < RANDOM; j++) {
+        x[j] = rand() % 256;
+        y[j] = rand() % 256;
+        z[j] = rand() % 256;
+        gesture_append(reports, x[j], y[j], z[j]);
+    }
+    gesture_minmax(reports);
+    *n_ties = ties(q, g);
+
+    snprintf(what, sizeof(what), "%s, no table", name);
+    errors += compare(q, g, NULL, NULL, NULL, what);
+    errors += compare(q, reports, x, y, z, what);
+
+    quantizer_buildLookup(q, 0, 2);
+    snprintf(what, sizeof(what), "%s, table", name);
+    errors += compare(q, g, NULL, NULL, NULL, what);
+    errors += compare(q, reports, x, y, z, what);
+    quantizer_dropLookup(q);
+
+    gesture_free(reports);
+    gesture_free(g);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture *training = gesture_new();
+    int errors = 0, n_ties;
+
+    srand(33);
+    for (int j = 0; j < 600; j++)
+        gesture_append(training, 128 + rand() % 100 - 50, 128 + rand() % 100 - 50, 128 + rand() % 100 - 50);
+    gesture_minmax(training);
+
+    struct quantizer *q = quantizer_new_sized(8, MAP_SIZE, SEED_KMEANSPP);
+    quantizer_trainCenteroids(q, training);
+    errors += check(q, "trained", &n_ties);
+
+    for (int i = 0; i < q->map_size; i++)
+        for (int axis = 0; axis < 3; axis++)
+            q->map[i][axis] = 2 * round(q->map[i][axis] / 2);
+    errors += check(q, "even", &n_ties);
+    if (n_ties == 0) {
+        printf("ERROR: none of the even midpoints is a tie\n");
+        errors++;
+    }
+
+    // 1 and 1 + 2^-52 both have the root 1, so centroid 0 wins
+    struct gesture *probe = gesture_new();
+    gesture_append(probe, 100, 100, 100);
+    for (int i = 0; i < q->map_size; i++) {
+        q->map[i][0] = 20 * i;
+        q->map[i][1] = q->map[i][2] = 0;
+    }
+    q->map[0][0] = 101, q->map[0][1] = 100 + ldexp(1, -26), q->map[0][2] = 100;
+    q->map[1][0] = 101, q->map[1][1] = 100, q->map[1][2] = 100;
+    if (quantizer_symbol(q, 100, 100, 100) != 0) {
+        printf("ERROR: the same roots didn't tie\n");
+        errors++;
+    }
+    errors += compare(q, probe, NULL, NULL, NULL, "same root");
+
+    gesture_free(probe);
+    quantizer_free(q);
+    gesture_free(training);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#define _POSIX_C_SOURCE 200809L     // mkdtemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "corpus.h"
+
+/*
+ * Loads a small directory of captures on several threads and checks the
+ * gestures land in file order with the right labels and indices.
+ */
+
+static void put(const char *dir, const char *name, int gestures, int base)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  for (int g = 0; g < gestures; g++) {
+    fprintf(f, "Button Report: 0004\n");
+    for (int i = 0; i <= g; i++)
+      fprintf(f, "Acc Report: x=%d, y=%d, z=%d   1244700070 %d\n", base + g, i, 7, 1000 * i);
+    fprintf(f, "Button Report: 0000\n");
+  }
+  fclose(f);
+}
+
+int main(int argc, char const* argv[])
+{
+  char dir[] = "/tmp/corpus_test.XXXXXX";
+  int errors = 0;
+
+  if (!mkdtemp(dir))
+    return 1;
+
+  put(dir, "bob.left.txt", 3, 10);
+  put(dir, "alice.right.txt", 2, 20);
+  put(dir, "alice.left.txt", 4, 30);
+  put(dir, "notes", 1, 0);      // not a .txt file, ignored
+
+  struct corpus *c = corpus_load_dir(dir, 3);
+
+  if (!c || c->n_files != 3 || c->n_failed || c->n_users != 2 || c->n_gestures != 9 || c->n_samples != 19) {
+    printf("ERROR: loaded the wrong things\n");
+    if (c)
+      corpus_report(c, stdout);
+    return 1;
+  }
+
+  // files in name order: alice.left, alice.right, bob.left
+  int alice = corpus_user(c, "alice"), bob = corpus_user(c, "bob"), n;
+  const int *left = corpus_select(c, alice, HAND_LEFT, &n);
+  if (alice != 0 || bob != 1 || n != 4 || left[0] != 0 || c->gestures[left[3]].x[0] != 33) {
+    printf("ERROR: alice's left hand\n");
+    errors++;
+  }
+  const int *right = corpus_select(c, alice, HAND_RIGHT, &n);
+  if (n != 2 || right[1] != 5 || c->gestures[5].data_len != 2 || c->gestures[5].t[1] != 1244700070001000LL) {
+    printf("ERROR: alice's right hand\n");
+    errors++;
+  }
+  corpus_select(c, bob, HAND_RIGHT, &n);
+  if (n != 0 || corpus_user(c, "carol") != -1) {
+    printf("ERROR: found gestures nobody made\n");
+    errors++;
+  }
+
+  corpus_free(c);
+
+  const char *missing[] = { "/nonexistent/dan.left.txt" };
+  c = corpus_load(missing, 1, 0);
+  if (c->n_failed != 1 || c->n_gestures != 0) {
+    printf("ERROR: missing file not counted as failed\n");
+    errors++;
+  }
+  corpus_free(c);
+
+  char cmd[300];
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+  system(cmd);
+
+  return errors ? 1 : 0;
+}
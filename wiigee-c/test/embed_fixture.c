@@ -0,0 +1,84 @@
+/* Generated by modelbank_emit(). Models: 2, codebooks: 1. */
+
+#include <math.h>
+
+#include "modelbank.h"
+
+static const double embed_fixture_codebook0_map[12] = {
+    0x1.9p+6, 0x1p+7, 0x1.2cp+7, 0x1.9092492492492p+6,
+    0x1.ff9999999999ap+6, 0x1.2c0000000897p+7, 0x1.9124924924925p+6, 0x1.ff33333333333p+6,
+    0x1.2c000000112e1p+7, 0x1.91b6db6db6db7p+6, 0x1.feccccccccccdp+6, 0x1.2c00000019c51p+7,
+};
+static const long embed_fixture_codebook0_counts[4] = {
+    1000, 1001, 1002, 1003,
+};
+
+static const double embed_fixture_model0_initial[3] = {
+    0x1p+0, 0x0p+0, 0x0p+0,
+};
+static const double embed_fixture_model0_change[9] = {
+    0x1.5555555555555p-2, 0x1.5555555555555p-2, 0x1.5555555555555p-2, 0x0p+0,
+    0x1p-1, 0x1p-1, 0x0p+0, 0x0p+0,
+    0x1p+0,
+};
+static const double embed_fixture_model0_emit[12] = {
+    0x1.999999999999ap-4, 0x1.999999999999ap-3, 0x1.3333333333333p-2, 0x1.999999999999ap-2,
+    0x1.999999999999ap-3, 0x1.3333333333333p-2, 0x1.999999999999ap-2, 0x1.999999999999ap-4,
+    0x1.3333333333333p-2, 0x1.999999999999ap-2, 0x1.999999999999ap-4, 0x1.999999999999ap-3,
+};
+
+static const double embed_fixture_model1_initial[3] = {
+    0x1p+0, 0x0p+0, 0x0p+0,
+};
+static const double embed_fixture_model1_change[9] = {
+    0x1.5555555555555p-2, 0x1.5555555555555p-2, 0x1.5555555555555p-2, 0x0p+0,
+    0x1p-1, 0x1p-1, 0x0p+0, 0x0p+0,
+    0x1p+0,
+};
+static const double embed_fixture_model1_emit[12] = {
+    0x1.999999999999ap-3, 0x1.3333333333333p-2, 0x1.999999999999ap-2, 0x1.999999999999ap-4,
+    0x1.3333333333333p-2, 0x1.999999999999ap-2, 0x1.999999999999ap-4, 0x1.999999999999ap-3,
+    0x1.999999999999ap-2, 0x1.999999999999ap-4, 0x1.999999999999ap-3, 0x1.3333333333333p-2,
+};
+
+static struct quantizer embed_fixture_quantizers[1] = {
+    { .radius = 0x1.5555555555555p-2, .states = 3, .map_size = 4, .seeding = 0, .seed = 1,
+      .map = (double (*)[3])embed_fixture_codebook0_map, .counts = (long *)embed_fixture_codebook0_counts,
+      .initialized = 1, .refs = 2 },
+};
+
+static HmmState embed_fixture_hmms[2] = {
+    { .numStates = 3, .numObservations = 4, .p_initial = (double *)embed_fixture_model0_initial,
+      .p_change = (double *)embed_fixture_model0_change, .p_emit = (double *)embed_fixture_model0_emit },
+    { .numStates = 3, .numObservations = 4, .p_initial = (double *)embed_fixture_model1_initial,
+      .p_change = (double *)embed_fixture_model1_change, .p_emit = (double *)embed_fixture_model1_emit },
+};
+
+static struct gesturemodel embed_fixture_storage[2] = {
+    { .states = 3, .observations = 4, .id = 1, .quantizer = &embed_fixture_quantizers[0],
+      .hmm = &embed_fixture_hmms[0], .defaultprobability = 0x1.56e1fc2f8f359p-997 },
+    { .states = 3, .observations = 4, .id = 2, .quantizer = &embed_fixture_quantizers[0],
+      .hmm = &embed_fixture_hmms[1], .defaultprobability = 0x1.56e1fc2f8f359p-996 },
+};
+
+static struct gesturemodel *embed_fixture_models[2] = {
+    &embed_fixture_storage[0], &embed_fixture_storage[1],
+};
+
+struct modelbank embed_fixture = {
+    .name = "embed_fixture",
+    .models = embed_fixture_models,
+    .n_models = 2,
+    .model_storage = embed_fixture_storage,
+    .quantizers = embed_fixture_quantizers,
+    .n_codebooks = 1,
+    .hmms = embed_fixture_hmms,
+};
+
+#if defined(__GNUC__)
+static void embed_fixture_register(void) __attribute__((constructor));
+static void embed_fixture_register(void)
+{
+    modelbank_register(&embed_fixture);
+}
+#endif
@@ -0,0 +1,87 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "modelbank.h"
+#include "util.h"
+
+/*
+ * embed_fixture.c is modelbank_emit() output for the vocabulary built by
+ * make_models() below (regenerate it with "embed_test --emit").  Checks the
+ * compiled-in copy registered itself and matches the original exactly.
+ */
+
+// Two 3-state models over one 4-symbol codebook, with awkward values
+static void make_models(struct gesturemodel **models)
+{
+    models[0] = gesturemodel_new_sized(1, 3, 4, SEED_CIRCLE);
+    models[1] = gesturemodel_new_sized(2, 3, 4, SEED_CIRCLE);
+    quantizer_free(models[1]->quantizer);
+    models[1]->quantizer = quantizer_retain(models[0]->quantizer);
+
+    struct quantizer *q = models[0]->quantizer;
+    q->radius = 1.0 / 3;
+    for (int i = 0; i < 4; i++) {
+        q->map[i][0] = 100 + i / 7.0;
+        q->map[i][1] = 128 - i * 0.1;
+        q->map[i][2] = 150 + i * 1e-9;
+        q->counts[i] = 1000 + i;
+    }
+    q->initialized = 1;
+
+    for (int m = 0; m < 2; m++) {
+        HmmStateRef hmm = models[m]->hmm;
+        for (uint j = 0; j < 3; j++)
+            for (uint o = 0; o < 4; o++)
+                setEmitP(hmm, j, o, (1 + (j + o + m) % 4) / 10.0);
+        models[m]->defaultprobability = 1e-300 * (m + 1);
+    }
+}
+
+extern struct modelbank embed_fixture;
+
+int main(int argc, char **argv)
+{
+    struct gesturemodel *models[2];
+    int errors = 0;
+
+    make_models(models);
+
+    if (argc > 1)
+        return modelbank_emit(stdout, "embed_fixture", models, 2);
+
+    struct modelbank *bank = modelbank_lookup("embed_fixture");
+    if (bank != &embed_fixture || modelbank_lookup("nope"))
+        die("the fixture bank isn't registered\n");
+
+    if (bank->n_models != 2 || bank->models[0]->quantizer != bank->models[1]->quantizer) {
+        printf("ERROR: wrong shape\n");
+        errors++;
+    }
+
+    for (int m = 0; m < 2; m++) {
+        struct gesturemodel *a = models[m], *b = bank->models[m];
+        uint symbols[] = { 0, 1, 1, 3, 2, 2, 0, 3 };
+        StateSequenceRef seq = createStateSequence(symbols, 8);
+
+        if (a->id != b->id || a->defaultprobability != b->defaultprobability
+            || a->quantizer->radius != b->quantizer->radius
+            || getProbability(a->hmm, seq) != getProbability(b->hmm, seq)) {
+            printf("ERROR: model %d differs\n", m);
+            errors++;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (quantizer_symbol(a->quantizer, 100, 128 - i, 150) != quantizer_symbol(b->quantizer, 100, 128 - i, 150)
+                || a->quantizer->map[i][2] != b->quantizer->map[i][2]) {
+                printf("ERROR: codebook entry %d differs\n", i);
+                errors++;
+            }
+        }
+        releaseStateSequence(seq);
+    }
+
+    gesturemodel_free(models[0]);
+    gesturemodel_free(models[1]);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "endpoint.h"
+#include "session.h"
+
+/*
+ * Streams of a resting controller (gravity on z, a unit or so of sensor
+ * noise) with bursts of motion in them.  Every burst long enough has to
+ * come out as one press/reports/release segment covering it, and nothing
+ * else: short twitches and the stretches at rest are dropped, bursts
+ * longer than max_len are cut.
+ */
+
+#define PERIOD      10000000LL  // 100Hz, in ns
+#define MAX_STREAM  4000
+
+struct burst {
+    int start, len;
+};
+
+struct stream {
+    struct ring_event reports[MAX_STREAM];
+    int n;
+};
+
+static void make_stream(struct stream *s, int n, const struct burst *bursts, int n_bursts)
+{
+    s->n = n;
+    for (int i = 0; i < n; i++) {
+        double a[3] = { 0, 0, 0 };
+
+        for (int b = 0; b < n_bursts; b++) {
+            int k = i - bursts[b].start;
+            if (k >= 0 && k < bursts[b].len) {
+                a[0] = 30 * sin(k * 0.3);
+                a[1] = 30 * cos(k * 0.3);
+            }
+        }
+        struct ring_event e = { (int64_t)i * PERIOD, RING_ACC, 0,
+                                128 + a[0] + rand() % 3 - 1,
+                                128 + a[1] + rand() % 3 - 1,
+                                153 + rand() % 3 - 1, 0 };
+        s->reports[i] = e;
+    }
+}
+
+struct segment {
+    int64_t start, end;         // Press and release
+    int reports;
+    int64_t first, last;        // Of the reports
+};
+
+// Run the stream through, checking the events are well formed; -1 if not
+static int segments(struct endpoint *e, struct stream *s, struct segment *out, int max, int flush)
+{
+    struct ring_event events[ENDPOINT_MAX_OUT];
+    int n_segments = 0, in = 0;
+
+    for (int i = 0; i <= s->n; i++) {
+        int n;
+
+        if (i < s->n)
+            n = endpoint_push(e, &s->reports[i], events);
+        else if (flush)
+            n = endpoint_flush(e, events);
+        else
+            break;
+
+        for (int k = 0; k < n; k++) {
+            struct ring_event *ev = &events[k];
+
+            if (ev->type == RING_BUTTON && ev->buttons == ENDPOINT_BUTTONS && !in && n_segments < max) {
+                out[n_segments] = (struct segment){ ev->t, 0, 0, -1, -1 };
+                in = 1;
+            } else if (ev->type == RING_BUTTON && ev->buttons == 0 && in) {
+                out[n_segments++].end = ev->t;
+                in = 0;
+            } else if (ev->type == RING_ACC && ev->buttons == ENDPOINT_BUTTONS && in) {
+                struct segment *seg = &out[n_segments];
+                if (seg->first < 0)
+                    seg->first = ev->t;
+                else if (ev->t <= seg->last)
+                    return -1;
+                seg->last = ev->t;
+                seg->reports++;
+            } else {
+                return -1;
+            }
+        }
+    }
+    return in ? -1 : n_segments;
+}
+
+// Each burst found once, starting a little before and ending a little after
+static int check_bursts(const char *name, struct endpoint *e, const struct burst *bursts, int n_bursts,
+                        struct segment *found, int n_found)
+{
+    int errors = 0;
+
+    if (n_found != n_bursts) {
+        printf("ERROR: %s: %d segments, expected %d\n", name, n_found, n_bursts);
+        return 1;
+    }
+    for (int b = 0; b < n_bursts; b++) {
+        int64_t start = (int64_t)bursts[b].start * PERIOD;
+        int64_t end = (int64_t)(bursts[b].start + bursts[b].len) * PERIOD;
+        struct segment *seg = &found[b];
+
+        if (seg->start != seg->first || seg->first > start || seg->first < start - (e->preroll + 2) * PERIOD
+            || seg->last < end - 2 * PERIOD || seg->last > end + e->hangover * PERIOD
+            || seg->end != seg->last || seg->reports != (seg->last - seg->first) / PERIOD + 1) {
+            printf("ERROR: %s: burst %d (%lld-%lld) came out as %lld-%lld, %d reports\n", name, b,
+                   (long long)start, (long long)end, (long long)seg->first, (long long)seg->last, seg->reports);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static int gestures;
+static int64_t starts[8], ends[8];
+
+static void collect(struct session *s, const struct session_result *r, void *ctx)
+{
+    if (r->kind == SESSION_FINAL && gestures < 8) {
+        starts[gestures] = r->start;
+        ends[gestures] = r->end;
+    }
+    gestures += r->kind == SESSION_FINAL;
+}
+
+int main(int argc, char **argv)
+{
+    static struct stream s;
+    struct segment found[16];
+    struct endpoint e;
+    int errors = 0, n;
+
+    srand(3);
+
+    // Two gestures, and a twitch too short to be one
+    struct burst bursts[] = { { 100, 80 }, { 300, 8 }, { 450, 50 } };
+    struct burst kept[] = { { 100, 80 }, { 450, 50 } };
+    make_stream(&s, 700, bursts, 3);
+    endpoint_init(&e);
+    n = segments(&e, &s, found, 16, 1);
+    errors += check_bursts("bursts", &e, kept, 2, found, n);
+    if (e.segments != 2 || e.too_short != 1 || e.cut != 0) {
+        printf("ERROR: bursts: counted %lu segments, %lu too short, %lu cut\n", e.segments, e.too_short, e.cut);
+        errors++;
+    }
+
+    // What wasn't let through was dropped, and counted
+    int reports = found[0].reports + found[1].reports;
+    if (e.at_rest + reports + e.n_held != 700 || e.at_rest < 500) {
+        printf("ERROR: bursts: %d reports out, %lu at rest, %d held of 700\n", reports, e.at_rest, e.n_held);
+        errors++;
+    }
+
+    // Too long: cut at max_len, and nothing more until the motion stops
+    struct burst long_burst[] = { { 50, 500 } };
+    make_stream(&s, 700, long_burst, 1);
+    endpoint_init(&e);
+    n = segments(&e, &s, found, 16, 1);
+    if (n != 1 || e.cut != 1 || found[0].first > 50 * PERIOD
+        || found[0].reports != e.max_len + (50 * PERIOD - found[0].first) / PERIOD) {
+        printf("ERROR: long: %d segments, %lu cut, %d reports\n", n, e.cut, n > 0 ? found[0].reports : 0);
+        errors++;
+    }
+
+    // A stream ending mid-gesture: the flush releases it
+    struct burst open_burst[] = { { 100, 200 } };
+    make_stream(&s, 200, open_burst, 1);
+    endpoint_init(&e);
+    if (segments(&e, &s, found, 16, 0) != -1) {
+        printf("ERROR: open: released before the end\n");
+        errors++;
+    }
+    endpoint_init(&e);
+    n = segments(&e, &s, found, 16, 1);
+    if (n != 1 || found[0].last != 199 * PERIOD) {
+        printf("ERROR: open: flush gave %d segments\n", n);
+        errors++;
+    }
+
+    // And through a session, which then needs no trigger
+    struct modelbank bank = { 0 };
+    struct session *session = session_new(0, &bank, PERIOD, 4096, collect, NULL);
+    make_stream(&s, 700, bursts, 3);
+    session_endpoint(session, NULL);
+    for (int i = 0; i < s.n; i++)
+        session_push(session, &s.reports[i]);
+    struct ring_event end = { s.reports[s.n - 1].t, RING_BUTTON, 0 };
+    session_push(session, &end);
+    session_process(session);
+
+    if (gestures != 2 || starts[0] > 100 * PERIOD || ends[0] < 179 * PERIOD
+        || starts[1] > 450 * PERIOD || ends[1] < 499 * PERIOD || ends[1] > 550 * PERIOD) {
+        printf("ERROR: session: %d gestures\n", gestures);
+        errors++;
+    }
+    session_free(session);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gesture.h"
+#include "observation.h"
+#include "arena.h"
+
+/*
+ * Appends long gestures and observations one element at a time and in
+ * bulk, on the heap and in an arena, checking nothing is lost on the way,
+ * that the buffers grow geometrically (a logarithmic number of times, and
+ * never to more than twice what's needed), and that a reserved buffer
+ * isn't moved by appending up to what was reserved.
+ */
+
+#define LONG        100000
+#define CHUNK       37
+
+static int check_growth(const char *name, int grown, int len, int cap)
+{
+    int most = 2;
+
+    for (int n = 16; n < len; n *= 2)
+        most++;
+    if (grown > most || cap < len || (len > 16 && cap > 2 * len)) {
+        printf("ERROR: %s: %d elements, capacity %d after growing %d times\n", name, len, cap, grown);
+        return 1;
+    }
+    return 0;
+}
+
+static int gestures(struct arena *arena, const char *name)
+{
+    struct gesture *one = gesture_new_in(arena);
+    struct gesture *bulk = gesture_new_in(arena);
+    struct coordinate chunk[CHUNK];
+    int errors = 0, grown = 0;
+
+    for (int i = 0; i < LONG; i++) {
+        int cap = one->data_cap;
+        gesture_append(one, i, -i, i * 0.5);
+        grown += one->data_cap != cap;
+    }
+    errors += check_growth(name, grown, one->data_len, one->data_cap);
+
+    // Nothing from nowhere appends nothing
+    gesture_append_many(bulk, NULL, 0);
+    if (bulk->data_len) {
+        printf("ERROR: %s: appending nothing left %d samples\n", name, bulk->data_len);
+        errors++;
+    }
+
+    for (int i = 0; i < LONG; i += CHUNK) {
+        int n = LONG - i < CHUNK ? LONG - i : CHUNK;
+        for (int k = 0; k < n; k++)
+            chunk[k] = (struct coordinate){ i + k, -(i + k), (i + k) * 0.5 };
+        gesture_append_many(bulk, chunk, n);
+    }
+
+    for (int i = 0; i < LONG; i++) {
+        struct coordinate *a = &one->data[i], *b = &bulk->data[i];
+        if (a->x != i || a->y != -i || a->z != i * 0.5 || a->x != b->x || a->y != b->y || a->z != b->z) {
+            printf("ERROR: %s: sample %d came out as (%g, %g, %g) and (%g, %g, %g)\n",
+                   name, i, a->x, a->y, a->z, b->x, b->y, b->z);
+            errors++;
+            break;
+        }
+    }
+    if (bulk->data_len != LONG) {
+        printf("ERROR: %s: bulk appends gave %d samples\n", name, bulk->data_len);
+        errors++;
+    }
+
+    struct gesture *reserved = gesture_new_in(arena);
+    gesture_reserve(reserved, 1000);
+    struct coordinate *data = reserved->data;
+    for (int i = 0; i < 1000; i++)
+        gesture_append(reserved, i, i, i);
+    if (reserved->data != data || reserved->data_cap != 1000) {
+        printf("ERROR: %s: a reserved gesture moved\n", name);
+        errors++;
+    }
+
+    gesture_free(one);
+    gesture_free(bulk);
+    gesture_free(reserved);
+    return errors;
+}
+
+static int observations(struct arena *arena, const char *name)
+{
+    struct observation *one = observation_new_in(arena);
+    struct observation *bulk = observation_new_in(arena);
+    uint8_t chunk[CHUNK];
+    int errors = 0, grown = 0;
+
+    for (int i = 0; i < LONG; i++) {
+        int cap = one->sequence_cap;
+        observation_append(one, i % 251);
+        grown += one->sequence_cap != cap;
+    }
+    errors += check_growth(name, grown, one->sequence_len, one->sequence_cap);
+
+    observation_append_many(bulk, NULL, 0);
+    if (bulk->sequence_len) {
+        printf("ERROR: %s: appending nothing left %d symbols\n", name, bulk->sequence_len);
+        errors++;
+    }
+
+    for (int i = 0; i < LONG; i += CHUNK) {
+        int n = LONG - i < CHUNK ? LONG - i : CHUNK;
+        for (int k = 0; k < n; k++)
+            chunk[k] = (i + k) % 251;
+        observation_append_many(bulk, chunk, n);
+    }
+
+    for (int i = 0; i < LONG; i++) {
+        if (one->sequence[i] != i % 251 || bulk->sequence[i] != i % 251) {
+            printf("ERROR: %s: symbol %d came out as %d and %d\n", name, i, one->sequence[i], bulk->sequence[i]);
+            errors++;
+            break;
+        }
+    }
+    if (bulk->sequence_len != LONG) {
+        printf("ERROR: %s: bulk appends gave %d symbols\n", name, bulk->sequence_len);
+        errors++;
+    }
+
+    struct observation *reserved = observation_new_in(arena);
+    observation_reserve(reserved, 1000);
+    uint8_t *sequence = reserved->sequence;
+    for (int i = 0; i < 1000; i++)
+        observation_append(reserved, i % 251);
+    if (reserved->sequence != sequence || reserved->sequence_cap != 1000) {
+        printf("ERROR: %s: a reserved observation moved\n", name);
+        errors++;
+    }
+
+    observation_free(one);
+    observation_free(bulk);
+    observation_free(reserved);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct arena *arena = arena_new(4096);
+    int errors = 0;
+
+    errors += gestures(NULL, "heap gesture");
+    errors += gestures(arena, "arena gesture");
+    errors += observations(NULL, "heap observation");
+    errors += observations(arena, "arena observation");
+
+    arena_free(arena);
+    return errors ? 1 : 0;
+}
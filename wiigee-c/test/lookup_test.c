@@ -0,0 +1,143 @@
+// vim:set ts=4 sw=4 ai et:
+
+/*
+ * Checks that quantizing through the precomputed lookup table gives exactly
+ * the symbols a brute-force nearest-centroid search does, at several
+ * coarsening levels, for samples on the grid, between its points and
+ * outside it (far outside the range of an int, too, and NaN); and prints
+ * the table footprints.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <float.h>
+
+#include "quantizer.h"
+#include "util.h"
+
+#define N_PROBES 200000
+#define N_OFF    20000
+
+// The closest centroid, the lower index on ties, without the quantizer's help
+static int brute_force(struct quantizer *q, double x, double y, double z)
+{
+    double smallest = DBL_MAX;
+    int best = -1;
+
+    for (int i = 0; i < q->map_size; i++) {
+        double d = sqrt((x - q->map[i][0]) * (x - q->map[i][0])
+                      + (y - q->map[i][1]) * (y - q->map[i][1])
+                      + (z - q->map[i][2]) * (z - q->map[i][2]));
+        if (d < smallest) {
+            smallest = d;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// A random coordinate between grid points, or off the grid's range
+static double off_grid(int i)
+{
+    switch (i % 5) {
+    case 0:  return rand() % 256 + (rand() % 999 + 1) / 1000.0;
+    case 1:  return -1 - rand() % 200;
+    case 2:  return 256 + rand() % 200;
+    case 3:  return 4294967296.0 + rand() % 256;    // (int) of that would be undefined
+    default: return -1e12 - rand();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    struct quantizer *quantizer = quantizer_new(8);
+    struct gesture *gesture = gesture_new();
+    int errors = 0;
+
+    // A gesture wandering around the rest value of a raw wiimote report
+    srand(42);
+    for (int i = 0; i < 500; i++)
+        gesture_append(gesture, 100 + rand() % 60, 100 + rand() % 60, 120 + rand() % 60);
+    gesture->minacc = 100;
+    gesture->maxacc = 180;
+
+    quantizer_trainCenteroids(quantizer, gesture);
+
+    int (*probes)[3] = xalloc(sizeof(*probes) * N_PROBES);
+    int *expected = xalloc(sizeof(int) * N_PROBES);
+    for (int i = 0; i < N_PROBES; i++) {
+        probes[i][0] = rand() % 256;
+        probes[i][1] = rand() % 256;
+        probes[i][2] = rand() % 256;
+        expected[i] = brute_force(quantizer, probes[i][0], probes[i][1], probes[i][2]);
+    }
+
+    // Samples between the grid points and out of its range; some on it, the rest not
+    double (*off)[3] = xalloc(sizeof(*off) * N_OFF);
+    int *off_expected = xalloc(sizeof(int) * N_OFF);
+    for (int i = 0; i < N_OFF; i++) {
+        off[i][0] = off_grid(i);
+        off[i][1] = i % 5 ? off_grid(i + 1) : rand() % 256;
+        off[i][2] = i % 7 ? off_grid(i + 2) : rand() % 256;
+        off_expected[i] = brute_force(quantizer, off[i][0], off[i][1], off[i][2]);
+    }
+
+    // A bad report's NaN gets whatever the full search makes of it
+    int nan_expected = quantizer_symbol(quantizer, NAN, 128, 128);
+
+    // Without a table first
+    for (int i = 0; i < N_PROBES; i++) {
+        int got = quantizer_symbol(quantizer, probes[i][0], probes[i][1], probes[i][2]);
+        if (got != expected[i]) {
+            printf("ERROR: no table, sample (%d, %d, %d): expected %d, got %d\n",
+                   probes[i][0], probes[i][1], probes[i][2], expected[i], got);
+            errors++;
+        }
+    }
+
+    for (int shift = 1; shift <= 5; shift++) {
+        long size = quantizer_buildLookup(quantizer, 0, shift);
+        printf("shift %d: %ld bytes, %d candidate lists\n", shift, size, quantizer->lookup->lists_len);
+
+        for (int i = 0; i < N_PROBES; i++) {
+            int got = quantizer_symbol(quantizer, probes[i][0], probes[i][1], probes[i][2]);
+            if (got != expected[i]) {
+                printf("ERROR: shift %d, sample (%d, %d, %d): expected %d, got %d\n",
+                       shift, probes[i][0], probes[i][1], probes[i][2], expected[i], got);
+                errors++;
+            }
+        }
+
+        // Off-grid samples must fall back to the full search
+        for (int i = 0; i < N_OFF; i++) {
+            int got = quantizer_symbol(quantizer, off[i][0], off[i][1], off[i][2]);
+            if (got != off_expected[i]) {
+                printf("ERROR: shift %d, off-grid sample (%g, %g, %g): expected %d, got %d\n",
+                       shift, off[i][0], off[i][1], off[i][2], off_expected[i], got);
+                errors++;
+            }
+        }
+
+        int got = quantizer_symbol(quantizer, NAN, 128, 128);
+        if (got != nan_expected) {
+            printf("ERROR: shift %d, NaN sample: expected %d, got %d\n", shift, nan_expected, got);
+            errors++;
+        }
+    }
+
+    // Retraining must not leave a stale table behind
+    quantizer_trainCenteroids(quantizer, gesture);
+    if (quantizer_lookupSize(quantizer) != 0) {
+        printf("ERROR: lookup table survived retraining\n");
+        errors++;
+    }
+
+    free(probes);
+    free(expected);
+    free(off);
+    free(off_expected);
+    quantizer_free(quantizer);
+    gesture_free(gesture);
+    return errors ? 1 : 0;
+}
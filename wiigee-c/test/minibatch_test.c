@@ -0,0 +1,141 @@
+// vim:set ts=4 sw=4 ai et:
+
+/*
+ * Checks that training a codebook one mini-batch at a time, from a stream
+ * of short gestures, ends up where batch k-means over the whole data does:
+ * on well separated clusters both have to land every centroid on the mean
+ * of one cluster.  And that refining a batch-trained codebook with the
+ * same data again leaves it there.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "quantizer.h"
+
+#define CLUSTERS    4
+#define BATCHES     50
+#define PER_BATCH   40
+#define TOLERANCE   1e-9
+
+static const double centres[CLUSTERS][3] = {
+    {  60, 128, 128 }, { 196, 128, 128 }, { 128,  60, 128 }, { 128, 128, 196 },
+};
+
+static struct gesture *batches[BATCHES];
+static double means[CLUSTERS][3];
+
+struct stream {
+    int next;
+};
+
+static struct gesture *next_batch(void *ctx)
+{
+    struct stream *stream = ctx;
+    return stream->next < BATCHES ? batches[stream->next++] : NULL;
+}
+
+// The cluster whose centre p is closest to
+static int cluster(const double *p)
+{
+    int best = 0;
+    double smallest = INFINITY;
+
+    for (int c = 0; c < CLUSTERS; c++) {
+        double d = 0;
+        for (int axis = 0; axis < 3; axis++)
+            d += (p[axis] - centres[c][axis]) * (p[axis] - centres[c][axis]);
+        if (d < smallest) {
+            smallest = d;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Every centroid on a different cluster's mean
+static int check(const char *name, struct quantizer *q)
+{
+    int taken[CLUSTERS] = { 0 };
+    int errors = 0;
+
+    for (int i = 0; i < q->map_size; i++) {
+        int c = cluster(q->map[i]);
+        double worst = 0;
+
+        for (int axis = 0; axis < 3; axis++)
+            worst = fmax(worst, fabs(q->map[i][axis] - means[c][axis]));
+
+        if (taken[c]++ || worst > TOLERANCE) {
+            printf("ERROR: %s: centroid %d (%g, %g, %g) is off cluster %d's mean (%g, %g, %g) by %g\n",
+                   name, i, q->map[i][0], q->map[i][1], q->map[i][2], c,
+                   means[c][0], means[c][1], means[c][2], worst);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture *all = gesture_new();
+    double sums[CLUSTERS][3] = { { 0 } };
+    int counts[CLUSTERS] = { 0 };
+    int errors = 0;
+
+    // Tight clusters far apart, their samples shuffled through the batches
+    srand(26);
+    for (int b = 0; b < BATCHES; b++) {
+        batches[b] = gesture_new();
+        for (int j = 0; j < PER_BATCH; j++) {
+            int c = b == 0 ? j % CLUSTERS : rand() % CLUSTERS;
+            double x = centres[c][0] + rand() % 7 - 3;
+            double y = centres[c][1] + rand() % 7 - 3;
+            double z = centres[c][2] + rand() % 7 - 3;
+
+            gesture_append(batches[b], x, y, z);
+            gesture_append(all, x, y, z);
+            sums[c][0] += x;
+            sums[c][1] += y;
+            sums[c][2] += z;
+            counts[c]++;
+        }
+        gesture_minmax(batches[b]);
+    }
+    gesture_minmax(all);
+    for (int c = 0; c < CLUSTERS; c++)
+        for (int axis = 0; axis < 3; axis++)
+            means[c][axis] = sums[c][axis] / counts[c];
+
+    // Batch k-means
+    struct quantizer *batch = quantizer_new_sized(8, CLUSTERS, SEED_KMEANSPP);
+    quantizer_trainCenteroids(batch, all);
+    errors += check("batch", batch);
+
+    // Mini-batches, seeded from the first
+    struct quantizer *streamed = quantizer_new_sized(8, CLUSTERS, SEED_KMEANSPP);
+    struct stream stream = { 0 };
+    quantizer_trainCenteroidsStream(streamed, next_batch, &stream);
+    errors += check("stream", streamed);
+
+    long absorbed = 0;
+    for (int i = 0; i < CLUSTERS; i++)
+        absorbed += streamed->counts[i];
+    if (absorbed != BATCHES * PER_BATCH) {
+        printf("ERROR: stream: absorbed %ld samples of %d\n", absorbed, BATCHES * PER_BATCH);
+        errors++;
+    }
+
+    // Refining the batch codebook with the same data again keeps the means
+    stream.next = 0;
+    quantizer_trainCenteroidsStream(batch, next_batch, &stream);
+    errors += check("refined", batch);
+
+    quantizer_free(batch);
+    quantizer_free(streamed);
+    for (int b = 0; b < BATCHES; b++)
+        gesture_free(batches[b]);
+    gesture_free(all);
+    return errors ? 1 : 0;
+}
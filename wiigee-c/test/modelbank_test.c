@@ -0,0 +1,94 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // mkstemp
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "modelbank.h"
+#include "util.h"
+#include "circle_fixture.h"
+
+/*
+ * Saves a small vocabulary (two models on a shared codebook, one on its
+ * own), maps it back in and checks the loaded models score exactly like
+ * the originals.
+ */
+
+int main(int argc, char **argv)
+{
+    int errors = 0;
+    struct gesture sets[3][CIRCLE_SET];
+    struct gesture probes[6];
+
+    srand(3);
+    circle_sets(sets, 3);
+    for (int i = 0; i < 6; i++)
+        circle_gesture(&probes[i], i % 3);
+
+    struct gesturemodel *models[3];
+    for (int k = 0; k < 3; k++)
+        models[k] = gesturemodel_new(k + 10);
+
+    circle_train(models, 2, sets);
+    gesturemodel_train(models[2], sets[2], CIRCLE_SET);
+
+    char path[] = "/tmp/modelbank_test.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+
+    if (modelbank_save(path, models, 3))
+        die("couldn't save %s\n", path);
+
+    struct modelbank *bank = modelbank_open(path);
+    if (!bank || bank->n_models != 3 || bank->n_codebooks != 2)
+        die("couldn't load %s back\n", path);
+
+    if (bank->models[0]->quantizer != bank->models[1]->quantizer
+        || bank->models[0]->quantizer == bank->models[2]->quantizer) {
+        printf("ERROR: codebook sharing not preserved\n");
+        errors++;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        struct gesturemodel *a = models[k], *b = bank->models[k];
+
+        if (a->id != b->id || a->defaultprobability != b->defaultprobability) {
+            printf("ERROR: model %d: id or default probability differs\n", k);
+            errors++;
+        }
+        for (int i = 0; i < 6; i++) {
+            if (matches(a, &probes[i]) != matches(b, &probes[i])) {
+                printf("ERROR: model %d scores probe %d differently\n", k, i);
+                errors++;
+            }
+        }
+    }
+
+    // Retraining a loaded model writes to its own copy, not the file
+    gesturemodel_train(bank->models[2], sets[0], CIRCLE_SET);
+    struct modelbank *again = modelbank_open(path);
+    if (!again || matches(again->models[2], &probes[2]) != matches(models[2], &probes[2])) {
+        printf("ERROR: retraining a loaded model changed the file\n");
+        errors++;
+    }
+    modelbank_close(again);
+    modelbank_close(bank);
+
+    // A truncated bank is refused
+    if (truncate(path, 100) || modelbank_open(path)) {
+        printf("ERROR: opened a truncated bank\n");
+        errors++;
+    }
+
+    unlink(path);
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    for (int i = 0; i < 6; i++)
+        free(probes[i].data);
+    return errors ? 1 : 0;
+}
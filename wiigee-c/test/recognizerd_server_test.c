@@ -0,0 +1,301 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // mkstemp
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "recognizerd.h"
+#include "recognizerd_server.h"
+#include "util.h"
+#include "circle_fixture.h"
+
+/*
+ * Runs the server in-process and has clients send a whole conversation,
+ * OPEN, SAMPLES, END and CLOSE, in a single write, so the CLOSE is read
+ * before any worker got to the samples.  Every client has to get its
+ * RESULT all the same, and so does one that hangs up instead of closing.
+ * Nearly all of the results have to name the circle that was sent (the
+ * codebook is seeded k-means++, as the circles are centred on 128).
+ *
+ * Then one client sends thousands of short segments and doesn't read its
+ * results until it's done, filling its socket (and likely its ring);
+ * meanwhile others still have to get theirs in time.  At the end it has
+ * to get every one of them.
+ *
+ * And one sends a sample from near the end of time after a circle: the
+ * circle gets its RESULT without the session resampling the gap, and so
+ * does the segment the sample starts.
+ */
+
+#define CLIENTS     20
+#define MS          1000000
+#define ID          30          // Of the first model
+#define SLOW        4000        // Segments the slow client sends
+#define SLOW_LEN    10          // Samples in each
+
+static char conversation[CLIENTS][4 * sizeof(struct recognizerd_header)
+                                  + CIRCLE_REPORTS * sizeof(struct recognizerd_sample)];
+
+// A frame appended at p; returns the end of it
+static char *put(char *p, int type, uint32_t session, const void *payload, uint32_t length)
+{
+    struct recognizerd_header header = { length, type, 0, session };
+
+    memcpy(p, &header, sizeof(header));
+    memcpy(p + sizeof(header), payload, length);
+    return p + sizeof(header) + length;
+}
+
+static size_t write_conversation(char *buf, uint32_t session, int kind, int close)
+{
+    struct recognizerd_sample samples[CIRCLE_REPORTS];
+    double x, y, z;
+    char *p = buf;
+
+    memset(samples, 0, sizeof(samples));
+    for (int i = 0; i < CIRCLE_REPORTS; i++) {
+        circle_report(kind, i, &x, &y, &z);
+        samples[i] = (struct recognizerd_sample){ 1000 * MS + 10 * MS * i, lround(x), lround(y), lround(z) };
+    }
+
+    p = put(p, RECOGNIZERD_OPEN, session, NULL, 0);
+    p = put(p, RECOGNIZERD_SAMPLES, session, samples, sizeof(samples));
+    p = put(p, RECOGNIZERD_END, session, NULL, 0);
+    if (close)
+        p = put(p, RECOGNIZERD_CLOSE, session, NULL, 0);
+    return p - buf;
+}
+
+// The first frame the server sends back, or type 0 if none comes in time
+static int answer(int fd, struct recognizerd_reader *reader, struct recognizerd_frame *frame)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    int got;
+
+    while ((got = recognizerd_next(reader, frame)) == 0) {
+        if (poll(&pfd, 1, 10000) != 1 || recognizerd_fill(reader, fd) <= 0)
+            return 0;
+    }
+    return got > 0 ? frame->header.type : 0;
+}
+
+static void *run(void *server)
+{
+    recognizerd_server_run(server);
+    return NULL;
+}
+
+static int slow_done;           // Only touched through __atomic builtins
+
+// The slow client's side: send everything, read nothing
+static void *send_slow(void *arg)
+{
+    int fd = *(int *)arg;
+    size_t length = 2 * sizeof(struct recognizerd_header) + sizeof(struct recognizerd_sample[SLOW_LEN]);
+    char *buf = xalloc(sizeof(struct recognizerd_header) + SLOW * length);
+    char *p = put(buf, RECOGNIZERD_OPEN, 0, NULL, 0);
+
+    for (int k = 0; k < SLOW; k++) {
+        struct recognizerd_sample samples[SLOW_LEN];
+        double x, y, z;
+
+        memset(samples, 0, sizeof(samples));
+        for (int i = 0; i < SLOW_LEN; i++) {
+            circle_report(k % 3, i * CIRCLE_REPORTS / SLOW_LEN, &x, &y, &z);
+            samples[i] = (struct recognizerd_sample){ 1000 * MS + 10 * MS * (k * SLOW_LEN + i),
+                                                      lround(x), lround(y), lround(z) };
+        }
+        p = put(p, RECOGNIZERD_SAMPLES, 0, samples, sizeof(samples));
+        p = put(p, RECOGNIZERD_END, 0, NULL, 0);
+    }
+
+    for (char *q = buf; q < p; ) {
+        ssize_t n = send(fd, q, p - q, MSG_NOSIGNAL);
+        if (n <= 0)
+            break;
+        q += n;
+    }
+    free(buf);
+    __atomic_store_n(&slow_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// One whole conversation, on its own connection; 0 if its RESULT came
+static int quick(const char *socket_path, uint32_t session)
+{
+    struct recognizerd_reader reader = { 0 };
+    struct recognizerd_frame frame = { { 0 } };
+    size_t length = write_conversation(conversation[0], session, session % 3, 1);
+    int fd = recognizerd_connect(socket_path);
+    int type = 0;
+
+    if (fd >= 0 && write(fd, conversation[0], length) == length)
+        type = answer(fd, &reader, &frame);
+    recognizerd_reader_free(&reader);
+    if (fd >= 0)
+        close(fd);
+    return type == RECOGNIZERD_RESULT && frame.header.session == session ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture sets[3][CIRCLE_SET];
+    struct gesturemodel *models[3];
+    int errors = 0;
+
+    srand(45);
+    circle_sets(sets, 3);
+    for (int k = 0; k < 3; k++)
+        models[k] = gesturemodel_new_sized(ID + k, 8, MAP_SIZE, SEED_KMEANSPP);
+    circle_train(models, 3, sets);
+
+    char bank_path[] = "/tmp/recognizerd_server_test.XXXXXX";
+    int fd = mkstemp(bank_path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+    if (modelbank_save(bank_path, models, 3))
+        die("couldn't save %s\n", bank_path);
+    struct modelbank *bank = modelbank_open(bank_path);
+    if (!bank)
+        die("couldn't load %s\n", bank_path);
+
+    char socket_path[64];
+    snprintf(socket_path, sizeof(socket_path), "%s.sock", bank_path);
+    int listener = recognizerd_listen(socket_path);
+    if (listener < 0)
+        die("couldn't listen at %s\n", socket_path);
+
+    struct recognizerd_server *server = recognizerd_server_new(bank, listener, 2);
+    server->period = 20 * MS;
+    pthread_t thread;
+    pthread_create(&thread, NULL, run, server);
+
+    // The last client hangs up rather than closing its session
+    int fds[CLIENTS];
+    for (int c = 0; c < CLIENTS; c++) {
+        size_t length = write_conversation(conversation[c], c, c % 3, c < CLIENTS - 1);
+
+        fds[c] = recognizerd_connect(socket_path);
+        if (fds[c] < 0 || write(fds[c], conversation[c], length) != length)
+            die("client %d couldn't send\n", c);
+        if (c == CLIENTS - 1)
+            shutdown(fds[c], SHUT_WR);
+    }
+
+    int results = 0, right = 0;
+    for (int c = 0; c < CLIENTS; c++) {
+        struct recognizerd_reader reader = { 0 };
+        struct recognizerd_frame frame = { { 0 } };
+        int type = answer(fds[c], &reader, &frame);
+
+        if (type != RECOGNIZERD_RESULT || frame.header.session != c) {
+            printf("ERROR: client %d got frame type %d for session %u, not its result\n",
+                   c, type, frame.header.session);
+            errors++;
+        } else {
+            struct recognizerd_result result;
+            struct recognizerd_score best;
+
+            memcpy(&result, frame.payload, sizeof(result));
+            memcpy(&best, (const char *)frame.payload + sizeof(result), sizeof(best));
+            results++;
+            right += result.n_scores == 3 && best.id == ID + c % 3;
+        }
+        recognizerd_reader_free(&reader);
+        close(fds[c]);
+    }
+    if (right < CLIENTS - 2) {
+        printf("ERROR: %d of %d results named the right circle\n", right, results);
+        errors++;
+    }
+
+    // A jump to near the end of time ends the circle first
+    struct recognizerd_sample late = { INT64_MAX - 1, 128, 128, 128 };
+    char *end = conversation[0] + write_conversation(conversation[0], 7, 1, 0) - sizeof(struct recognizerd_header);
+    end = put(end, RECOGNIZERD_SAMPLES, 7, &late, sizeof(late));
+    end = put(end, RECOGNIZERD_END, 7, NULL, 0);
+    end = put(end, RECOGNIZERD_CLOSE, 7, NULL, 0);
+
+    int jumper = recognizerd_connect(socket_path);
+    if (jumper < 0 || write(jumper, conversation[0], end - conversation[0]) != end - conversation[0])
+        die("the client jumping ahead couldn't send\n");
+    struct recognizerd_reader reader = { 0 };
+    for (int k = 0; k < 2; k++) {
+        struct recognizerd_frame frame = { { 0 } };
+        int type = answer(jumper, &reader, &frame);
+        int32_t samples = 0;
+
+        if (type == RECOGNIZERD_RESULT)
+            memcpy(&samples, frame.payload, sizeof(samples));
+        if (type != RECOGNIZERD_RESULT || frame.header.session != 7 || (k == 0 && samples > 2 * CIRCLE_REPORTS)) {
+            printf("ERROR: result %d after the jump: frame type %d, session %u, %d samples\n",
+                   k, type, frame.header.session, samples);
+            errors++;
+            break;
+        }
+    }
+    recognizerd_reader_free(&reader);
+    close(jumper);
+
+    // Others are answered while the slow client isn't reading
+    int slow = recognizerd_connect(socket_path);
+    if (slow < 0)
+        die("the slow client couldn't connect\n");
+    pthread_t sender;
+    pthread_create(&sender, NULL, send_slow, &slow);
+
+    int quicks = 0, after = 0;
+    while (after < 3 && quicks < 1000) {
+        after += __atomic_load_n(&slow_done, __ATOMIC_ACQUIRE);
+        if (quick(socket_path, 1000 + quicks++)) {
+            printf("ERROR: conversation %d got no result while the slow client sent\n", quicks - 1);
+            errors++;
+            break;
+        }
+    }
+    if (errors) {
+        // The sender may be stuck behind the stuck server
+        shutdown(slow, SHUT_RDWR);
+    } else {
+        struct recognizerd_reader reader = { 0 };
+        struct recognizerd_frame frame = { { 0 } };
+        int results = 0;
+
+        while (results < SLOW && answer(slow, &reader, &frame) == RECOGNIZERD_RESULT)
+            results++;
+        if (results != SLOW) {
+            printf("ERROR: the slow client got %d of its %d results\n", results, SLOW);
+            errors++;
+        }
+        recognizerd_reader_free(&reader);
+    }
+    pthread_join(sender, NULL);
+    close(slow);
+
+    recognizerd_server_stop(server);
+    pthread_join(thread, NULL);
+    unsigned long segments = CLIENTS + 2 + SLOW + quicks;
+    unsigned long sent = (CLIENTS + 1 + quicks) * CIRCLE_REPORTS + 1 + SLOW * SLOW_LEN;
+    if (!errors && (server->segments != segments || server->samples != sent)) {
+        printf("ERROR: the server counted %lu segments and %lu samples\n", server->segments, server->samples);
+        errors++;
+    }
+    recognizerd_server_free(server);
+
+    unlink(socket_path);
+    unlink(bank_path);
+    modelbank_close(bank);
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    return errors ? 1 : 0;
+}
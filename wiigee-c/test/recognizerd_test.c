@@ -0,0 +1,89 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200112L     // socketpair
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "recognizerd.h"
+
+/*
+ * Sends a client's side of a conversation down a socket pair, then feeds
+ * the bytes to a reader one at a time, checking the same frames come out
+ * whole, whatever the reads were split into; and that a frame claiming an
+ * absurd length is refused.
+ */
+
+#define SAMPLES 300
+
+int main(int argc, char **argv)
+{
+    int errors = 0;
+    int pair[2], pipefd[2];
+    struct recognizerd_sample samples[SAMPLES];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) || pipe(pipefd))
+        return 1;
+
+    memset(samples, 0, sizeof(samples));
+    for (int i = 0; i < SAMPLES; i++)
+        samples[i] = (struct recognizerd_sample){ 1000000LL * i, i, 2 * i, 255 - i };
+
+    if (recognizerd_send(pair[0], RECOGNIZERD_OPEN, 7, NULL, 0)
+        || recognizerd_send(pair[0], RECOGNIZERD_SAMPLES, 7, samples, sizeof(samples))
+        || recognizerd_send(pair[0], RECOGNIZERD_END, 7, NULL, 0)
+        || recognizerd_send(pair[0], RECOGNIZERD_CLOSE, 7, NULL, 0)) {
+        printf("ERROR: couldn't send\n");
+        return 1;
+    }
+    close(pair[0]);
+
+    static char bytes[65536];
+    int n = 0, got;
+    while ((got = read(pair[1], bytes + n, sizeof(bytes) - n)) > 0)
+        n += got;
+
+    struct recognizerd_reader reader = { 0 };
+    struct recognizerd_frame frame;
+    int types[4] = { RECOGNIZERD_OPEN, RECOGNIZERD_SAMPLES, RECOGNIZERD_END, RECOGNIZERD_CLOSE };
+    int frames = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (write(pipefd[1], &bytes[i], 1) != 1 || recognizerd_fill(&reader, pipefd[0]) != 1)
+            return 1;
+
+        while (recognizerd_next(&reader, &frame) == 1) {
+            if (frames >= 4 || frame.header.type != types[frames] || frame.header.session != 7) {
+                printf("ERROR: frame %d: type %d session %u\n", frames, frame.header.type, frame.header.session);
+                errors++;
+            } else if (frame.header.type == RECOGNIZERD_SAMPLES
+                       && (frame.header.length != sizeof(samples)
+                           || memcmp(frame.payload, samples, sizeof(samples)))) {
+                printf("ERROR: samples came through damaged\n");
+                errors++;
+            }
+            frames++;
+        }
+    }
+    if (frames != 4) {
+        printf("ERROR: %d frames, not 4\n", frames);
+        errors++;
+    }
+
+    struct recognizerd_header bogus = { RECOGNIZERD_MAX_PAYLOAD + 1, RECOGNIZERD_SAMPLES, 0, 7 };
+    if (write(pipefd[1], &bogus, sizeof(bogus)) != sizeof(bogus)
+        || recognizerd_fill(&reader, pipefd[0]) <= 0
+        || recognizerd_next(&reader, &frame) != -1) {
+        printf("ERROR: accepted a frame of %u bytes\n", bogus.length);
+        errors++;
+    }
+
+    recognizerd_reader_free(&reader);
+    close(pair[1]);
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "replay.h"
+#include "capture.h"
+
+/*
+ * Replays a small wmdump log and the same gestures as a binary capture:
+ * checks the press/reports/release framing, that short pauses between
+ * gestures are kept and long ones shortened, that both formats give the
+ * same timeline, and that a faster replay takes about as long as it
+ * should.
+ */
+
+static const char *log_text =
+  "Button Report: 0004\n"
+  "Acc Report: x=10, y=20, z=30   100 0\n"
+  "Acc Report: x=11, y=21, z=31   100 10000\n"
+  "Acc Report: x=12, y=22, z=32   100 20000\n"
+  "Button Report: 0000\n"
+  "Button Report: 0004\n"                              // one second later: kept
+  "Acc Report: x=13, y=23, z=33   101 20000\n"
+  "Acc Report: x=14, y=24, z=34   101 30000\n"
+  "Button Report: 0000\n"
+  "Button Report: 0004\n"                              // a minute later: shortened
+  "Acc Report: x=15, y=25, z=35   161 0\n"
+  "Button Report: 0000\n";
+
+#define MS 1000000LL
+
+// type, buttons, x, t for every report, in order
+static const struct { int type, buttons, x; int64_t t; } timeline[] = {
+    { RING_BUTTON, 4, 0, 0 },
+    { RING_ACC, 4, 10, 0 },
+    { RING_ACC, 4, 11, 10 * MS },
+    { RING_ACC, 4, 12, 20 * MS },
+    { RING_BUTTON, 0, 0, 20 * MS },
+    { RING_BUTTON, 4, 0, 1020 * MS },
+    { RING_ACC, 4, 13, 1020 * MS },
+    { RING_ACC, 4, 14, 1030 * MS },
+    { RING_BUTTON, 0, 0, 1030 * MS },
+    { RING_BUTTON, 4, 0, 1030 * MS + REPLAY_GAP },
+    { RING_ACC, 4, 15, 1030 * MS + REPLAY_GAP },
+    { RING_BUTTON, 0, 0, 1030 * MS + REPLAY_GAP },
+};
+#define N_REPORTS (int)(sizeof(timeline) / sizeof(timeline[0]))
+
+static int check(const char *what, struct replay *replay)
+{
+    struct ring_event batch[4];
+    int errors = 0, i = 0, n;
+
+    if (!replay) {
+        printf("ERROR: %s: couldn't load\n", what);
+        return 1;
+    }
+    if (replay->n_gestures != 3) {
+        printf("ERROR: %s: %d gestures\n", what, replay->n_gestures);
+        errors++;
+    }
+
+    replay_start(replay, REPLAY_ASAP);
+    while ((n = replay_next(replay, batch, 4)) > 0) {
+        for (int k = 0; k < n; k++, i++) {
+            if (i >= N_REPORTS || batch[k].t != batch[0].t
+                || batch[k].type != timeline[i].type || batch[k].buttons != timeline[i].buttons
+                || batch[k].t != timeline[i].t || (batch[k].type == RING_ACC && batch[k].x != timeline[i].x)) {
+                printf("ERROR: %s: report %d is type %d buttons %d x %d at %lld\n", what, i,
+                       batch[k].type, batch[k].buttons, batch[k].x, (long long)batch[k].t);
+                errors++;
+            }
+        }
+    }
+    if (i != N_REPORTS) {
+        printf("ERROR: %s: %d reports, not %d\n", what, i, N_REPORTS);
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char const* argv[])
+{
+    int errors = 0;
+    char text[] = "/tmp/replay_test.XXXXXX";
+    char binary[] = "/tmp/replay_test.XXXXXX";
+    int fd = mkstemp(text);
+
+    if (fd < 0 || write(fd, log_text, strlen(log_text)) != (ssize_t)strlen(log_text))
+        return 1;
+    close(fd);
+    if ((fd = mkstemp(binary)) < 0)
+        return 1;
+    close(fd);
+
+    struct replay *replay = replay_load(text);
+    errors += check("wmdump", replay);
+
+    // Same gestures, same recording
+    struct capture_writer *writer = capture_writer_new();
+    uint8_t x[3] = { 10, 11, 12 }, y[3] = { 20, 21, 22 }, z[3] = { 30, 31, 32 };
+    int64_t t[3] = { 100000000, 100010000, 100020000 };
+    capture_writer_add(writer, "someone", HAND_LEFT, 0, x, y, z, t, 3);
+    uint8_t x2[2] = { 13, 14 }, y2[2] = { 23, 24 }, z2[2] = { 33, 34 };
+    int64_t t2[2] = { 101020000, 101030000 };
+    capture_writer_add(writer, "someone", HAND_LEFT, 1, x2, y2, z2, t2, 2);
+    uint8_t x3 = 15, y3 = 25, z3 = 35;
+    int64_t t3 = 161000000;
+    capture_writer_add(writer, "someone", HAND_LEFT, 2, &x3, &y3, &z3, &t3, 1);
+    if (capture_writer_save(writer, binary))
+        return 1;
+    capture_writer_free(writer);
+
+    struct replay *captured = replay_load(binary);
+    errors += check("capture", captured);
+
+    // 1.53s of timeline at 20x: about 77ms
+    struct ring_event batch[4];
+    replay_start(replay, 20);
+    while (replay_next(replay, batch, 4) > 0)
+        ;
+    int64_t took = ring_now() - replay->started;
+    if (took < replay_duration(replay) / 20 || took > replay_duration(replay) / 20 + 200 * MS) {
+        printf("ERROR: replaying %lldms at 20x took %lldms\n",
+               (long long)(replay_duration(replay) / MS), (long long)(took / MS));
+        errors++;
+    }
+
+    if (replay_load("/nonexistent/replay_test")) {
+        printf("ERROR: loaded a file that isn't there\n");
+        errors++;
+    }
+
+    replay_free(replay);
+    replay_free(captured);
+    unlink(text);
+    unlink(binary);
+    return errors ? 1 : 0;
+}
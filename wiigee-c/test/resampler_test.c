@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "resampler.h"
+
+/*
+ * Checks the streaming resampler against the batch downsampling hmm_grab
+ * used to do (reproduced below over arrays), on random report streams.
+ */
+
+// downsample_acc_stream() from src/hmm_grab.c, over arrays instead of a list
+static int reference(const int *x, const int *y, const int *z, const long *t, int n,
+                     long sample_period, long out[][3])
+{
+  int emitted = 0;
+  long ax, ay, az, at;
+  ax = ay = az = at = 0;
+
+  if (n == 0) return 0;
+
+  int a = 0;
+  long t_missing;
+
+  for (int next = 1; next < n; a = next, next++) {
+    long dt = t[next] - t[a];
+
+    t_missing = sample_period - at;
+
+    while (t_missing < dt) {
+      ax += x[a] * t_missing;
+      ay += y[a] * t_missing;
+      az += z[a] * t_missing;
+      at += t_missing;
+      dt -= t_missing;
+
+      out[emitted][0] = ax/sample_period;
+      out[emitted][1] = ay/sample_period;
+      out[emitted][2] = az/sample_period;
+      emitted++;
+      ax = ay = az = at = 0;
+      t_missing = sample_period - at;
+    }
+
+    ax += x[a] * dt;
+    ay += y[a] * dt;
+    az += z[a] * dt;
+    at += dt;
+  }
+
+  t_missing = sample_period - at;
+  ax += x[a] * t_missing;
+  ay += y[a] * t_missing;
+  az += z[a] * t_missing;
+
+  out[emitted][0] = ax/sample_period;
+  out[emitted][1] = ay/sample_period;
+  out[emitted][2] = az/sample_period;
+  return emitted + 1;
+}
+
+#define N 300
+
+int main(int argc, char const* argv[])
+{
+  static int x[N], y[N], z[N];
+  static long t[N];
+  static long expected[4 * N][3];
+  static struct resampler_sample got[4 * N];
+  struct resampler r;
+
+  srand(5);
+
+  for (int trial = 0; trial < 200; trial++) {
+    int n = 1 + rand() % N;
+    long period = trial % 2 ? 100000 : 20000;
+
+    t[0] = 1244700070L * 1000000 + rand() % 1000000;
+    for (int i = 0; i < n; i++) {
+      x[i] = (signed char)(rand() & 0xff);    // hmm_grab feeds signed values
+      y[i] = (signed char)(rand() & 0xff);
+      z[i] = rand() & 0xff;
+      if (i)
+        t[i] = t[i-1] + (rand() % 4 ? rand() % 20000 : (rand() % 3) * period);
+    }
+
+    int n_expected = reference(x, y, z, t, n, period, expected);
+
+    // streamed, checking the samples appear as soon as their period ends
+    resampler_init(&r, period, 0, got, 4 * N);
+    for (int i = 0; i < n; i++) {
+      int fresh = resampler_push(&r, x[i], y[i], z[i], t[i]);
+      if (fresh && r.out[r.out_len - 1].t + period > t[i]) {
+        printf("ERROR: trial %d: emitted a period that hasn't ended\n", trial);
+        return 1;
+      }
+    }
+    resampler_finish(&r);
+
+    if (r.out_len != n_expected) {
+      printf("ERROR: trial %d: %d samples, expected %d\n", trial, r.out_len, n_expected);
+      return 1;
+    }
+    for (int i = 0; i < n_expected; i++) {
+      if (got[i].x != expected[i][0] || got[i].y != expected[i][1] || got[i].z != expected[i][2]
+          || got[i].t != t[0] + i * period) {
+        printf("ERROR: trial %d sample %d: (%d %d %d) expected (%ld %ld %ld)\n", trial, i,
+               got[i].x, got[i].y, got[i].z, expected[i][0], expected[i][1], expected[i][2]);
+        return 1;
+      }
+    }
+  }
+
+  // fractional bits keep what truncation throws away; a full buffer counts
+  struct resampler_sample small[2];
+  resampler_init(&r, 4, 8, small, 2);
+  resampler_push(&r, 1, -1, 0, 0);
+  resampler_push(&r, 2, -2, 0, 1);
+  resampler_push(&r, 0, 0, 0, 100);
+  resampler_finish(&r);
+  if (small[0].x != (7 << 8) / 4 || small[0].y != -(7 << 8) / 4 || r.out_len != 2 || r.overflow != 23) {
+    printf("ERROR: fixed point %d %d, %d samples, %lu lost\n", small[0].x, small[0].y, r.out_len, r.overflow);
+    return 1;
+  }
+
+  // a gap of 2^62 periods past a full buffer is counted, not walked
+  int64_t far = (int64_t)1 << 62;
+  resampler_init(&r, 1, 0, small, 2);
+  resampler_push(&r, 1, 1, 1, 0);
+  resampler_push(&r, 2, 2, 2, far);
+  resampler_finish(&r);
+  if (r.out_len != 2 || r.overflow != (unsigned long)(far - 2) || small[1].t != 1) {
+    printf("ERROR: long gap: %d samples, %lu lost\n", r.out_len, r.overflow);
+    return 1;
+  }
+
+  // a report from before the previous one counts as made with it
+  struct resampler_sample clamped[8], same[8];
+  struct resampler s;
+  resampler_init(&r, 10, 0, clamped, 8);
+  resampler_init(&s, 10, 0, same, 8);
+  int times[] = { 100, 115, 90, 130 }, same_times[] = { 100, 115, 115, 130 };
+  for (int i = 0; i < 4; i++) {
+    resampler_push(&r, i * 7, -i, i, times[i]);
+    resampler_push(&s, i * 7, -i, i, same_times[i]);
+  }
+  resampler_finish(&r);
+  resampler_finish(&s);
+  for (int i = 0; i < s.out_len; i++) {
+    if (r.out_len != s.out_len || clamped[i].x != same[i].x || clamped[i].y != same[i].y
+        || clamped[i].z != same[i].z || clamped[i].t != same[i].t) {
+      printf("ERROR: out of order report: sample %d of %d came out differently\n", i, r.out_len);
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "ring.h"
+
+/*
+ * One thread pushes a long numbered stream through a small ring while
+ * another pops it; every event has to come out once, in order.
+ */
+
+#define EVENTS 2000000
+
+static void *produce(void *arg)
+{
+  struct ring *r = arg;
+  struct ring_event e = { 0 };
+
+  for (int64_t i = 0; i < EVENTS; i++) {
+    e.t = i;
+    e.x = i & 0xff;
+    e.type = i % 7 ? RING_ACC : RING_BUTTON;
+    while (ring_push(r, &e))
+      ;   // full: a real producer drops, this one retries
+  }
+  return NULL;
+}
+
+int main(int argc, char const* argv[])
+{
+  struct ring *r = ring_new(100);   // rounds up to 128
+  struct ring_event events[37];
+  pthread_t producer;
+  int64_t expect = 0;
+
+  if (r->mask != 127) {
+    printf("ERROR: capacity %zu\n", r->mask + 1);
+    return 1;
+  }
+
+  pthread_create(&producer, NULL, produce, r);
+
+  while (expect < EVENTS) {
+    size_t n = ring_pop_wait(r, events, 37, 1000000000);
+    if (!n) {
+      printf("ERROR: stalled at %lld\n", (long long)expect);
+      return 1;
+    }
+    for (size_t i = 0; i < n; i++, expect++) {
+      if (events[i].t != expect || events[i].x != (expect & 0xff)
+          || events[i].type != (expect % 7 ? RING_ACC : RING_BUTTON)) {
+        printf("ERROR: got %lld, expected %lld\n", (long long)events[i].t, (long long)expect);
+        return 1;
+      }
+    }
+  }
+  pthread_join(producer, NULL);
+
+  // full rings drop and count, empty ones time out
+  struct ring_event e = { 0 };
+  unsigned long retries = ring_dropped(r);
+  for (int i = 0; i < 130; i++)
+    ring_push(r, &e);
+  int64_t start = ring_now();
+  size_t drained = ring_pop(r, events, 37) + ring_pop(r, events, 37) + ring_pop(r, events, 37) + ring_pop(r, events, 37);
+  if (ring_dropped(r) - retries != 2 || drained != 128 || ring_pop_wait(r, events, 1, 2000000) != 0 || ring_now() - start < 2000000) {
+    printf("ERROR: dropped %lu, drained %zu\n", ring_dropped(r) - retries, drained);
+    return 1;
+  }
+
+  ring_free(r);
+  return 0;
+}
@@ -0,0 +1,141 @@
+#include "hmm_runs.h"
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Checks the run-length aware forward pass against the plain one, on
+ * random L-R models and sequences with long runs: the probability where
+ * the plain pass doesn't underflow, and the log-probability against a
+ * per-step scaled forward pass on sequences long enough that it does.
+ */
+
+#define TRIALS 20
+
+static double uniform() {
+  return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static void randomize(HmmStateRef hmm) {
+  for (uint i = 0; i < hmm->numStates; i++) {
+    double total = 0.0;
+    for (uint o = 0; o < hmm->numObservations; o++) {
+      setEmitP(hmm, i, o, uniform());
+      total += getEmitP(hmm, i, o);
+    }
+    for (uint o = 0; o < hmm->numObservations; o++)
+      setEmitP(hmm, i, o, getEmitP(hmm, i, o) / total);
+  }
+}
+
+// A few long runs, like a controller held still, and some noise
+static void fill(uint *symbols, uint length, uint observations) {
+  uint n = 0;
+
+  while (n < length) {
+    uint symbol = rand() % observations;
+    uint run = (rand() % 4 == 0) ? 1 + rand() % 100 : 1;
+    for (uint k = 0; k < run && n < length; k++)
+      symbols[n++] = symbol;
+  }
+}
+
+// log getProbability(), one step at a time and rescaled after every step
+static double scaledForward(HmmStateRef hmm, StateSequenceRef seq) {
+  double alpha[hmm->numStates], next[hmm->numStates];
+  double logP = 0.0;
+
+  forwardInit(hmm, alpha, seq->states[0]);
+  for (uint n = 0; ; n++) {
+    double sum = forwardSum(hmm, alpha);
+    logP += log(sum);
+    for (uint i = 0; i < hmm->numStates; i++)
+      alpha[i] /= sum;
+
+    if (n + 1 == seq->length)
+      return logP;
+    forwardStep(hmm, alpha, next, seq->states[n + 1]);
+    memcpy(alpha, next, sizeof(alpha));
+  }
+}
+
+int main(int argc, char const* argv[]) {
+  int errors = 0, underflows = 0;
+
+  srand(7);
+
+  // short enough for getProbability()
+  for (int trial = 0; trial < TRIALS; trial++) {
+    uint states = 2 + rand() % 8;
+    uint observations = 2 + rand() % 14;
+    HmmStateRef hmm = hmm_new(states, observations);
+    randomize(hmm);
+
+    uint length = 40 + rand() % 80;
+    uint symbols[length];
+    fill(symbols, length, observations);
+
+    StateSequenceRef seq = createStateSequence(symbols, length);
+    SymbolRunsRef runs = createSymbolRuns(seq);
+    HmmPowersRef powers = createHmmPowers(hmm);
+
+    double expected = getProbability(hmm, seq);
+    double got = getProbabilityRuns(powers, runs);
+
+    if (!(expected > DBL_MIN)) {
+      printf("ERROR: trial %d (%d states, %d obs, %d symbols): getProbability() underflowed to %g\n",
+             trial, states, observations, length, expected);
+      errors++;
+    }
+    if (runs->length != length || fabs(expected - got) > 1e-9 * expected) {
+      printf("ERROR: trial %d (%d states, %d obs, %d symbols in %d runs): expected %g, got %g\n",
+             trial, states, observations, length, runs->numRuns, expected, got);
+      errors++;
+    }
+
+    releaseHmmPowers(powers);
+    releaseSymbolRuns(runs);
+    releaseStateSequence(seq);
+    hmm_free(hmm);
+  }
+
+  // long, in logs
+  for (int trial = 0; trial < TRIALS; trial++) {
+    uint states = 2 + rand() % 8;
+    uint observations = 2 + rand() % 14;
+    HmmStateRef hmm = hmm_new(states, observations);
+    randomize(hmm);
+
+    uint length = 400 + rand() % 4000;
+    uint *symbols = malloc(sizeof(uint) * length);
+    fill(symbols, length, observations);
+
+    StateSequenceRef seq = createStateSequence(symbols, length);
+    SymbolRunsRef runs = createSymbolRuns(seq);
+    HmmPowersRef powers = createHmmPowers(hmm);
+
+    double expected = scaledForward(hmm, seq);
+    double got = getLogProbabilityRuns(powers, runs);
+
+    underflows += getProbability(hmm, seq) == 0.0;
+    if (!isfinite(expected) || fabs(expected - got) > 1e-9 * fabs(expected)) {
+      printf("ERROR: log trial %d (%d states, %d obs, %d symbols in %d runs): expected %.17g, got %.17g\n",
+             trial, states, observations, length, runs->numRuns, expected, got);
+      errors++;
+    }
+
+    releaseHmmPowers(powers);
+    releaseSymbolRuns(runs);
+    releaseStateSequence(seq);
+    free(symbols);
+    hmm_free(hmm);
+  }
+
+  if (underflows == 0) {
+    printf("ERROR: no log trial got beyond what getProbability() can represent\n");
+    errors++;
+  }
+
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "scorer.h"
+#include "circle_fixture.h"
+
+/*
+ * Feeds circles to the scorer one sample at a time and checks that after
+ * every sample, for every model, scorer_probabilities() is exactly what
+ * matches() says about the gesture so far: through padding while it is
+ * shorter than the models' states, over two codebooks (three models
+ * sharing one and a fourth with its own), and after a reset.
+ */
+
+#define PROBES  9
+
+static int check(struct scorer *scorer, struct gesturemodel **models, int n, struct gesture *so_far, const char *name)
+{
+    double got[n];
+    int errors = 0;
+
+    scorer_probabilities(scorer, got);
+    for (int m = 0; m < n; m++) {
+        double expected = matches(models[m], so_far);
+
+        if (got[m] != expected) {
+            printf("ERROR: %s, %d samples: model %d scored %g, matches() says %g\n",
+                   name, so_far->data_len, m, got[m], expected);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture sets[4][CIRCLE_SET];
+    struct gesture probes[PROBES];
+    struct gesturemodel *models[4];
+    int errors = 0;
+
+    srand(29);
+    circle_sets(sets, 3);
+    circle_sets(&sets[3], 1);
+    for (int i = 0; i < PROBES; i++)
+        circle_gesture(&probes[i], i % 3);
+
+    for (int k = 0; k < 4; k++)
+        models[k] = gesturemodel_new(k);
+    circle_train(models, 3, sets);
+    gesturemodel_train(models[3], sets[3], CIRCLE_SET);
+
+    struct scorer *scorer = scorer_new(models, 4);
+    if (scorer->n_codebooks != 2) {
+        printf("ERROR: %d codebooks, not 2\n", scorer->n_codebooks);
+        errors++;
+    }
+
+    // Sample by sample, and every prefix checked
+    for (int i = 0; i < PROBES; i++) {
+        struct gesture *g = gesture_new();
+
+        scorer_reset(scorer);
+        for (int j = 0; j < probes[i].data_len; j++) {
+            scorer_push(scorer, probes[i].data[j].x, probes[i].data[j].y, probes[i].data[j].z);
+            gesture_append(g, probes[i].data[j].x, probes[i].data[j].y, probes[i].data[j].z);
+            errors += check(scorer, models, 4, g, "pushed");
+        }
+        gesture_free(g);
+    }
+
+    // A whole gesture at once, the same
+    for (int i = 0; i < PROBES; i++) {
+        scorer_reset(scorer);
+        scorer_push_gesture(scorer, &probes[i]);
+        errors += check(scorer, models, 4, &probes[i], "whole");
+    }
+
+    scorer_free(scorer);
+    for (int k = 0; k < 4; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 4);
+    for (int i = 0; i < PROBES; i++)
+        free(probes[i].data);
+    return errors ? 1 : 0;
+}
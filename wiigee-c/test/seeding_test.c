@@ -0,0 +1,135 @@
+// vim:set ts=4 sw=4 ai et:
+
+/*
+ * Checks the initial codebooks: SEED_CIRCLE at the default size has to be
+ * the original wiigee table, and at other sizes still evenly spread over
+ * the two circles without duplicates; SEED_KMEANSPP has to draw its
+ * centroids from the data, the same ones for the same seed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "quantizer.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLES     300
+
+// The wiigee table, as initialize_centroids() used to spell it out
+static void wiigee_table(double r, double map[MAP_SIZE][3])
+{
+    double table[MAP_SIZE][3] = {
+        { r,                    0.0,                    0.0                  },
+        { cos(M_PI/4)*r,        0.0,                    sin(M_PI/4)*r        },
+        { 0.0,                  0.0,                    r                    },
+        { cos(M_PI*3/4)*r,      0.0,                    sin(M_PI*3/4)*r      },
+        { -r,                   0.0,                    0.0                  },
+        { cos(M_PI*5/4)*r,      0.0,                    sin(M_PI*5/4)*r      },
+        { 0.0,                  0.0,                    -r                   },
+        { cos(M_PI*7/4)*r,      0.0,                    sin(M_PI*7/4)*r      },
+        { 0.0,                  r,                      0.0                  },
+        { 0.0,                  cos(M_PI/4)*r,          sin(M_PI/4)*r        },
+        { 0.0,                  cos(M_PI*3/4)*r,        sin(M_PI*3/4)*r      },
+        { 0.0,                  -r,                     0.0                  },
+        { 0.0,                  cos(M_PI*5/4)*r,        sin(M_PI*5/4)*r      },
+        { 0.0,                  cos(M_PI*7/4)*r,        sin(M_PI*7/4)*r      },
+    };
+    memcpy(map, table, sizeof(table));
+}
+
+static int is_sample(struct gesture *g, const double *c)
+{
+    for (int j = 0; j < g->data_len; j++)
+        if (g->data[j].x == c[0] && g->data[j].y == c[1] && g->data[j].z == c[2])
+            return 1;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture *g = gesture_new();
+    int errors = 0;
+
+    srand(27);
+    for (int j = 0; j < SAMPLES; j++)
+        gesture_append(g, 60 + rand() % 140, 60 + rand() % 140, 60 + rand() % 140);
+    gesture_minmax(g);
+    double r = (g->minacc + g->maxacc) / 2;
+
+    // The default codebook is the original table, exactly
+    double table[MAP_SIZE][3];
+    struct quantizer *q = quantizer_new(8);
+    wiigee_table(r, table);
+    quantizer_seed(q, g);
+    if (q->map_size != MAP_SIZE || memcmp(q->map, table, sizeof(table))) {
+        printf("ERROR: SEED_CIRCLE at %d isn't the wiigee table\n", MAP_SIZE);
+        for (int i = 0; i < q->map_size; i++)
+            printf("  %2d: %.17g %.17g %.17g\n", i, q->map[i][0], q->map[i][1], q->map[i][2]);
+        errors++;
+    }
+    quantizer_free(q);
+
+    // Other sizes: on the xz or yz circle, all different
+    for (int n = 2; n <= 40; n++) {
+        q = quantizer_new_sized(8, n, SEED_CIRCLE);
+        quantizer_seed(q, g);
+
+        for (int i = 0; i < n; i++) {
+            double *c = q->map[i];
+            int duplicate = 0;
+
+            for (int k = 0; k < i; k++)
+                duplicate |= fabs(c[0] - q->map[k][0]) + fabs(c[1] - q->map[k][1]) + fabs(c[2] - q->map[k][2]) < 1e-9 * r;
+            if ((c[0] != 0 && c[1] != 0) || fabs(sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]) - r) > 1e-9 * r || duplicate) {
+                printf("ERROR: SEED_CIRCLE at %d: centroid %d (%g, %g, %g)\n", n, i, c[0], c[1], c[2]);
+                errors++;
+            }
+        }
+        quantizer_free(q);
+    }
+
+    // k-means++: samples, the same for the same seed, not for another
+    struct quantizer *a = quantizer_new_sized(8, MAP_SIZE, SEED_KMEANSPP);
+    struct quantizer *b = quantizer_new_sized(8, MAP_SIZE, SEED_KMEANSPP);
+    struct quantizer *c = quantizer_new_sized(8, MAP_SIZE, SEED_KMEANSPP);
+    c->seed = 12345;
+    quantizer_seed(a, g);
+    quantizer_seed(b, g);
+    quantizer_seed(c, g);
+
+    for (int i = 0; i < MAP_SIZE; i++) {
+        if (!is_sample(g, a->map[i])) {
+            printf("ERROR: SEED_KMEANSPP: centroid %d isn't a sample\n", i);
+            errors++;
+        }
+    }
+    if (memcmp(a->map, b->map, sizeof(*a->map) * MAP_SIZE)) {
+        printf("ERROR: SEED_KMEANSPP: same seed, different codebooks\n");
+        errors++;
+    }
+    if (!memcmp(a->map, c->map, sizeof(*a->map) * MAP_SIZE)) {
+        printf("ERROR: SEED_KMEANSPP: another seed, the same codebook\n");
+        errors++;
+    }
+
+    // And again from the same seed, on the same quantizer
+    double first[MAP_SIZE][3];
+    memcpy(first, a->map, sizeof(first));
+    a->seed = 1;
+    quantizer_seed(a, g);
+    if (memcmp(a->map, first, sizeof(first))) {
+        printf("ERROR: SEED_KMEANSPP: reseeding gave a different codebook\n");
+        errors++;
+    }
+
+    quantizer_free(a);
+    quantizer_free(b);
+    quantizer_free(c);
+    gesture_free(g);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+// vim:set ts=4 sw=4 ai et:
+
+#define _POSIX_C_SOURCE 200809L     // mkstemp, nanosleep
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "session.h"
+#include "classifier.h"
+#include "util.h"
+#include "circle_fixture.h"
+
+/*
+ * Runs several sessions' worth of gestures through a pool of workers at
+ * once, and checks every session got each of its results, in order, and
+ * that they're what the batch classifier says about the same gestures
+ * resampled the same way.  Then replays a script with provisional
+ * results and early commits on, checking their cadence and order, and
+ * that they leave the final results alone.
+ */
+
+#define SESSIONS    8
+#define GESTURES    5
+#define REPORTS     CIRCLE_REPORTS
+#define MS          1000000
+#define PERIOD      (20 * MS)
+
+struct script {
+    struct ring_event events[GESTURES * (REPORTS + 2)];
+    int n_events;
+    struct session_result results[GESTURES];
+    int n_results;
+};
+
+static int delivered;
+
+// Everything a session with session_anytime() on delivers, in order
+struct anytime {
+    struct session_result results[GESTURES * 20];
+    int n;
+};
+
+static void record(struct session *s, const struct session_result *r, void *ctx)
+{
+    struct anytime *a = ctx;
+
+    if (a->n < GESTURES * 20)
+        a->results[a->n] = *r;
+    a->n++;
+}
+
+static int check_anytime(struct modelbank *bank, struct script *script)
+{
+    static struct anytime a;
+    struct session *s = session_new(0, bank, PERIOD, 4096, record, &a);
+    int errors = 0, gesture = 0, commits = 0, early = 0;
+    int64_t last = 0;
+
+    session_anytime(s, 100 * MS, 0.6, 3);
+    for (int i = 0; i < script->n_events; i++)
+        session_push(s, &script->events[i]);
+    session_process(s);
+
+    for (int i = 0; i < a.n && i < GESTURES * 20; i++) {
+        struct session_result *r = &a.results[i];
+
+        if (r->kind == SESSION_FINAL) {
+            if (gesture >= GESTURES || r->model != script->results[gesture].model
+                || r->probability != script->results[gesture].probability) {
+                printf("ERROR: final result %d changed with anytime results on\n", gesture);
+                errors++;
+            }
+            gesture++;
+            commits = 0;
+            last = 0;
+            continue;
+        }
+
+        if (r->kind == SESSION_COMMITTED) {
+            if (++commits > 1 || r->margin < 0.6 || r->samples < 3) {
+                printf("ERROR: bad commit: %d, margin %f on %d samples\n", commits, r->margin, r->samples);
+                errors++;
+            }
+            early++;
+        } else if (commits) {
+            printf("ERROR: provisional result after the commit\n");
+            errors++;
+        }
+        if (last && r->end - last < 100 * MS) {
+            printf("ERROR: provisional results %lldms apart\n", (long long)((r->end - last) / MS));
+            errors++;
+        }
+        last = r->end;
+    }
+    if (gesture != GESTURES) {
+        printf("ERROR: %d final results with anytime results on\n", gesture);
+        errors++;
+    }
+    printf("%d results for %d gestures, %d committed early\n", a.n, GESTURES, early);
+
+    session_free(s);
+    return errors;
+}
+
+static void collect(struct session *s, const struct session_result *r, void *ctx)
+{
+    struct script *script = ctx;
+
+    if (script->n_results < GESTURES)
+        script->results[script->n_results] = *r;
+    script->n_results++;
+    __atomic_add_fetch(&delivered, 1, __ATOMIC_RELEASE);
+}
+
+// Press B, report a gesture every 10ms or so, release
+static void write_script(struct script *script, int first_kind)
+{
+    int64_t t = 1000 * MS;
+    double x, y, z;
+
+    for (int j = 0; j < GESTURES; j++) {
+        struct ring_event *e = &script->events[script->n_events];
+
+        e[0] = (struct ring_event){ t, RING_BUTTON, SESSION_TRIGGER };
+        for (int i = 0; i < REPORTS; i++) {
+            t += 8 * MS + rand() % (5 * MS);
+            circle_report((first_kind + j) % 3, i, &x, &y, &z);
+            e[i+1] = (struct ring_event){ t, RING_ACC, SESSION_TRIGGER, x, y, z };
+        }
+        t += 10 * MS;
+        e[REPORTS+1] = (struct ring_event){ t, RING_BUTTON, 0 };
+        script->n_events += REPORTS + 2;
+        t += 500 * MS;
+    }
+}
+
+// What the batch classifier makes of gesture j of the script
+static int expected(struct classifier *classifier, struct script *script, int j, double *probability)
+{
+    struct resampler_sample out[REPORTS + 2];
+    struct resampler r;
+    struct gesture g;
+    double probabilities[3];
+
+    resampler_init(&r, PERIOD, 0, out, REPORTS + 2);
+    for (int i = 1; i <= REPORTS; i++) {
+        struct ring_event *e = &script->events[j * (REPORTS + 2) + i];
+        resampler_push(&r, e->x, e->y, e->z, e->t);
+    }
+    resampler_finish(&r);
+
+    memset(&g, 0, sizeof(g));
+    for (int i = 0; i < r.out_len; i++)
+        gesture_append(&g, out[i].x, out[i].y, out[i].z);
+    gesture_minmax(&g);
+
+    int m = classifier_classify(classifier, &g, probabilities);
+    *probability = m >= 0 ? probabilities[m] : 0;
+    free(g.data);
+    return m;
+}
+
+int main(int argc, char **argv)
+{
+    int errors = 0;
+    struct gesture sets[3][CIRCLE_SET];
+
+    srand(5);
+    circle_sets(sets, 3);
+
+    struct gesturemodel *models[3];
+    for (int k = 0; k < 3; k++)
+        models[k] = gesturemodel_new(k + 20);
+    circle_train(models, 3, sets);
+
+    char path[] = "/tmp/session_test.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return 1;
+    close(fd);
+    if (modelbank_save(path, models, 3))
+        die("couldn't save %s\n", path);
+    struct modelbank *bank = modelbank_open(path);
+    if (!bank)
+        die("couldn't load %s\n", path);
+
+    static struct script scripts[SESSIONS];
+    struct session *sessions[SESSIONS];
+    struct session_pool *pool = session_pool_new(3);
+
+    for (int s = 0; s < SESSIONS; s++) {
+        write_script(&scripts[s], s % 3);
+        sessions[s] = session_new(s, bank, PERIOD, 64, collect, &scripts[s]);
+        session_pool_add(pool, sessions[s]);
+    }
+
+    // Interleave the devices' reports, as if they were all live; a full
+    // ring only means the workers are behind, so wait for them
+    for (int i = 0; i < GESTURES * (REPORTS + 2); i++) {
+        for (int s = 0; s < SESSIONS; s++) {
+            while (session_push(sessions[s], &scripts[s].events[i])) {
+                struct timespec ts = { 0, 100000 };
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+
+    int64_t deadline = ring_now() + 10000LL * MS;
+    while (__atomic_load_n(&delivered, __ATOMIC_ACQUIRE) < SESSIONS * GESTURES && ring_now() < deadline) {
+        struct timespec ts = { 0, MS };
+        nanosleep(&ts, NULL);
+    }
+
+    for (int s = 0; s < SESSIONS; s++)
+        session_pool_remove(pool, sessions[s]);
+    session_pool_free(pool);
+
+    struct classifier *classifier = classifier_new();
+    for (int k = 0; k < bank->n_models; k++)
+        classifier_add(classifier, bank->models[k]);
+
+    int right = 0;
+    for (int s = 0; s < SESSIONS; s++) {
+        struct script *script = &scripts[s];
+
+        if (script->n_results != GESTURES) {
+            printf("ERROR: session %d got %d results, not %d\n", s, script->n_results, GESTURES);
+            errors++;
+            continue;
+        }
+        for (int j = 0; j < GESTURES; j++) {
+            struct session_result *r = &script->results[j];
+            double probability;
+            int m = expected(classifier, script, j, &probability);
+
+            if (r->model != m || r->probability != probability
+                || r->start != script->events[j * (REPORTS + 2)].t) {
+                printf("ERROR: session %d gesture %d: model %d p=%g, the classifier says %d p=%g\n",
+                       s, j, r->model, r->probability, m, probability);
+                errors++;
+            }
+            if (r->model >= 0 && r->id != bank->models[r->model]->id) {
+                printf("ERROR: session %d gesture %d: id %d for model %d\n", s, j, r->id, r->model);
+                errors++;
+            }
+            right += r->model == (s + j) % 3;
+        }
+    }
+    printf("%d/%d gestures recognized\n", right, SESSIONS * GESTURES);
+
+    if (scripts[0].n_results == GESTURES)
+        errors += check_anytime(bank, &scripts[0]);
+
+    classifier_free(classifier);
+    for (int s = 0; s < SESSIONS; s++)
+        session_free(sessions[s]);
+    modelbank_close(bank);
+    unlink(path);
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    return errors ? 1 : 0;
+}
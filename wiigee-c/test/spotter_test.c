@@ -0,0 +1,159 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "spotter.h"
+#include "gesture.h"
+#include "circle_fixture.h"
+
+/*
+ * Trains three models on circles in different planes, then spots them in
+ * long streams of a controller at rest with circles drawn now and then:
+ * every circle has to be found once, as the right model, around where it
+ * was drawn, and soon after it ended.  Rest alone finds nothing, a circle
+ * cut off by the end of the stream comes out of the flush, and a very
+ * long stream neither runs out of records nor changes the results.
+ */
+
+#define REPORTS     CIRCLE_REPORTS
+#define REST        30          // Reports between circles, at least
+#define PERIOD      10000000LL  // ns
+#define GESTURES    12
+#define LONG_RUN    2000
+#define LATENCY     30          // Reports after its end a detection may take
+#define START_SLACK 3           // Reports the start may be off by
+#define END_SLACK   20          // And the end: the last state and rest can be hard to tell apart
+#define MAP_SIZE    14
+
+struct found {
+    struct spotter_detection d;
+    unsigned long at;           // Samples pushed when it was reported
+};
+
+struct log {
+    struct found *found;
+    int n, cap;
+};
+
+static void collect(struct spotter *s, const struct spotter_detection *d, void *ctx)
+{
+    struct log *log = ctx;
+
+    if (log->n < log->cap)
+        log->found[log->n] = (struct found){ *d, s->samples };
+    log->n++;
+}
+
+static int64_t t;
+
+static void rest(struct spotter *s, int n)
+{
+    for (int i = 0; i < n; i++, t += PERIOD)
+        spotter_push(s, 128 + rand() % 5 - 2, 128 + rand() % 5 - 2, 128 + rand() % 5 - 2, t);
+}
+
+// Returns the time of the circle's first report
+static int64_t draw(struct spotter *s, int kind)
+{
+    int64_t start = t;
+    double x, y, z;
+
+    for (int i = 0; i < REPORTS; i++, t += PERIOD) {
+        circle_report(kind, i, &x, &y, &z);
+        spotter_push(s, x, y, z, t);
+    }
+    return start;
+}
+
+// The circles drawn at starts[], of kinds[], against what was found
+static int check(const char *name, struct spotter *s, struct log *log, const int64_t *starts, const int *kinds, int n)
+{
+    int errors = 0;
+
+    if (log->n != n) {
+        printf("ERROR: %s: %d detections, expected %d\n", name, log->n, n);
+        return 1;
+    }
+    for (int j = 0; j < n && j < log->cap; j++) {
+        struct found *f = &log->found[j];
+        int64_t end = starts[j] + (REPORTS - 1) * PERIOD;
+
+        if (f->d.model != kinds[j] || f->d.id != kinds[j] + 20
+            || llabs(f->d.start - starts[j]) > START_SLACK * PERIOD || llabs(f->d.end - end) > END_SLACK * PERIOD
+            || f->d.score < s->penalty || (int64_t)f->at * PERIOD > f->d.end + LATENCY * PERIOD) {
+            printf("ERROR: %s: circle %d (%d at %lld-%lld) found as %d at %lld-%lld, score %g, reported at %lld\n",
+                   name, j, kinds[j], (long long)starts[j], (long long)end, f->d.model,
+                   (long long)f->d.start, (long long)f->d.end, f->d.score, (long long)f->at * PERIOD);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    int errors = 0;
+    struct gesture sets[3][CIRCLE_SET];
+
+    srand(5);
+    circle_sets(sets, 3);
+
+    struct gesturemodel *models[3];
+    for (int k = 0; k < 3; k++)
+        models[k] = gesturemodel_new_sized(k + 20, 8, MAP_SIZE, SEED_KMEANSPP);
+    circle_train(models, 3, sets);
+
+    static struct found found[LONG_RUN];
+    static int64_t starts[LONG_RUN];
+    static int kinds[LONG_RUN];
+    struct log log = { found, 0, LONG_RUN };
+    struct spotter *s = spotter_new(models, 3, collect, &log);
+
+    // Rest alone
+    rest(s, 5000);
+    spotter_flush(s);
+    if (log.n != 0) {
+        printf("ERROR: rest: %d detections\n", log.n);
+        errors++;
+    }
+
+    // Circles, reported as they go
+    log.n = 0;
+    for (int j = 0; j < GESTURES; j++) {
+        rest(s, REST + rand() % 20);
+        kinds[j] = rand() % 3;
+        starts[j] = draw(s, kinds[j]);
+    }
+    rest(s, LATENCY);
+    errors += check("stream", s, &log, starts, kinds, GESTURES);
+
+    // The last cut off by the end of the stream
+    log.n = 0;
+    rest(s, REST);
+    kinds[0] = 1;
+    starts[0] = draw(s, 1);
+    spotter_flush(s);
+    log.found[0].at = starts[0] / PERIOD + REPORTS;     // When the flush was, for check()
+    errors += check("flush", s, &log, starts, kinds, 1);
+
+    // And a long one, in constant space
+    log.n = 0;
+    for (int j = 0; j < LONG_RUN; j++) {
+        rest(s, REST + rand() % 20);
+        kinds[j] = rand() % 3;
+        starts[j] = draw(s, kinds[j]);
+    }
+    rest(s, LATENCY);
+    errors += check("long", s, &log, starts, kinds, LONG_RUN);
+    if (s->forced) {
+        printf("ERROR: long: %lu forced decisions\n", s->forced);
+        errors++;
+    }
+
+    spotter_free(s);
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,117 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "synth.h"
+#include "classifier.h"
+#include "quantizer.h"
+#include "circle_fixture.h"
+
+/*
+ * Checks the generator is reproducible, that gestures sampled from three
+ * trained models are recognized as coming from them, and that augmenting
+ * with nothing turned on gives back the original.  The models are seeded
+ * k-means++, since their reports are raw, centred on 128.
+ */
+
+#define LEN CIRCLE_REPORTS
+
+int main(int argc, char **argv)
+{
+    int errors = 0;
+    struct synth a, b;
+    uint8_t x[256], y[256], z[256], x2[256], y2[256], z2[256];
+    int64_t t[256], t2[256];
+
+    // Normals look normal
+    double sum = 0, sq = 0;
+    synth_init(&a, 42);
+    for (int i = 0; i < 100000; i++) {
+        double v = synth_normal(&a);
+        sum += v;
+        sq += v * v;
+    }
+    if (fabs(sum / 100000) > 0.02 || fabs(sq / 100000 - 1) > 0.02) {
+        printf("ERROR: normals have mean %f, variance %f\n", sum / 100000, sq / 100000);
+        errors++;
+    }
+
+    struct gesture sets[3][CIRCLE_SET];
+    srand(7);
+    circle_sets(sets, 3);
+
+    struct gesturemodel *models[3];
+    struct classifier *classifier = classifier_new();
+    for (int k = 0; k < 3; k++) {
+        models[k] = gesturemodel_new_sized(k, 8, MAP_SIZE, SEED_KMEANSPP);
+        classifier_add(classifier, models[k]);
+    }
+    circle_train(models, 3, sets);
+
+    // Same seed, same gestures
+    synth_init(&a, 9);
+    synth_init(&b, 9);
+    int n = synth_sample(&a, models[1], x, y, z, t, 256);
+    int n2 = synth_sample(&b, models[1], x2, y2, z2, t2, 256);
+    if (n != n2 || memcmp(x, x2, n) || memcmp(y, y2, n) || memcmp(z, z2, n) || memcmp(t, t2, n * sizeof(int64_t))) {
+        printf("ERROR: the same seed sampled different gestures\n");
+        errors++;
+    }
+    if (n < a.min_len || n > a.max_len) {
+        printf("ERROR: sampled %d reports, not %d to %d\n", n, a.min_len, a.max_len);
+        errors++;
+    }
+
+    // Sampled gestures are recognizable as their models'
+    int right = 0;
+    synth_init(&a, 11);
+    a.min_len = a.max_len = LEN;
+    for (int i = 0; i < 60; i++) {
+        struct gesture g;
+        n = synth_sample(&a, models[i % 3], x, y, z, t, 256);
+        memset(&g, 0, sizeof(g));
+        for (int k = 0; k < n; k++)
+            gesture_append(&g, x[k], y[k], z[k]);
+        gesture_minmax(&g);
+        right += classifier_classify(classifier, &g, NULL) == i % 3;
+        free(g.data);
+    }
+    printf("%d/60 sampled gestures recognized\n", right);
+    if (right < 48) {
+        printf("ERROR: sampled gestures don't look like their models\n");
+        errors++;
+    }
+
+    // Augmenting with everything off is the identity; with it on, the
+    // length stays within the warp
+    for (int k = 0; k < LEN; k++) {
+        x[k] = sets[0][0].data[k].x;
+        y[k] = sets[0][0].data[k].y;
+        z[k] = sets[0][0].data[k].z;
+        t[k] = 1000000 + 10000 * k;
+    }
+    synth_init(&b, 5);
+    b.warp = b.rotation = b.noise = 0;
+    n = synth_augment(&b, x, y, z, t, LEN, x2, y2, z2, t2, 256);
+    if (n != LEN || memcmp(x, x2, n) || memcmp(y, y2, n) || memcmp(z, z2, n) || memcmp(t, t2, n * sizeof(int64_t))) {
+        printf("ERROR: augmenting with nothing on changed the gesture\n");
+        errors++;
+    }
+    synth_init(&b, 5);
+    for (int i = 0; i < 100; i++) {
+        n = synth_augment(&b, x, y, z, t, LEN, x2, y2, z2, t2, 256);
+        if (n < LEN / (1 + b.warp) - 1 || n > LEN / (1 - b.warp) + 1) {
+            printf("ERROR: augmented %d reports into %d\n", LEN, n);
+            errors++;
+        }
+    }
+
+    classifier_free(classifier);
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    return errors ? 1 : 0;
+}
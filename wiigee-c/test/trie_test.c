@@ -0,0 +1,78 @@
+#include "hmm_trie.h"
+
+/*
+ * Checks that batch scoring through the prefix trie gives exactly what
+ * getProbability() gives per sequence, and that a sequence far deeper than
+ * the C stack would allow recursing into gets scored too.
+ */
+
+#define DEEP 300000
+
+int main(int argc, char const* argv[]) {
+  int errors = 0;
+  uint symbols[120];
+
+  srand(11);
+
+  HmmStateRef hmm = hmm_new(8, 14);
+  for (uint i = 0; i < 8; i++)
+    for (uint o = 0; o < 14; o++)
+      setEmitP(hmm, i, o, (1.0 + rand() % 5) / 42.0);
+
+  SequenceTrieRef trie = createSequenceTrie();
+  StateSequenceRef seqs[60];
+
+  // variations on a few common starts, plus duplicates and prefixes
+  for (int s = 0; s < 60; s++) {
+    uint length = (s % 7 == 6) ? 10 : 20 + rand() % 100;
+    uint shared = rand() % 30;
+    for (uint k = 0; k < length; k++)
+      symbols[k] = k < shared ? (k * (s % 3 + 1)) % 14 : rand() % 14;
+    seqs[s] = createStateSequence(symbols, s % 10 == 9 ? seqs[s-1]->length : length);
+    if (s % 10 == 9)
+      for (uint k = 0; k < seqs[s]->length; k++)
+        seqs[s]->states[k] = seqs[s-1]->states[k];
+    if (trieInsert(trie, seqs[s]) != (uint)s) {
+      printf("ERROR: sequence %d inserted out of order\n", s);
+      errors++;
+    }
+  }
+
+  double out[60];
+  trieScore(hmm, trie, out);
+
+  for (int s = 0; s < 60; s++) {
+    double expected = getProbability(hmm, seqs[s]);
+    if (out[s] != expected) {
+      printf("ERROR: sequence %d: expected %g, got %g\n", s, expected, out[s]);
+      errors++;
+    }
+    releaseStateSequence(seqs[s]);
+  }
+
+  releaseSequenceTrie(trie);
+
+  // one node per symbol, all in a line
+  uint *deep = malloc(sizeof(uint) * DEEP);
+  for (uint k = 0; k < DEEP; k++)
+    deep[k] = rand() % 14;
+  StateSequenceRef long_seq = createStateSequence(deep, DEEP);
+  StateSequenceRef short_seq = createStateSequence(deep, 50);
+
+  trie = createSequenceTrie();
+  trieInsert(trie, long_seq);
+  trieInsert(trie, short_seq);
+  trieScore(hmm, trie, out);
+  if (out[0] != getProbability(hmm, long_seq) || out[1] != getProbability(hmm, short_seq) || out[1] == 0) {
+    printf("ERROR: deep trie: got %g and %g\n", out[0], out[1]);
+    errors++;
+  }
+
+  releaseSequenceTrie(trie);
+  releaseStateSequence(long_seq);
+  releaseStateSequence(short_seq);
+  free(deep);
+  hmm_free(hmm);
+
+  return errors ? 1 : 0;
+}
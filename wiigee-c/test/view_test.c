@@ -0,0 +1,131 @@
+// vim:set ts=4 sw=4 ai et:
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gesturemodel.h"
+#include "circle_fixture.h"
+
+/*
+ * An observation_view() reads the observation's symbols in place; it has
+ * to score exactly as an owning copy does, and as the uint array that
+ * createStateSequence() narrows: the same forward table and probability,
+ * and the same as matches().  Training on views has to give the model
+ * training on copies gives.
+ */
+
+#define PROBES  12
+
+static int same_hmm(HmmStateRef a, HmmStateRef b)
+{
+    int n = a->numStates, m = a->numObservations;
+
+    return !memcmp(a->p_initial, b->p_initial, sizeof(double) * n)
+        && !memcmp(a->p_change, b->p_change, sizeof(double) * n * n)
+        && !memcmp(a->p_emit, b->p_emit, sizeof(double) * n * m);
+}
+
+static int score(struct gesturemodel *model, struct gesture *probe, const char *name)
+{
+    struct observation *observation = quantizer_getObservationSequence(model->quantizer, probe);
+    int n = observation->sequence_len;
+    int errors = 0;
+
+    StateSequence view = observation_view(observation);
+    StateSequence *copy = observation_to_StateSequence(observation);
+    uint symbols[n];
+    for (int j = 0; j < n; j++)
+        symbols[j] = observation->sequence[j];
+    StateSequence *narrowed = createStateSequence(symbols, n);
+
+    if (view.states != observation->sequence || view.length != n) {
+        printf("ERROR: %s: the view isn't over the observation's symbols\n", name);
+        errors++;
+    }
+    if (copy->states == observation->sequence || copy->length != n || memcmp(copy->states, observation->sequence, n)) {
+        printf("ERROR: %s: the copy isn't a copy\n", name);
+        errors++;
+    }
+
+    double *f_view = forwardAlgorithm(model->hmm, &view);
+    double *f_copy = forwardAlgorithm(model->hmm, copy);
+    double *f_narrowed = forwardAlgorithm(model->hmm, narrowed);
+    size_t size = sizeof(double) * model->hmm->numStates * n;
+    if (memcmp(f_view, f_copy, size) || memcmp(f_view, f_narrowed, size)) {
+        printf("ERROR: %s: forward tables differ\n", name);
+        errors++;
+    }
+
+    double p_view = getProbability(model->hmm, &view);
+    double p_copy = getProbability(model->hmm, copy);
+    double p_narrowed = getProbability(model->hmm, narrowed);
+    double p_matches = matches(model, probe);
+    if (p_view != p_copy || p_view != p_narrowed || p_view != p_matches || p_view == 0) {
+        printf("ERROR: %s: view %g, copy %g, uint array %g, matches() %g\n",
+               name, p_view, p_copy, p_narrowed, p_matches);
+        errors++;
+    }
+
+    free(f_view);
+    free(f_copy);
+    free(f_narrowed);
+    releaseStateSequence(copy);
+    releaseStateSequence(narrowed);
+    observation_free(observation);
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    struct gesture sets[3][CIRCLE_SET];
+    struct gesture probes[PROBES];
+    struct gesturemodel *models[3];
+    int errors = 0;
+
+    srand(34);
+    circle_sets(sets, 3);
+    for (int i = 0; i < PROBES; i++)
+        circle_gesture(&probes[i], i % 3);
+
+    for (int k = 0; k < 3; k++)
+        models[k] = gesturemodel_new(k);
+    circle_train(models, 3, sets);
+
+    // Each model again, trained on copies of the same observations
+    for (int k = 0; k < 3; k++) {
+        HmmStateRef hmm = hmm_new(models[k]->states, models[k]->observations);
+        StateSequence *copies[CIRCLE_SET];
+
+        for (int i = 0; i < CIRCLE_SET; i++) {
+            struct observation *observation = quantizer_getObservationSequence(models[k]->quantizer, &sets[k][i]);
+            copies[i] = observation_to_StateSequence(observation);
+            observation_free(observation);
+        }
+        hmm_train(hmm, copies, CIRCLE_SET);
+
+        if (!same_hmm(hmm, models[k]->hmm)) {
+            printf("ERROR: model %d: training on copies gave another model than training on views\n", k);
+            errors++;
+        }
+
+        for (int i = 0; i < CIRCLE_SET; i++)
+            releaseStateSequence(copies[i]);
+        hmm_free(hmm);
+    }
+
+    for (int i = 0; i < PROBES; i++) {
+        for (int k = 0; k < 3; k++) {
+            char name[32];
+            snprintf(name, sizeof(name), "probe %d, model %d", i, k);
+            errors += score(models[k], &probes[i], name);
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+        gesturemodel_free(models[k]);
+    circle_free(sets, 3);
+    for (int i = 0; i < PROBES; i++)
+        free(probes[i].data);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+#define _POSIX_C_SOURCE 200809L     // mkstemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wmdump.h"
+#include "gesture.h"
+
+/*
+ * Feeds the wmdump scanner the irregular bits real logs have (other
+ * buttons held with B, CR LF line ends, junk, a missing final newline)
+ * and checks what comes out.
+ */
+
+static const char *log_text =
+  "Acc Report: x=1, y=1, z=1   1 1\n"                  // before any press: dropped
+  "Button Report: 0004\n"
+  "Acc Report: x=121, y=128, z=151   1244700070 407808\n"
+  "Button Report: 1004\r\n"                             // B still held
+  "Acc Report: x=119, y=129, z=153   1244700070 413778\r\n"
+  "Acc Report: x=300, y=129, z=153   1244700070 413779\n" // out of range: dropped
+  "Acc Report: x=5, y=6\n"                             // truncated: dropped
+  "some junk\n"
+  "Button Report: 0000\n"
+  "Button Report: 0004\n"
+  "Button Report: 0000\n"                              // empty gesture, still counted
+  "Button Report: 000C\n"
+  "Acc Report: x=0, y=255, z=7   1244700090 5";       // log cut off mid-gesture
+
+struct seen {
+  int n;
+  int gesture[4];
+  int len[4];
+  int x[4];
+  int64_t t[4];
+};
+
+static int record(void *ctx, const struct wmdump_segment *s)
+{
+  struct seen *seen = ctx;
+  if (seen->n < 4) {
+    seen->gesture[seen->n] = s->gesture;
+    seen->len[seen->n] = s->data_len;
+    seen->x[seen->n] = s->x[s->data_len - 1];
+    seen->t[seen->n] = s->t[s->data_len - 1];
+
+    struct gesture *g = wmdump_gesture(s, NULL);
+    if (g->data_len != s->data_len || g->data[0].y != s->y[0])
+      seen->n = 100;
+    gesture_free(g);
+  }
+  seen->n++;
+  return 0;
+}
+
+int main(int argc, char const* argv[])
+{
+  char path[] = "/tmp/wmdump_test.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0 || write(fd, log_text, strlen(log_text)) < 0)
+    return 1;
+  close(fd);
+
+  struct seen seen = { 0 };
+  int segments = wmdump_parse(path, record, &seen);
+  unlink(path);
+
+  int ok = segments == 2 && seen.n == 2
+        && seen.gesture[0] == 0 && seen.len[0] == 2 && seen.x[0] == 119
+        && seen.t[0] == 1244700070413778LL
+        && seen.gesture[1] == 2 && seen.len[1] == 1 && seen.x[1] == 0
+        && seen.t[1] == 1244700090000005LL;
+
+  if (!ok) {
+    printf("ERROR: %d segments (%d seen)\n", segments, seen.n);
+    for (int i = 0; i < seen.n && i < 4; i++)
+      printf("  gesture %d: %d samples, last x=%d t=%lld\n",
+             seen.gesture[i], seen.len[i], seen.x[i], (long long)seen.t[i]);
+    return 1;
+  }
+
+  if (wmdump_parse("/nonexistent/x.y.txt", record, &seen) != -1) {
+    printf("ERROR: parsed a missing file\n");
+    return 1;
+  }
+  return 0;
+}